@@ -1,12 +1,50 @@
+#define _XOPEN_SOURCE 700
 #include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "include/arena.h"
 #include "include/htmlize.h"
+#include "include/stats.h"
 
 int
-main(void)
+main(int argc, char **argv)
 {
 	int retcode;
-	retcode = htmlize(stdin, stdout);
+	int format = STATS_TABLE;	// Of the -s report
+	struct arena arena;
+	struct doc doc;
+
+	for (int opt; (opt = getopt(argc, argv, "s:")) != -1;)
+		if (opt == 's' && (!strcmp(optarg, "table") || !strcmp(optarg, "json")))
+		{
+			format = !strcmp(optarg, "json") ? STATS_JSON : STATS_TABLE;
+			STATS.enabled = true;
+		}
+		else
+		{
+			fprintf(stderr, "usage: %s [-s table | json] < in > out\n", *argv);
+			return 1;
+		}
+
+	arena_init(&arena);
+	doc.arena    = &arena;
+	doc.search   = NULL;
+	doc.links    = NULL;
+	doc.linkdefs = NULL;
+	doc.images   = NULL;
+	doc.deps     = NULL;
+	doc.weight   = NULL;
+	doc.base_dir = NULL;
+	doc.nimages  = 0;
+	doc.fragment = false;
+
+	STAT_PHASE(STAT_RENDER);
+	retcode = htmlize(stdin, stdout, &doc);
 	if (retcode == -1)
 		fputs("No lines input\n", stderr);
+
+	if (STATS.enabled)
+		stats_print(NULL, stderr, format);
+	arena_free(&arena);
 	return retcode;
 }
@@ -5,6 +5,85 @@
 #define SOURCE_DIR "raw"
 #define DEST_DIR   "docs"
 
+/* Where the site is published, and by whom, for the feed (XML, unescaped) */
+#define SITE_URL    "https://subnut.github.io/blog/"
+#define SITE_TITLE  "subnut's blog"
+#define SITE_AUTHOR "subnut"
+
+/* Build state that is kept between runs, but never published */
+#define CACHE_DIR      ".cache"
+#define POSTDB_FILE    CACHE_DIR "/posts.db"
+#define SEARCH_DIR     CACHE_DIR "/search"
+#define ASSETS_HEAD    CACHE_DIR "/head.html"
+#define ASSETS_CSS     CACHE_DIR "/style.css"
+#define IMAGES_FILE    CACHE_DIR "/images"
+#define LINKS_DIR      CACHE_DIR "/links"
+#define LINKGRAPH_FILE CACHE_DIR "/linkgraph"
+#define LINKDEFS_CACHE CACHE_DIR "/linkdefs"
+#define WEIGHT_FILE    CACHE_DIR "/weight"
+#define WEIGHT_REPORT  CACHE_DIR "/weight.json"
+
+/*
+ * Link definitions ("\t[id]: url") that every post can use, as if they were
+ * its own. A definition in the post itself wins over one in here.
+ */
+#define LINKDEFS_FILE SOURCE_DIR "/links.txt"
+
+/*
+ * Static assets. The stylesheets are bundled into one file, and everything
+ * is copied into DEST_DIR/ASSETS_DIR under a name that includes a hash of
+ * its content, so that it can be cached forever.
+ */
+#define ASSETS_DIR   "assets"
+#define FAVICON_FILE "logo/logo4.png"
+#define STYLESHEETS \
+    { "css/style.css",     "screen" }, \
+    { "css/recursive.css", "screen" }, \
+    { "css/highlight.css", "screen" }, \
+    { "css/print.css",     NULL     }   /* Has its own @media print */
+
+/*
+ * Each post inlines the rules of the bundled stylesheet that it might use,
+ * if they come to at most CSS_INLINE_MAX bytes, and loads the whole of it
+ * without blocking the first paint. Bigger subsets are left to the
+ * stylesheet, as the index pages are.
+ */
+#define CSS_INLINE_MAX (14 * 1024)
+
+/*
+ * Local images (<img src> is relative to the post's source) of up to
+ * INLINE_IMAGE_MAX bytes are inlined as data: URIs; bigger ones, and types
+ * images.c knows no MIME type for, are copied to DEST_DIR/IMAGES_DIR under a
+ * fingerprinted name. SVGs are minified, with numbers rounded to
+ * SVG_PRECISION decimals.
+ */
+#define INLINE_IMAGE_MAX 2048
+#define IMAGES_DIR       "images"
+#define SVG_PRECISION    3
+
+/*
+ * The variable font that is cut down to the characters the posts actually
+ * use, as FONT_FAMILY (prose) and FONT_FAMILY "Code". It isn't in the repo
+ * (see fonts/fonts.txt). Without it (or the subsetter), the @font-face rules
+ * in the CSS are used as they are: the english_basic subset, from fonts/ if
+ * it is there, and from where it was hosted before if it isn't.
+ */
+#define FONT_FILE      "fonts/Recursive_VF_1.078.woff2"
+#define FONT_FAMILY    "RecVar"
+#define FONT_SUBSETTER "pyftsubset"
+#define FONTS_DIR      CACHE_DIR "/fonts"
+#define GLYPHS_FILE    CACHE_DIR "/glyphs"
+
+/*
+ * Budgets for what each post costs to load (see weight.h), 0 for none: the
+ * page gzipped, everything it fetches, and how many requests that takes.
+ * blogify fails when a post is over any of them. WEIGHT_REPORT has every
+ * post's numbers, and how they changed since the last build.
+ */
+#define BUDGET_HTML_GZ  (64 * 1024)
+#define BUDGET_TOTAL    (1024 * 1024)
+#define BUDGET_REQUESTS 16
+
 /* Configuration for htmlize() */
 #define READAHEAD_LINES 30
 #define HISTORY_LINES   5
@@ -17,22 +96,22 @@
 #define MAX_LINKS       50
 #define MAX_LINE_LENGTH 500
 
-/* Used in index.c */
-#define MAX_FILES        100
-#define MAX_TITLE_LENGTH 150
-
-#define FAVICON "<link rel=icon href=\"data:image/png;base64,\n\
-iVBORw0KGgoAAAANSUhEUgAAACAAAAAgCAYAAABzenr0AAAACXBIWXMAAAnXAAAJ1wGxbhe3AAAA\n\
-GXRFWHRTb2Z0d2FyZQB3d3cuaW5rc2NhcGUub3Jnm+48GgAAAchJREFUWIXF1j1oFFEUxfHfrF+J\n\
-hVpFAqksxEoU0TQhRoiNplOs7ATtLERBLPRFMIWCvZ1NCjsbiWAQFUQFwU4iqIUIFgZJIiJmXdci\n\
-6Ca7bzOj+2ZzujnvMuc/9743M6yxssKV406pO4YNCXJnbHTVJZ/XFyoPTqu7lSD4j0YtOoDBYh0I\n\
-XmFPQoAlrbMjHyAYwAf/Mq5i+oG+SoHCsRLCazgvWCiyB45GvEnc7gBgRvCRvCe7qdeCWWxuWjkk\n\
-eNQBwF+tPoKvRiPh8/o9TRGeD1A3FnGnnFHtBkCGIxH/Xqrw1QGCvRhocmu43x0A0fY/E8ymBGh/\n\
-CoLnGEyYNScz4Yob+QBBHz7J26T/o4oRlz1uXMa1s5Rw+GX/Sp64XuNbKQCZN/kAwRccx7vE8VU9\n\
-K9+gqT8yDY27oO56k/tEcHC5Uc6coe5wxH3QbJQDEPRgqMWvdAuAYfQ2eXN2edktgFj7p51QW0uA\n\
-lvaXA3DNduyOrEzHypf/kmWCfdjWEUDVkNbj/Vbwvj3A0q6dwkhH4e0VbT+NEZwsMZwsDyDTX1o4\n\
-P23yMA/gLhZLArjjovl2i43NEgzjLLYmCq7jhS0mnPM90T3T6zemFFVQZGM2gAAAAABJRU5ErkJg\n\
-gg==\">"
+/* Size of the blocks that the per-document arena bump-allocates from */
+#define ARENA_BLOCK_SIZE (64 * 1024)
+
+/* Number of posts on each page of the index */
+#define INDEX_PAGE_SIZE 50
+
+/* Number of posts in the Atom feed */
+#define FEED_ENTRIES 20
+
+/* Search index: shortest and longest terms kept, and bytes of shard prefix */
+#define SEARCH_MIN_TERM 2
+#define SEARCH_MAX_TERM 32
+#define SEARCH_PREFIX   2
+
+/* Number of linked pages that each post asks the browser to fetch early */
+#define PREFETCH_PAGES 2
 
 #define FOOTER  "<footer>\n\
                 <hr>\n\
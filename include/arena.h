@@ -0,0 +1,29 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+
+/*
+ * stddef.h	-	size_t
+ */
+
+struct arena_block;
+
+struct arena {
+	struct arena_block	*head;		/* Block we are currently bumping into */
+	struct arena_block	*spare;		/* Blocks kept around by arena_reset() */
+	size_t			 used;		/* Bytes handed out since the last reset */
+	size_t			 peak;		/* Highest value of 'used' seen so far */
+	size_t			 held;		/* Bytes held in blocks, spare or not */
+	unsigned long		 allocs;	/* Number of arena_alloc() calls */
+	unsigned long		 mallocs;	/* Number of malloc() calls for blocks */
+	unsigned long		 resets;	/* Number of arena_reset() calls */
+};
+
+void	 arena_init(struct arena *);
+void	*arena_alloc(struct arena *, size_t);
+char	*arena_strndup(struct arena *, const char *, size_t);
+void	 arena_reset(struct arena *);
+void	 arena_free(struct arena *);
+
+#endif /* ARENA_H */
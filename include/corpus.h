@@ -0,0 +1,22 @@
+#ifndef CORPUS_H
+#define CORPUS_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * stdint.h	-	uint64_t
+ * stdio.h	-	FILE
+ */
+
+/* A seeded stream of pseudo-random numbers, the same on every machine */
+struct corpus_rng {
+	uint64_t	state;
+};
+
+void		corpus_seed(struct corpus_rng *, uint64_t);
+uint64_t	corpus_next(struct corpus_rng *);
+void		corpus_post(struct corpus_rng *, unsigned long, unsigned long, FILE *);
+long long	corpus_write(const char *, unsigned long, uint64_t);
+
+#endif /* CORPUS_H */
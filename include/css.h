@@ -0,0 +1,58 @@
+#ifndef CSS_H
+#define CSS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+/*
+ * stddef.h	-	size_t
+ * stdint.h	-	uint64_t
+ * stdio.h	-	FILE
+ */
+
+/*
+ * The bundled stylesheet (see ASSETS_CSS), parsed once into an index of its
+ * rules by what their selectors need: the tags, classes and ids that must
+ * all be on a page for a selector to match anything there. A page then gets
+ * only the rules that might apply to it.
+ *
+ * It is conservative. A rule is only dropped when none of its selectors can
+ * match. Pseudo-classes, attribute selectors and :not()/:is() arguments
+ * are taken to match, and at-rules other than blocks of rules (@media,
+ * @supports) are always kept. A block of rules is kept, with its
+ * @media condition, if any rule in it is.
+ */
+struct css_rule {
+	const char	*text;		/* In the bundle */
+	size_t		 len;
+	size_t		 prelude;	/* For blocks, the length of "@media ...{" */
+	size_t		 inside;	/* ... and how many of the rules after are in it */
+	uint32_t	 needs;		/* Index into css.needs of its selectors */
+	uint32_t	 nneeds;	/* 0 if it is always kept */
+};
+
+struct css {
+	char		*text;
+	size_t		 len;
+	struct css_rule	*rules;
+	size_t		 nrules, rules_size;
+	uint64_t	*needs;		/* Each selector's, followed by a 0 */
+	size_t		 nneeds, needs_size;
+};
+
+/* What a page uses, as a set of hashes (see css.c) */
+struct css_used {
+	uint64_t	*slots;
+	size_t		 nslots;
+	size_t		 count;
+};
+
+int	css_load(struct css *, const char *);
+void	css_free(struct css *);
+void	css_used_scan(struct css_used *, const char *, size_t);
+void	css_used_clear(struct css_used *);
+void	css_used_free(struct css_used *);
+void	css_print_used(const struct css *, const struct css_used *, FILE *);
+
+#endif /* CSS_H */
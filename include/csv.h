@@ -0,0 +1,40 @@
+#ifndef CSV_H
+#define CSV_H
+
+#include <stddef.h>
+#include <stdio.h>
+
+/*
+ * stddef.h	-	size_t
+ * stdio.h	-	FILE
+ */
+
+/*
+ * A streaming reader of CSV (RFC 4180) and TSV, one field at a time, that
+ * keeps only the current line in memory. A field may be "quoted", with ""
+ * for a quote inside it, and then hold separators and newlines. Rows end at
+ * "\n" or "\r\n". Blank lines are skipped.
+ */
+enum { CSV_ERROR = -1, CSV_END, CSV_FIELD, CSV_LAST };
+
+struct csv {
+	FILE		*fp;		/* Where the lines come from, or NULL */
+	char		*mem;		/* ... if they are already in memory */
+	size_t		 mem_len;
+	char		 sep;		/* ',' or '\t' */
+	char		*line;		/* getline()'s buffer */
+	size_t		 line_size;
+	char		*p;		/* Where the next field starts, NULL between rows */
+	char		*end;		/* ... and where its line ends */
+	char		*quoted;	/* Quoted fields, unquoted */
+	size_t		 quoted_size;
+	const char	*field;		/* The field read last, '\0'-terminated */
+	size_t		 len;
+};
+
+void	csv_open(struct csv *, FILE *, char);
+void	csv_open_mem(struct csv *, char *, size_t, char);
+int	csv_next(struct csv *);
+void	csv_close(struct csv *);
+
+#endif /* CSV_H */
@@ -0,0 +1,32 @@
+#ifndef DATE_H
+#define DATE_H
+
+#include <stdint.h>
+
+/*
+ * stdint.h	-	uint32_t
+ */
+
+/*
+ * A date is parsed once, from the "DD/MM/YYYY" of a post's header, into a
+ * packed YYYYMMDD key. Keys compare and sort the way the dates do, and 0
+ * means there is no (valid) date. Every format is written from the key, into
+ * a buffer of the caller's, of at least the size given below.
+ */
+
+#define DATE_YEAR(key)	((key) / 10000)
+#define DATE_MONTH(key)	((key) / 100 % 100)
+#define DATE_DAY(key)	((key) % 100)
+
+#define DATE_TEXT_SIZE		15	/* "21st June 2024" */
+#define DATE_ISO8601_SIZE	11	/* "2024-06-21" */
+#define DATE_RFC3339_SIZE	21	/* "2024-06-21T00:00:00Z" */
+#define DATE_RFC822_SIZE	32	/* "Fri, 21 Jun 2024 00:00:00 +0000" */
+
+uint32_t	 date_parse(const char *);
+char		*date_text(uint32_t, char *);
+char		*date_iso8601(uint32_t, char *);
+char		*date_rfc3339(uint32_t, char *);
+char		*date_rfc822(uint32_t, char *);
+
+#endif /* DATE_H */
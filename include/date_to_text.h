@@ -1,6 +0,0 @@
-#ifndef DATE_H
-#define DATE_H
-
-char	*date_to_text(const char *, char *);
-
-#endif
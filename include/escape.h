@@ -3,5 +3,6 @@
 
 void	fputc_escaped(char, FILE *);
 void	fputs_escaped(const char *, FILE *);
+void	fputs_json_escaped(const char *, FILE *);
 
 #endif /* FPUT_ESCAPED_H */
@@ -0,0 +1,16 @@
+#ifndef FINGERPRINT_H
+#define FINGERPRINT_H
+
+#include <stddef.h>
+
+/*
+ * stddef.h	-	size_t
+ */
+
+/*
+ * Files that are meant to be cached forever get a hash of their content in
+ * their name, eg. style.css -> style.0123456789ab.css
+ */
+void	fingerprint_name(char *, size_t, const char *, const void *, size_t);
+
+#endif /* FINGERPRINT_H */
@@ -0,0 +1,30 @@
+#ifndef GLYPHS_H
+#define GLYPHS_H
+
+#include <stdio.h>
+
+/*
+ * stdio.h	-	FILE
+ */
+
+/*
+ * The set of characters that the rendered posts use, one bit per codepoint.
+ * Code is kept apart from prose, since it is set in a different font (the
+ * MONO axis of the variable font). blogify collects them (see GLYPHS_FILE),
+ * and assets cuts the font down to them.
+ */
+#define GLYPHS_MAX	0x110000	/* One past the last codepoint */
+#define GLYPHS_SET_SIZE	(GLYPHS_MAX / 8)
+
+struct glyphs {
+	unsigned char	prose[GLYPHS_SET_SIZE];
+	unsigned char	code[GLYPHS_SET_SIZE];
+};
+
+void	glyphs_init(struct glyphs *);
+int	glyphs_load(struct glyphs *, const char *);
+int	glyphs_save(const struct glyphs *, const char *);
+size_t	glyphs_scan(struct glyphs *, const char *);
+void	glyphs_print_ranges(const unsigned char *, FILE *);
+
+#endif /* GLYPHS_H */
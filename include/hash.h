@@ -0,0 +1,15 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * stddef.h	-	size_t
+ * stdint.h	-	uint64_t
+ */
+
+uint64_t	hash_bytes(const void *, size_t);
+uint64_t	hash_str(const char *);
+
+#endif /* HASH_H */
@@ -0,0 +1,10 @@
+#ifndef HEAD_H
+#define HEAD_H
+
+/*
+ * The <link> tags for the fingerprinted assets (stylesheet, fonts, favicon),
+ * as written by the assets program. Every page puts them in its <head>.
+ */
+char	*head_load(void);
+
+#endif /* HEAD_H */
@@ -0,0 +1,29 @@
+#ifndef HIGHLIGHT_H
+#define HIGHLIGHT_H
+
+#include <stdio.h>
+
+/*
+ * stdio.h	-	FILE
+ */
+
+/*
+ * Syntax highlighting of ```lang code blocks, while the site is built. Every
+ * token worth a color becomes <span class="X">, where X is one of -
+ *	k keyword	s string	c comment	n number
+ *	p preprocessor, decorator	v variable
+ *	a added line	d deleted line	h diff header, hunk
+ * (see css/highlight.css). Everything else is written as it is, escaped.
+ */
+
+struct syntax;
+struct highlight {
+	const struct syntax	*syntax;
+	int			 state;	/* What the last line left open */
+	char			 quote;	/* ... if it's a string, its quote */
+};
+
+const char	*highlight_start(struct highlight *, const char *, size_t);
+void		 highlight_line(struct highlight *, const char *, FILE *);
+
+#endif /* HIGHLIGHT_H */
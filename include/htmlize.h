@@ -1,18 +1,45 @@
 #ifndef HTMLIZE_H
 #define HTMLIZE_H
 
-int	htmlize(FILE *, FILE *);
+struct doc;
+int	htmlize(FILE *, FILE *, struct doc *);
 
 #include <stdio.h>
 #include <stdbool.h>
 #include "constants.h"
+#include "include/arena.h"
 
 /*
  * stdio.h	-	FILE
  * stdbool.h	-	bool
  * constants.h	-	HISTORY_LINES, READAHEAD_LINES
+ * arena.h	-	struct arena
  */
 
+/*
+ * Everything that belongs to one document, as opposed to one htmlize() call.
+ * blogify calls htmlize() more than once per document (subtitle, then body),
+ * and resets the arena only once the whole document has been written.
+ */
+struct search_doc;
+struct links_doc;
+struct linkdefs;
+struct imgcache;
+struct dep;
+struct weight;
+struct doc {
+	struct arena		*arena;
+	struct search_doc	*search;	/* Terms for the search index, or NULL */
+	struct links_doc	*links;		/* Anchors and links, or NULL */
+	const struct linkdefs	*linkdefs;	/* Site-wide link definitions, or NULL */
+	struct imgcache		*images;	/* For the size of <img>s, or NULL */
+	struct dep		*deps;		/* Files it includes (see transclude.h) */
+	struct weight		*weight;	/* What it costs to load, or NULL */
+	const char		*base_dir;	/* Where the page's relative URLs point */
+	unsigned		 nimages;	/* <img>s seen so far */
+	bool			 fragment;	/* Rendering an <include>, for any post */
+};
+
 struct config {
 	bool BOLD_OPEN;
 	bool ITALIC_OPEN;
@@ -28,7 +55,9 @@ struct files {
 struct data {
 	struct config	*config;
 	struct files	*files;
+	struct doc	*doc;
 	char		*line;
+	long		 offset;	/* Of readahead[0], in what htmlize() read */
 	char		 history[HISTORY_LINES][MAX_LINE_LENGTH];
 	char		 readahead[READAHEAD_LINES][MAX_LINE_LENGTH];
 };
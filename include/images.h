@@ -0,0 +1,15 @@
+#ifndef IMAGES_H
+#define IMAGES_H
+
+#include <stddef.h>
+#include "include/imgsize.h"
+
+/*
+ * stddef.h	-	size_t
+ * imgsize.h	-	struct imgsize_entry
+ */
+
+char		*svg_minify(const char *, size_t *);
+const char	*image_url(struct imgsize_entry *);
+
+#endif /* IMAGES_H */
@@ -0,0 +1,42 @@
+#ifndef IMGSIZE_H
+#define IMGSIZE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * stdbool.h	-	bool
+ * stddef.h	-	size_t
+ * stdint.h	-	int64_t
+ */
+
+int			 imgsize(const char *, unsigned *, unsigned *);
+
+/*
+ * The dimensions of every image seen so far, keyed on the path and mtime of
+ * the file, so that an image is only opened again once it has changed.
+ */
+struct imgsize_entry {
+	char		*path;
+	int64_t		 mtime;
+	unsigned	 width;		/* 0 if the format isn't known */
+	unsigned	 height;
+	char		*url;		/* What to link to instead (see images.c) */
+};
+
+struct imgcache {
+	struct imgsize_entry	*entries;
+	size_t			 count;
+	size_t			 cap;
+	size_t			*slots;		/* Indices into entries, + 1 */
+	size_t			 nslots;
+	bool			 dirty;
+};
+
+void			 imgcache_load(struct imgcache *, const char *);
+int			 imgcache_save(struct imgcache *, const char *);
+struct imgsize_entry	*imgcache_entry(struct imgcache *, const char *);
+void			 imgcache_free(struct imgcache *);
+
+#endif /* IMGSIZE_H */
@@ -0,0 +1,43 @@
+#ifndef LINKDEFS_H
+#define LINKDEFS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * stddef.h	-	size_t
+ * stdint.h	-	uint32_t
+ */
+
+/*
+ * The site-wide link definitions ("[id]: url" lines, see LINKDEFS_FILE),
+ * compiled into a hash table that is mapped read-only. On disk, it is -
+ *
+ *	struct linkdefs_header
+ *	uint32_t slots[nslots]	Pool offset of the definition + 1, 0 if free
+ *	char pool[pool_size]	"id\0url\0" for every definition
+ */
+#define LINKDEFS_MAGIC		"BLOGLDF"	/* 7 chars + '\0' fill the 8-byte field */
+#define LINKDEFS_VERSION	1
+
+struct linkdefs_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	count;		/* Definitions */
+	uint32_t	nslots;		/* A power of 2 */
+	uint32_t	pool_size;
+};
+
+struct linkdefs {
+	char		*map;		/* NULL if there are no definitions */
+	size_t		 map_size;
+	const uint32_t	*slots;
+	uint32_t	 nslots;
+	const char	*pool;
+};
+
+int		 linkdefs_open(struct linkdefs *, const char *, const char *);
+const char	*linkdefs_find(const struct linkdefs *, const char *, size_t);
+void		 linkdefs_close(struct linkdefs *);
+
+#endif /* LINKDEFS_H */
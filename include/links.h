@@ -0,0 +1,45 @@
+#ifndef LINKS_H
+#define LINKS_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include "include/arena.h"
+#include "include/postdb.h"
+
+/*
+ * stdio.h	-	FILE
+ * stddef.h	-	size_t
+ * arena.h	-	struct arena
+ * postdb.h	-	struct postdb
+ */
+
+/* The anchors a document defines and the local URLs it links to */
+struct links_doc {
+	struct arena	*arena;
+	char		**anchors;	/* Values of id attributes */
+	size_t		 nanchors;
+	size_t		 anchors_cap;
+	char		**hrefs;	/* "page#fragment", page is "" for this one */
+	size_t		 nhrefs;
+	size_t		 hrefs_cap;
+};
+
+/* How many pages link to each page, as of the last run of index */
+struct linkgraph {
+	char		**names;
+	unsigned	 *inlinks;
+	size_t		  count;
+	size_t		 *slots;	/* Indices into names, + 1 */
+	size_t		  nslots;
+};
+
+struct links_doc	*links_doc_new(struct arena *);
+void			 links_anchor(struct links_doc *, const char *, size_t);
+void			 links_href(struct links_doc *, const char *, size_t);
+int			 links_doc_save(struct links_doc *, const char *);
+void			 linkgraph_load(struct linkgraph *, const char *);
+void			 linkgraph_free(struct linkgraph *);
+void			 links_print_hints(struct links_doc *, const char *, const struct linkgraph *, FILE *);
+int			 links_check(const struct postdb *, const char *, const char *, const char *);
+
+#endif /* LINKS_H */
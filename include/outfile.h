@@ -0,0 +1,26 @@
+#ifndef OUTFILE_H
+#define OUTFILE_H
+
+#include <stdio.h>
+
+/*
+ * stdio.h	-	FILE
+ */
+
+/*
+ * An output file that is first written to memory, and only replaces the file
+ * on disk if its content actually changed. That keeps the mtimes of
+ * unchanged pages intact, so that anything downstream (rsync, git, browser
+ * caches) sees only the pages that really changed.
+ */
+struct outfile {
+	const char	*path;
+	char		*buf;
+	size_t		 len;
+	FILE		*fp;	/* Write the content to this */
+};
+
+FILE	*outfile_open(struct outfile *, const char *);
+int	 outfile_close(struct outfile *);
+
+#endif /* OUTFILE_H */
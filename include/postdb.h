@@ -0,0 +1,89 @@
+#ifndef POSTDB_H
+#define POSTDB_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * stdbool.h	-	bool
+ * stddef.h	-	size_t
+ * stdint.h	-	uint32_t, int64_t
+ */
+
+/*
+ * On-disk layout of the post metadata database -
+ *
+ *	struct postdb_header
+ *	struct postdb_record	[capacity]	(only the first 'count' are used)
+ *	char			pool[pool_size]	(NUL-terminated strings)
+ *
+ * Strings are referred to by their offset into the pool. Record slots are
+ * reserved ahead of time so that the pool never has to move when a post is
+ * added, and changing a post only rewrites its record plus whatever strings
+ * actually changed (appended to the end of the pool).
+ *
+ * The file is a local build cache in native byte order; it is not meant to
+ * be copied between machines.
+ */
+
+#define POSTDB_MAGIC	"BLOGPDB"	/* 7 chars + '\0' fill the 8-byte field */
+#define POSTDB_VERSION	5
+
+struct postdb_header {
+	char		magic[8];
+	uint32_t	version;
+	uint32_t	count;		/* Records in use */
+	uint32_t	capacity;	/* Record slots before the pool */
+	uint32_t	pool_size;	/* Bytes used in the pool */
+};
+
+struct postdb_record {
+	int64_t		mtime;		/* Source mtime (ns) when last rendered */
+	int64_t		size;		/* Source size when last rendered */
+	uint32_t	number;		/* Numeric prefix of the file name */
+	uint32_t	created;	/* Date key (see date.h), 0 if unparseable */
+	uint32_t	modified;	/* Date key (see date.h), 0 if unparseable */
+	uint32_t	name;		/* Pool offset: output file name */
+	uint32_t	title;		/* Pool offset: title */
+	uint32_t	tags;		/* Pool offset: comma-separated tags */
+	uint32_t	deps;		/* Pool offset: files it includes (see transclude.h) */
+	uint32_t	search_id;	/* Its id in the search index, kept for its lifetime */
+};
+
+struct postdb {
+	int			 fd;
+	bool			 writable;
+	char			*map;
+	size_t			 map_size;
+	struct postdb_header	*header;
+	struct postdb_record	*records;
+	char			*pool;
+
+	/* Only used when writable */
+	uint32_t		*slots;		/* Hash table of record indices */
+	uint32_t		 nslots;
+	unsigned char		*seen;		/* Records touched during this run */
+	uint32_t		 next_search_id;	/* For the next new post */
+};
+
+/* A post, as passed to postdb_put() */
+struct postdb_post {
+	const char	*name;
+	const char	*title;
+	uint32_t	 created;	/* Date keys, see date.h */
+	uint32_t	 modified;
+	const char	*tags;
+	const char	*deps;
+	int64_t		 mtime;
+	int64_t		 size;
+};
+
+int			 postdb_open(struct postdb *, const char *, bool);
+void			 postdb_close(struct postdb *);
+const char		*postdb_str(const struct postdb *, uint32_t);
+struct postdb_record	*postdb_find(struct postdb *, const char *);
+int			 postdb_put(struct postdb *, const struct postdb_post *);
+void			 postdb_keep(struct postdb *, const struct postdb_record *);
+
+#endif /* POSTDB_H */
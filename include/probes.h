@@ -0,0 +1,46 @@
+#ifndef PROBES_H
+#define PROBES_H
+
+/*
+ * Static tracepoints (USDT), for perf and bpftrace -
+ *
+ *	bpftrace -e 'usdt:./blogify:blog:block { @[str(arg0)] = sum(arg2); }'
+ *	perf buildid-cache --add ./blogify && perf probe sdt_blog:doc__done
+ *
+ * A probe is a single nop in the code and a note in the binary, so it costs
+ * nothing until a tracer attaches to it. Its arguments are still worked out,
+ * so keep them cheap.
+ *
+ * The probes need <sys/sdt.h> (systemtap-sdt-dev, systemtap-sdt-devel); if
+ * it isn't there, or with -DNO_PROBES, every PROBE*() is left out.
+ *
+ * Probes (provider "blog") -
+ *	doc__start	()				htmlize() starts
+ *	doc__done	(bytes)				htmlize() read that much
+ *	block		(handler, offset, length)	A block handler (CODEBLOCK, ...)
+ *							took that part of the input
+ *	file__open	(path)				A post was opened
+ *	file__close	(path, bytes)			... and read that much
+ *	flush		(path, bytes, written)		An output file was done
+ */
+
+#if defined(__has_include) && !defined(NO_PROBES)
+#if __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define HAVE_PROBES
+#endif
+#endif
+
+#ifdef HAVE_PROBES
+#define PROBE0(name)		DTRACE_PROBE(blog, name)
+#define PROBE1(name, a)		DTRACE_PROBE1(blog, name, a)
+#define PROBE2(name, a, b)	DTRACE_PROBE2(blog, name, a, b)
+#define PROBE3(name, a, b, c)	DTRACE_PROBE3(blog, name, a, b, c)
+#else
+#define PROBE0(name)
+#define PROBE1(name, a)
+#define PROBE2(name, a, b)
+#define PROBE3(name, a, b, c)
+#endif /* HAVE_PROBES */
+
+#endif /* PROBES_H */
@@ -0,0 +1,19 @@
+#ifndef RADIX_H
+#define RADIX_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * stddef.h	-	size_t
+ * stdint.h	-	uint32_t, uint64_t
+ */
+
+struct radix_item {
+	uint64_t	key;
+	uint32_t	value;
+};
+
+struct radix_item	*radix_sort(struct radix_item *, struct radix_item *, size_t);
+
+#endif /* RADIX_H */
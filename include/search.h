@@ -0,0 +1,36 @@
+#ifndef SEARCH_H
+#define SEARCH_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include "constants.h"
+#include "include/arena.h"
+#include "include/postdb.h"
+
+/*
+ * stdbool.h	-	bool
+ * stddef.h	-	size_t
+ * constants.h	-	SEARCH_MAX_TERM
+ * arena.h	-	struct arena
+ * postdb.h	-	struct postdb
+ */
+
+/* The set of terms seen in one document, kept in the document's arena */
+struct search_doc {
+	struct arena	*arena;
+	char		 word[SEARCH_MAX_TERM + 1];
+	size_t		 len;
+	bool		 overflow;	/* Current word is too long to index */
+	char		**slots;	/* Open-addressing hash set of terms */
+	size_t		 nslots;
+	size_t		 count;
+};
+
+struct search_doc	*search_doc_new(struct arena *);
+void			 search_char(struct search_doc *, int);
+void			 search_text(struct search_doc *, const char *);
+void			 search_break(struct search_doc *);
+int			 search_doc_save(struct search_doc *, const char *);
+int			 search_build(const struct postdb *, const char *, const char *);
+
+#endif /* SEARCH_H */
@@ -0,0 +1,68 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdbool.h>
+#include <stdio.h>
+#include "include/arena.h"
+
+/*
+ * stdbool.h	-	bool
+ * stdio.h	-	FILE
+ * arena.h	-	struct arena
+ */
+
+/*
+ * Counters for the hot paths of htmlize() and blogify. They are only kept
+ * once STATS.enabled is set (by -s); until then every STAT_*() below is a
+ * single branch that is never taken.
+ */
+
+/* The handlers, in the order htmlize() tries them */
+enum stat_handler {
+	STAT_CODEBLOCK, STAT_FOOTNOTES, STAT_LISTS, STAT_INCLUDE, STAT_CSV_TABLE,
+	STAT_TABLE, STAT_LINKDEF, STAT_HEADINGS, STAT_CHARREFS, STAT_HTML_TAGS,
+	STAT_CODE, STAT_BOLD, STAT_ITALIC, STAT_LINKS, STAT_FOOTNOTE,
+	STAT_TABLEROW, STAT_DUALSPACEBREAK,
+	STAT_HANDLERS
+};
+
+/* What the time goes into */
+enum stat_phase {
+	STAT_SETUP,	/* Loading the caches and the post database */
+	STAT_SCAN,	/* Looking for posts that need to be rendered */
+	STAT_RENDER,	/* htmlize() and the page around it */
+	STAT_WRITE,	/* Writing pages out */
+	STAT_SAVE,	/* Saving what index needs (terms, links, database) */
+	STAT_PHASES
+};
+
+struct stats {
+	bool			 enabled;
+	unsigned long long	 bytes_in;	/* Read by htmlize() */
+	unsigned long long	 bytes_out;	/* Written by htmlize(), where known */
+	unsigned long long	 lines;
+	unsigned long long	 next_line;	/* get_next_line() calls */
+	unsigned long long	 written;	/* Output files written */
+	unsigned long long	 unchanged;	/* Output files left alone */
+	unsigned long long	 calls[STAT_HANDLERS];
+	unsigned long long	 hits[STAT_HANDLERS];
+	double			 seconds[STAT_PHASES];
+	enum stat_phase		 phase;		/* The one the clock is running for */
+	double			 since;		/* When it started */
+};
+
+extern struct stats STATS;
+
+#define STAT_ADD(counter, n)	(STATS.enabled ? (void)(STATS.counter += (n)) : (void)0)
+#define STAT_CALL(handler)	(STATS.enabled ? (void)STATS.calls[STAT_##handler]++ : (void)0)
+#define STAT_HIT(handler)	(STATS.enabled ? (void)STATS.hits[STAT_##handler]++ : (void)0, 1)
+#define STAT_PHASE(phase)	(STATS.enabled ? stats_phase(phase) : (void)0)
+
+void	stats_phase(enum stat_phase);
+void	stats_print(const struct arena *, FILE *, int);
+
+/* Formats for stats_print() */
+#define STATS_TABLE	0
+#define STATS_JSON	1
+
+#endif /* STATS_H */
@@ -0,0 +1,14 @@
+#ifndef TAGS_H
+#define TAGS_H
+
+#include <stddef.h>
+
+/*
+ * stddef.h	-	size_t
+ */
+
+size_t	tags_normalize(const char *, char *, size_t);
+int	tags_next(const char **, char *, size_t);
+void	tag_slug(const char *, char *, size_t);
+
+#endif /* TAGS_H */
@@ -0,0 +1,23 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+/*
+ * A timeline of what a build spent its time on, in the Chrome trace event
+ * format, for chrome://tracing or Perfetto (ui.perfetto.dev). Recording is
+ * off until trace_open(); after that, every trace_span() is kept in memory
+ * and the whole trace is written out when the program exits.
+ *
+ *	start = trace_start();
+ *	...
+ *	trace_span("render", path, start, bytes);
+ *
+ * Spans that lie within another one show up nested under it. Timestamps are
+ * from CLOCK_MONOTONIC, so the traces of the programs of one build (blogify,
+ * index, ...) can be lined up.
+ */
+
+int	trace_open(const char *, const char *);
+double	trace_start(void);
+void	trace_span(const char *, const char *, double, long long);
+
+#endif /* TRACE_H */
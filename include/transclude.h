@@ -0,0 +1,52 @@
+#ifndef TRANSCLUDE_H
+#define TRANSCLUDE_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * stdbool.h	-	bool
+ * stddef.h	-	size_t
+ * stdint.h	-	int64_t
+ */
+
+/*
+ * Files that a post pulls in with <include src="..."> (see htmlize.c). Each
+ * one is mapped, and rendered only once per run, however many posts
+ * include it -
+ *	- .blog fragments are htmlize()d
+ *	- anything else is a code block, highlighted by its extension
+ * Only lines first to last are taken, if last isn't 0.
+ */
+struct fragment {
+	char		*path;
+	unsigned	 first, last;
+	char		*html;		/* NULL until (unless) it is rendered */
+	size_t		 len;
+	bool		 markup;	/* It's a .blog fragment */
+	char		**deps;		/* What it reads in turn (see below) */
+	size_t		 ndeps;
+	struct fragment	*next;
+};
+
+/*
+ * The files a post was rendered from, besides its source, kept in its
+ * arena. blogify saves them as a list of "mtime size path" lines in the
+ * post database, and renders the post again when any of them changes.
+ */
+struct dep {
+	const char	*path;
+	int64_t		 mtime;		/* 0 ... */
+	int64_t		 size;		/* ... and -1, if there's no such file */
+	struct dep	*next;
+};
+
+struct doc;
+const struct fragment	*fragment_get(struct doc *, const char *, unsigned, unsigned, bool *);
+void			 fragments_free(void);
+void			 deps_add(struct doc *, const char *);
+char			*deps_list(const struct doc *);
+bool			 deps_fresh(const char *);
+
+#endif /* TRANSCLUDE_H */
@@ -1,8 +1,14 @@
 #ifndef URLENCODE_H
 #define URLENCODE_H
 
+#include <stdio.h>
+
+/*
+ * stdio.h	-	FILE, size_t
+ */
+
 char	*urlencode_c(const char, char *);
-char	*urlencode_s(const char *, char *, size_t);
+size_t	 urlencode_s(const char *, char *, size_t);
+void	 fputs_urlencoded(const char *, FILE *);
 
 #endif /* URLENCODE_H */
-
@@ -0,0 +1,50 @@
+#ifndef WEIGHT_H
+#define WEIGHT_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stddef.h>
+
+/*
+ * stdint.h	-	uint64_t
+ * stdio.h	-	FILE
+ * stddef.h	-	size_t
+ */
+
+/*
+ * What a page costs to load: the page itself, and everything it makes the
+ * browser fetch. Files are counted as they are on disk, which is how they
+ * are served, except for the page, which is also gzipped as a server would.
+ */
+struct weight {
+	uint64_t	html;
+	uint64_t	html_gz;
+	uint64_t	css;
+	uint64_t	fonts;		/* The ones it preloads */
+	uint64_t	images;		/* The ones that aren't inlined */
+	uint64_t	favicon;
+	unsigned	requests;	/* Including the page */
+};
+
+/* The weight of every post, as of a build (see WEIGHT_FILE) */
+struct page_weight {
+	char		*name;
+	struct weight	 weight;
+};
+
+struct weights {
+	struct page_weight	*pages;
+	size_t			 count;
+	size_t			 cap;
+};
+
+void			 weight_head(struct weight *, const char *);
+void			 weight_html(struct weight *, const char *, size_t);
+void			 weights_load(struct weights *, const char *);
+int			 weights_save(struct weights *, const char *);
+const struct weight	*weights_find(const struct weights *, const char *);
+void			 weights_add(struct weights *, const char *, const struct weight *);
+unsigned		 weights_report(struct weights *, const struct weights *, FILE *);
+void			 weights_free(struct weights *);
+
+#endif /* WEIGHT_H */
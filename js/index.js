@@ -0,0 +1,36 @@
+/*
+ * Optional: lets the index grow in place instead of following the
+ * "Older posts" link. Pages work the same without it.
+ */
+document.addEventListener('DOMContentLoaded', function () {
+  var table = document.querySelector('table.blog-index');
+  var nav   = document.querySelector('p.blog-index-nav a[rel=prev]');
+  if (!table || !nav || !table.dataset.older || !window.fetch) return;
+
+  var older = table.dataset.older;
+  nav.addEventListener('click', function (event) {
+    if (!older) return;
+    event.preventDefault();
+    fetch(older)
+      .then(function (response) { return response.json(); })
+      .then(function (shard) {
+        shard.posts.forEach(function (post) {
+          var row  = table.insertRow();
+          var name = row.insertCell();
+          var date = row.insertCell();
+          var link = document.createElement('a');
+          name.className   = 'blog-index-name';
+          date.className   = 'blog-index-date';
+          link.href        = post.u;
+          link.textContent = post.t;
+          date.textContent = post.d;
+          name.appendChild(link);
+        });
+        older = shard.older;
+        if (!older) nav.remove();
+      })
+      .catch(function () { window.location = nav.href; });
+  });
+});
+
+/* vim:set et ts=2 sw=2 nowrap: */
@@ -0,0 +1,137 @@
+/*
+ * Optional: a search box for the index, backed by the static index that
+ * index writes into search/ (the shard format is described in src/search.c).
+ * Only the shards for the typed terms are fetched. The last term is matched
+ * as a prefix, so results show up while typing.
+ */
+document.addEventListener('DOMContentLoaded', function () {
+  var wrapper = document.getElementById('wrapper');
+  if (!wrapper || !window.fetch || !window.TextEncoder) return;
+
+  var MIN_TERM = 2, PREFIX = 2, MAX_RESULTS = 50;
+  var encoder = new TextEncoder();
+  var shards = {}, docs = null;
+
+  var form    = document.createElement('form');
+  var input   = document.createElement('input');
+  var results = document.createElement('ol');
+  form.className    = 'blog-search';
+  form.setAttribute('role', 'search');
+  input.type        = 'search';
+  input.placeholder = 'Search';
+  input.setAttribute('aria-label', 'Search posts');
+  results.className = 'blog-search-results';
+  form.appendChild(input);
+  wrapper.insertBefore(results, wrapper.firstChild);
+  wrapper.insertBefore(form, results);
+  form.addEventListener('submit', function (event) { event.preventDefault(); });
+
+  /*
+   * Same rules as search_char(): ASCII letters and digits, and any UTF-8.
+   * Only ASCII is folded to lowercase, as it is there.
+   */
+  function terms(query) {
+    var lower = query.replace(/[A-Z]/g, function (c) { return c.toLowerCase(); });
+    var bytes = encoder.encode(lower), list = [], word = [];
+    for (var i = 0; i <= bytes.length; i++) {
+      var c = bytes[i];
+      if (c !== undefined && (c >= 0x80 || (c >= 0x30 && c <= 0x39) || (c >= 0x61 && c <= 0x7a)))
+        word.push(c);
+      else if (word.length) {
+        if (word.length >= MIN_TERM) list.push(new Uint8Array(word));
+        word = [];
+      }
+    }
+    return list;
+  }
+
+  function hex(term) {
+    var name = '';
+    for (var i = 0; i < PREFIX && i < term.length; i++)
+      name += (term[i] < 16 ? '0' : '') + term[i].toString(16);
+    return name;
+  }
+
+  function decode(buffer) {
+    var bytes = new Uint8Array(buffer), pos = 0, list = [], prev = new Uint8Array(0);
+    function varint() {
+      var n = 0, shift = 0, b;
+      do { b = bytes[pos++]; n += (b & 0x7f) * Math.pow(2, shift); shift += 7; } while (b & 0x80);
+      return n;
+    }
+    for (var count = varint(); count > 0; count--) {
+      var shared = varint(), rest = varint();
+      var term = new Uint8Array(shared + rest);
+      term.set(prev.subarray(0, shared));
+      term.set(bytes.subarray(pos, pos + rest), shared);
+      pos += rest;
+      var posts = [], id = 0;
+      for (var n = varint(); n > 0; n--)
+        posts.push(id += varint());
+      list.push({ term: term, posts: posts });
+      prev = term;
+    }
+    return list;
+  }
+
+  function shard(name) {
+    if (!shards[name])
+      shards[name] = fetch('search/' + name + '.bin')
+        .then(function (response) { return response.ok ? response.arrayBuffer() : new ArrayBuffer(1); })
+        .then(decode);
+    return shards[name];
+  }
+
+  function startsWith(term, prefix, exact) {
+    if (term.length < prefix.length || (exact && term.length !== prefix.length)) return false;
+    for (var i = 0; i < prefix.length; i++)
+      if (term[i] !== prefix[i]) return false;
+    return true;
+  }
+
+  function lookup(term, isPrefix) {
+    return shard(hex(term)).then(function (list) {
+      var posts = {};
+      list.forEach(function (entry) {
+        if (startsWith(entry.term, term, !isPrefix))
+          entry.posts.forEach(function (id) { posts[id] = true; });
+      });
+      return posts;
+    });
+  }
+
+  function show(ids) {
+    results.textContent = '';
+    ids.slice(0, MAX_RESULTS).forEach(function (id) {
+      var item = document.createElement('li');
+      var link = document.createElement('a');
+      link.href        = docs[id][0];
+      link.textContent = docs[id][1];
+      item.appendChild(link);
+      results.appendChild(item);
+    });
+  }
+
+  var pending = 0;
+  input.addEventListener('input', function () {
+    var query = input.value, list = terms(query), ticket = ++pending;
+    if (!list.length) { results.textContent = ''; return; }
+
+    if (!docs)
+      docs = fetch('search/docs.json').then(function (response) { return response.json(); });
+    Promise.all([docs].concat(list.map(function (term, i) {
+      return lookup(term, i === list.length - 1 && !/\s$/.test(query));
+    }))).then(function (found) {
+      if (ticket !== pending) return;
+      docs = found[0];
+      var sets = found.slice(1), ids = [];
+      for (var id in sets[0])
+        if (sets.every(function (set) { return set[id]; }))
+          ids.push(+id);
+      ids.sort(function (a, b) { return b - a; });	/* Newest first */
+      show(ids);
+    });
+  });
+});
+
+/* vim:set et ts=2 sw=2 nowrap: */
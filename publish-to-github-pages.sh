@@ -10,9 +10,14 @@ run git branch -D gh-pages
 run git checkout -b gh-pages
 run mkdir docs || (run rm docs -rv && run mkdir docs)
 run make
+run assets
+run blogify
+# blogify finds the characters the pages use, which may grow the font subsets
+run assets
 run blogify
 run index
-run cp -v css/* docs
+run feed
+run cp -v js/* docs
 run cp -v LICENSE.txt docs
 # run cp -v src/* docs
 run git add -f docs
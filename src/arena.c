@@ -0,0 +1,150 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * stdio.h	- fputs()
+ * stdlib.h	- malloc(), free(), exit()
+ * string.h	- memcpy()
+ */
+
+#include "constants.h"
+#include "include/arena.h"
+
+/*
+ * A bump allocator for memory that lives exactly as long as one document.
+ *
+ * Memory is carved out of big blocks by simply moving a pointer forward.
+ * Nothing is ever freed individually; arena_reset() hands everything back at
+ * once, but keeps the blocks around so that the next document can reuse them
+ * without going through malloc() again.
+ */
+
+/* Every pointer we hand out is aligned for the strictest basic type */
+union arena_align {
+	long double	d;
+	long long	l;
+	void		*p;
+	void		(*f)(void);
+};
+#define ALIGNMENT	sizeof(union arena_align)
+#define ALIGN_UP(n)	(((n) + ALIGNMENT - 1) & ~(ALIGNMENT - 1))
+
+struct arena_block {
+	struct arena_block	*next;
+	size_t			 size;	/* Usable bytes after the header */
+	size_t			 used;
+};
+#define HEADER_SIZE	ALIGN_UP(sizeof(struct arena_block))
+#define BLOCK_DATA(b)	((char *)(b) + HEADER_SIZE)
+
+
+void
+arena_init(struct arena *arena)
+{
+	memset(arena, 0, sizeof(*arena));
+}
+
+static struct arena_block *
+new_block(struct arena *arena, size_t size)
+{
+	struct arena_block *block;
+
+	/* Reuse a spare block if the first one is big enough */
+	if (arena->spare != NULL && arena->spare->size >= size)
+	{
+		block = arena->spare;
+		arena->spare = block->next;
+	}
+	else
+	{
+		if (size < ARENA_BLOCK_SIZE)
+			size = ARENA_BLOCK_SIZE;
+		if ((block = malloc(HEADER_SIZE + size)) == NULL)
+		{
+			fputs("arena: out of memory\n", stderr);
+			exit(1);
+		}
+		block->size = size;
+		arena->held += size;
+		arena->mallocs++;
+	}
+	block->used = 0;
+	block->next = arena->head;
+	arena->head = block;
+	return block;
+}
+
+void *
+arena_alloc(struct arena *arena, size_t size)
+{
+	struct arena_block *block;
+	void *p;
+
+	size = ALIGN_UP(size);
+	block = arena->head;
+	if (block == NULL || block->size - block->used < size)
+		block = new_block(arena, size);
+
+	p = BLOCK_DATA(block) + block->used;
+	block->used += size;
+
+	arena->allocs++;
+	arena->used += size;
+	if (arena->used > arena->peak)
+		arena->peak = arena->used;
+	return p;
+}
+
+char *
+arena_strndup(struct arena *arena, const char *s, size_t n)
+{
+	char *p;
+	p = arena_alloc(arena, n + 1);
+	memcpy(p, s, n);
+	p[n] = '\0';
+	return p;
+}
+
+void
+arena_reset(struct arena *arena)
+{
+	/*
+	 * Move every block onto the spare list. Blocks bigger than the default
+	 * size were made for one unusually large request; give those back so
+	 * that one huge document doesn't pin its memory for the whole run.
+	 */
+	struct arena_block *block, *next;
+	for (block = arena->head; block != NULL; block = next)
+	{
+		next = block->next;
+		if (block->size > ARENA_BLOCK_SIZE)
+		{
+			arena->held -= block->size;
+			free(block);
+			continue;
+		}
+		block->next = arena->spare;
+		arena->spare = block;
+	}
+	arena->head = NULL;
+	arena->used = 0;
+	arena->resets++;
+}
+
+void
+arena_free(struct arena *arena)
+{
+	struct arena_block *block, *next;
+
+	arena_reset(arena);
+	for (block = arena->spare; block != NULL; block = next)
+	{
+		next = block->next;
+		free(block);
+	}
+	arena->spare = NULL;
+	arena->held = 0;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,694 @@
+#define _XOPEN_SOURCE 700
+#include <ctype.h>
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * ctype.h	- isspace()
+ * dirent.h	- opendir(), readdir()
+ * errno.h	- EEXIST
+ * stdbool.h	- bool, true, false
+ * stdint.h	- int64_t
+ * stdio.h	- open_memstream(), fopen(), fprintf(), etc
+ * stdlib.h	- malloc(), free(), system()
+ * string.h	- str*(), mem*()
+ * sys/stat.h	- mkdir()
+ * unistd.h	- unlink(), access(), getopt()
+ */
+
+#include "constants.h"
+#include "include/fingerprint.h"
+#include "include/glyphs.h"
+#include "include/outfile.h"
+#include "include/trace.h"
+
+#define MTIME_NS(st) \
+	((int64_t)(st).st_mtim.tv_sec * 1000000000 + (st).st_mtim.tv_nsec)
+
+/*
+ * Builds the static assets that every page links to -
+ *
+ *  - The STYLESHEETS, minified and bundled into a single stylesheet, so
+ *    that a page needs one request for all its CSS.
+ *  - Every local file that the CSS refers to with url(), ie. the fonts.
+ *  - The favicon, which used to be inlined (as base64) into every page.
+ *  - Subsets of FONT_FILE with just the characters that the posts use.
+ *
+ * Each one is written to DEST_DIR/ASSETS_DIR with a hash of its content in
+ * the name (eg. style.0123456789ab.css), so it can be cached forever; when
+ * it changes, so does its name. The <link> tags that refer to them (and
+ * preload the fonts) are written to ASSETS_HEAD, for blogify and index to
+ * put into the <head> of every page, and the stylesheet to ASSETS_CSS, for
+ * blogify to inline what each page uses of it.
+ */
+
+struct stylesheet {
+	const char	*path;
+	const char	*media;	/* Wrap the rules in @media, unless NULL */
+};
+
+static const struct stylesheet STYLESHEETS_[] = { STYLESHEETS };
+#define NSTYLESHEETS (sizeof(STYLESHEETS_) / sizeof(*STYLESHEETS_))
+
+#define MAX_ASSETS 64
+
+struct assets {
+	char	names[MAX_ASSETS][FILENAME_MAX];	/* Files written this run */
+	size_t	count;
+	FILE	*preload;	/* <link rel=preload> tags for the fonts */
+	bool	subset;		/* FONT_FAMILY's @font-face rules are generated */
+	int	written;
+	int	error;
+};
+
+
+static char *
+read_file(const char *path, size_t *len)
+{
+	FILE *fp;
+	char *buf;
+	long size;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET))
+	{
+		fclose(fp);
+		return NULL;
+	}
+	if ((buf = malloc(size + 1)) != NULL)
+	{
+		*len = fread(buf, 1, size, fp);
+		buf[*len] = '\0';
+	}
+	fclose(fp);
+	return buf;
+}
+
+static const char *
+fingerprint(struct assets *assets, const char *path, const char *data, size_t len)
+/*
+ * Writes data to DEST_DIR/ASSETS_DIR, under its fingerprinted name. Returns
+ * the new name (relative to ASSETS_DIR).
+ */
+{
+	struct outfile outfile;
+	FILE *out;
+	char *name, dest[2 * FILENAME_MAX];
+
+	if (assets->count == MAX_ASSETS)
+	{
+		fprintf(stderr, "assets: too many assets (MAX_ASSETS is %d)\n", MAX_ASSETS);
+		exit(1);
+	}
+	name = assets->names[assets->count++];
+
+	fingerprint_name(name, FILENAME_MAX, path, data, len);
+
+	snprintf(dest, sizeof(dest), "%s/%s/%s", DEST_DIR, ASSETS_DIR, name);
+	if ((out = outfile_open(&outfile, dest)) == NULL)
+	{
+		assets->error = 1;
+		return name;
+	}
+	fwrite(data, 1, len, out);
+	switch (outfile_close(&outfile))
+	{
+		case 1:
+#ifdef PRINT_FILENAMES
+			printf("%s -> %s\n", path, dest);
+#endif /* PRINT_FILENAMES */
+			assets->written++;
+			break;
+		case -1:
+			assets->error = 1;
+			break;
+	}
+	return name;
+}
+
+static const char *
+fingerprint_file(struct assets *assets, const char *path)
+{
+	const char *name;
+	char *data;
+	size_t len;
+
+	if ((data = read_file(path, &len)) == NULL)
+	{
+		fprintf(stderr, "assets: cannot read %s\n", path);
+		assets->error = 1;
+		return "";
+	}
+	name = fingerprint(assets, path, data, len);
+	free(data);
+	return name;
+}
+
+
+/**** [START] CSS ****/
+static char *
+minify(const char *css)
+/*
+ * Drops comments and every bit of whitespace that doesn't mean anything.
+ * Strings are copied as-is.
+ */
+{
+	char *buf;
+	size_t len;
+	FILE *out = open_memstream(&buf, &len);
+	bool space = false, semicolon = false;
+	int prev = '{';	// As if at the start of a block, so leading space goes
+
+	for (const char *p = css; *p != '\0'; p++)
+	{
+		if (p[0] == '/' && p[1] == '*')
+		{
+			if ((p = strstr(p + 2, "*/")) == NULL)
+				break;
+			p++;
+			space = true;
+			continue;
+		}
+		if (isspace((unsigned char)*p))
+		{
+			space = true;
+			continue;
+		}
+
+		/* The last declaration in a block doesn't need its ';' */
+		if (semicolon && *p != '}')
+			fputc(';', out);
+		semicolon = false;
+		if (*p == ';')
+		{
+			semicolon = true;
+			prev = *p;
+			space = false;
+			continue;
+		}
+
+		/* Space is only needed between words, and before a ':' (selectors) */
+		if (space && !strchr("{};,:>", prev) && !strchr("{};,>", *p))
+			fputc(' ', out);
+		space = false;
+
+		if (*p == '"' || *p == '\'')
+		{
+			const char *end = p + 1;
+			while (*end != '\0' && *end != *p)
+				end += end[0] == '\\' && end[1] != '\0' ? 2 : 1;
+			fwrite(p, 1, end - p + (*end != '\0'), out);
+			if (*end == '\0')
+				break;
+			p = end;
+		}
+		else
+			fputc(*p, out);
+		prev = *p;
+	}
+	fclose(out);
+	return buf;
+}
+
+static void
+print_rule(FILE *out, struct assets *assets, const char *rule, size_t len, const char *dir)
+/*
+ * Prints the rule, with every url() of a local file replaced by the name of
+ * its fingerprinted copy
+ */
+{
+	const char *end = rule + len, *p;
+
+	while ((p = strstr(rule, "url(")) != NULL && p < end)
+	{
+		p += 4;
+		fwrite(rule, 1, p - rule, out);
+
+		int quote = (*p == '"' || *p == '\'') ? *p++ : ')';
+		const char *url = p;
+		while (p < end && *p != quote)
+			p++;
+		size_t url_len = p - url;
+		if (quote != ')' && p < end)
+			p++;
+
+		if (url_len == 0 || memchr(url, ':', url_len) != NULL || *url == '/' || *url == '#')
+			fwrite(url, 1, url_len, out);	// Not ours to touch
+		else
+		{
+			char path[2 * FILENAME_MAX];
+			snprintf(path, sizeof(path), "%s/%.*s", dir, (int)url_len, url);
+			const char *name = fingerprint_file(assets, path);
+			fputs(name, out);
+
+			const char *ext = strrchr(name, '.');
+			if (ext != NULL && !strcmp(ext, ".woff2"))
+				fprintf(assets->preload,
+						"        <link rel=\"preload\" href=\"%s/%s\" as=\"font\" type=\"font/woff2\" crossorigin>\n",
+						ASSETS_DIR, name);
+		}
+		rule = p;
+	}
+	fwrite(rule, 1, end - rule, out);
+}
+
+static const char *
+src_entry_end(const char *p, const char *end)
+/*
+ * Where the entry of a src list at p ends: at a ',', ';' or '}' that isn't
+ * in a string or in parentheses
+ */
+{
+	int depth = 0;
+	for (; p < end; p++)
+	{
+		if (*p == '"' || *p == '\'')
+		{
+			int quote = *p;
+			while (p + 1 < end && *++p != quote)
+				if (*p == '\\' && p + 1 < end)
+					p++;
+		}
+		else if (*p == '(')
+			depth++;
+		else if (*p == ')')
+			depth--;
+		else if (depth <= 0 && strchr(",;}", *p))
+			break;
+	}
+	return p;
+}
+
+static bool
+missing_file(const char *entry, const char *end, const char *dir)
+/*
+ * Whether the entry is a url() of a local file that isn't there, eg. a font
+ * that fonts/fonts.txt says where to get
+ */
+{
+	const char *p = entry;
+	while (p < end && *p != '(')
+		p++;
+	if (end - entry < 4 || strncmp(entry, "url(", 4) || p++ >= end)
+		return false;
+	int quote = (*p == '"' || *p == '\'') ? *p++ : ')';
+	const char *url = p;
+	while (p < end && *p != quote)
+		p++;
+	size_t url_len = p - url;
+	if (url_len == 0 || memchr(url, ':', url_len) != NULL || *url == '/' || *url == '#')
+		return false;
+
+	char path[2 * FILENAME_MAX];
+	snprintf(path, sizeof(path), "%s/%.*s", dir, (int)url_len, url);
+	if (!access(path, R_OK))
+		return false;
+	fprintf(stderr, "assets: %s not found, leaving it out of its @font-face\n", path);
+	return true;
+}
+
+static char *
+drop_missing(const char *rule, const char *end, const char *dir, size_t *len)
+/*
+ * The @font-face rule without the sources that are local files that aren't
+ * there, so that the browser goes on to the next one (eg. where the font
+ * was hosted before). NULL if that leaves none.
+ */
+{
+	char *buf;
+	FILE *out = open_memstream(&buf, len);
+	const char *src = rule;
+	unsigned kept = 0;
+
+	/* The rule is minified, so src is right after the '{' or a ';' */
+	while ((src = strstr(src, "src:")) != NULL && src < end && !strchr("{;", src[-1]))
+		src += 4;
+	if (src == NULL || src >= end)
+	{
+		fwrite(rule, 1, end - rule, out);
+		fclose(out);
+		return buf;
+	}
+
+	src += 4;
+	fwrite(rule, 1, src - rule, out);
+	for (const char *p = src, *next; p < end; p = next + 1)
+	{
+		next = src_entry_end(p, end);
+		if (!missing_file(p, next, dir))
+			fprintf(out, "%s%.*s", kept++ ? "," : "", (int)(next - p), p);
+		if (next >= end || *next != ',')
+		{
+			fwrite(next, 1, end - next, out);
+			break;
+		}
+	}
+	fclose(out);
+	if (kept == 0)
+	{
+		free(buf);
+		return NULL;	// The page falls back to the next font in font-family
+	}
+	return buf;
+}
+
+static bool
+declares_family(const char *rule, const char *end)
+{
+	static const char decl[] = "font-family:" FONT_FAMILY;
+	for (const char *p = rule; p + sizeof(decl) <= end; p++)
+		if (!strncmp(p, decl, sizeof(decl) - 1) && strchr(";}", p[sizeof(decl) - 1]))
+			return true;
+	return false;
+}
+
+static void
+bundle(FILE *fonts, FILE *rules, struct assets *assets, const struct stylesheet *sheet)
+/*
+ * @font-face rules can't go inside @media, so they're kept separate
+ */
+{
+	char *css, *min, dir[FILENAME_MAX];
+	size_t len;
+
+	if ((css = read_file(sheet->path, &len)) == NULL)
+	{
+		fprintf(stderr, "assets: cannot read %s\n", sheet->path);
+		assets->error = 1;
+		return;
+	}
+	min = minify(css);
+	free(css);
+
+	snprintf(dir, sizeof(dir), "%s", sheet->path);
+	if (strrchr(dir, '/') != NULL)
+		*strrchr(dir, '/') = '\0';
+	else
+		strcpy(dir, ".");
+
+	if (sheet->media != NULL)
+		fprintf(rules, "@media %s{", sheet->media);
+	for (const char *p = min; *p != '\0';)
+	{
+		/* Find the end of this statement: a ';' or a '}' at the top level */
+		const char *end = p;
+		int depth = 0;
+		for (; *end != '\0'; end++)
+		{
+			if (*end == '"' || *end == '\'')
+			{
+				int quote = *end;
+				while (end[1] != '\0' && *++end != quote)
+					if (*end == '\\' && end[1] != '\0')
+						end++;
+			}
+			else if (*end == '{')
+				depth++;
+			else if (*end == '}' && --depth <= 0)
+				break;
+			else if (*end == ';' && depth == 0)
+				break;
+		}
+		if (*end != '\0')
+			end++;
+
+		if (!strncmp(p, "@import", 7))
+		{
+			fprintf(stderr, "assets: %s: @import isn't supported, put the file in the repo instead\n", sheet->path);
+			assets->error = 1;
+		}
+		else if (!strncmp(p, "@charset", 8))
+			;	// The bundle is always UTF-8
+		else if (assets->subset && !strncmp(p, "@font-face", 10) && declares_family(p, end))
+			;	// Replaced by the subsets
+		else if (!strncmp(p, "@font-face", 10))
+		{
+			size_t kept_len;
+			char *kept = drop_missing(p, end, dir, &kept_len);
+			if (kept != NULL)
+				print_rule(fonts, assets, kept, kept_len, dir);
+			free(kept);
+		}
+		else
+			print_rule(rules, assets, p, end - p, dir);
+		p = end;
+	}
+	if (sheet->media != NULL)
+		fputc('}', rules);
+	free(min);
+}
+
+static void
+print_for_pages(FILE *out, const char *css)
+/*
+ * The bundle, with its url()s relative to the pages instead of ASSETS_DIR,
+ * for blogify to inline the parts of it that a page uses
+ */
+{
+	const char *p;
+
+	while ((p = strstr(css, "url(")) != NULL)
+	{
+		p += 4;
+		if (*p == '"' || *p == '\'')
+			p++;
+		fwrite(css, 1, p - css, out);
+
+		size_t url_len = strcspn(p, "\"')");
+		if (url_len > 0 && memchr(p, ':', url_len) == NULL && *p != '/' && *p != '#')
+			fprintf(out, "%s/", ASSETS_DIR);
+		css = p;
+	}
+	fputs(css, out);
+}
+/**** [END] CSS ****/
+
+
+/**** [START] Font subsetting ****/
+static const struct {
+	const char	*family;
+	const char	*path;
+	bool		 preload;	/* Code is rare enough to load on demand */
+} SUBSETS[] = {
+	{ FONT_FAMILY,        FONTS_DIR "/" FONT_FAMILY ".woff2",        true  },
+	{ FONT_FAMILY "Code", FONTS_DIR "/" FONT_FAMILY "Code.woff2", false },
+};
+
+static long
+file_size(const char *path)
+{
+	struct stat st;
+	return stat(path, &st) ? -1 : (long)st.st_size;
+}
+
+static int
+run_subsetter(const unsigned char *set, const char *output)
+{
+	char *cmd;
+	size_t len;
+	FILE *out = open_memstream(&cmd, &len);
+	int retval;
+
+	fprintf(out, "%s '%s' --flavor=woff2 --layout-features='*' --output-file='%s' --unicodes='",
+			FONT_SUBSETTER, FONT_FILE, output);
+	glyphs_print_ranges(set, out);
+	fputc('\'', out);
+	fclose(out);
+
+	retval = system(cmd);
+	free(cmd);
+	return retval != 0;
+}
+
+static void
+subset_fonts(FILE *fonts, struct assets *assets)
+/*
+ * Cuts FONT_FILE down to the characters the pages actually use, as blogify
+ * found them (see GLYPHS_FILE), with one subset for prose and one for code,
+ * and writes their @font-face rules. Without FONT_FILE, FONT_SUBSETTER or
+ * GLYPHS_FILE, the @font-face rules in the CSS are used as they are.
+ */
+{
+	struct glyphs glyphs;
+	struct stat glyphs_st, subset_st;
+	bool stale = false;
+
+	if (access(FONT_FILE, R_OK))
+		return;	// Not in the repo, so this is the usual case
+	if (glyphs_load(&glyphs, GLYPHS_FILE) || stat(GLYPHS_FILE, &glyphs_st))
+	{
+		fprintf(stderr, "assets: no %s yet (run blogify), using the fonts in the CSS as they are\n",
+				GLYPHS_FILE);
+		return;
+	}
+	if (mkdir(FONTS_DIR, 0755) && errno != EEXIST)
+	{
+		fprintf(stderr, "assets: cannot create directory: %s\n", FONTS_DIR);
+		assets->error = 1;
+		return;
+	}
+
+	/* blogify only writes GLYPHS_FILE when the pages use something new */
+	for (size_t i = 0; i < sizeof(SUBSETS) / sizeof(*SUBSETS); i++)
+		if (stat(SUBSETS[i].path, &subset_st) || MTIME_NS(subset_st) < MTIME_NS(glyphs_st))
+			stale = true;
+
+	if (stale)
+	{
+		if (system("command -v " FONT_SUBSETTER " >/dev/null 2>&1"))
+		{
+			fprintf(stderr, "assets: %s not found, using the fonts in the CSS as they are\n", FONT_SUBSETTER);
+			return;
+		}
+
+		long before = file_size(FONT_FILE), after = 0;
+		for (size_t i = 0; i < sizeof(SUBSETS) / sizeof(*SUBSETS); i++)
+		{
+			const unsigned char *set = i == 0 ? glyphs.prose : glyphs.code;
+			if (run_subsetter(set, SUBSETS[i].path))
+			{
+				fprintf(stderr, "assets: %s failed on %s\n", FONT_SUBSETTER, FONT_FILE);
+				assets->error = 1;
+				return;
+			}
+			printf("%s: %ld bytes\n", SUBSETS[i].path, file_size(SUBSETS[i].path));
+			after += file_size(SUBSETS[i].path);
+		}
+		printf("%s: %ld bytes, subsets save %ld bytes\n", FONT_FILE, before, before - after);
+	}
+
+	for (size_t i = 0; i < sizeof(SUBSETS) / sizeof(*SUBSETS); i++)
+	{
+		const char *name = fingerprint_file(assets, SUBSETS[i].path);
+		fprintf(fonts, "@font-face{font-family:%s;src:url(%s) format('woff2');unicode-range:",
+				SUBSETS[i].family, name);
+		glyphs_print_ranges(i == 0 ? glyphs.prose : glyphs.code, fonts);
+		fputs(";font-display:swap}", fonts);
+		if (SUBSETS[i].preload)
+			fprintf(assets->preload,
+					"        <link rel=\"preload\" href=\"%s/%s\" as=\"font\" type=\"font/woff2\" crossorigin>\n",
+					ASSETS_DIR, name);
+	}
+	assets->subset = true;
+}
+/**** [END] Font subsetting ****/
+
+
+static void
+remove_stale(const struct assets *assets)
+{
+	DIR *d;
+	struct dirent *dirent;
+	char path[2 * FILENAME_MAX];
+
+	if ((d = opendir(DEST_DIR "/" ASSETS_DIR)) == NULL)
+		return;
+	while ((dirent = readdir(d)) != NULL)
+	{
+		bool keep = dirent->d_name[0] == '.';
+		for (size_t i = 0; i < assets->count && !keep; i++)
+			keep = !strcmp(assets->names[i], dirent->d_name);
+		if (keep)
+			continue;
+		snprintf(path, sizeof(path), "%s/%s/%s", DEST_DIR, ASSETS_DIR, dirent->d_name);
+		unlink(path);
+	}
+	closedir(d);
+}
+
+int
+main(int argc, const char **argv)
+{
+	static struct assets assets;
+	struct outfile outfile;
+	FILE *fonts, *rules, *out;
+	char *fonts_buf, *rules_buf, *preload_buf;
+	size_t fonts_len, rules_len, preload_len;
+	const char *favicon, *stylesheet;
+	double start = 0;	// Of the span being traced
+
+	for (int opt; (opt = getopt(argc, (char * const *)argv, "t:")) != -1;)
+		switch (opt)
+		{
+			case 't':
+				if (trace_open(optarg, "assets"))
+				{
+					fprintf(stderr, "%s: cannot write trace: %s\n", *argv, optarg);
+					return 1;
+				}
+				start = trace_start();
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-t trace.json]\n", *argv);
+				return 1;
+		}
+
+	if ((mkdir(DEST_DIR, 0755) && errno != EEXIST)
+			|| (mkdir(DEST_DIR "/" ASSETS_DIR, 0755) && errno != EEXIST)
+			|| (mkdir(CACHE_DIR, 0755) && errno != EEXIST))
+	{
+		fprintf(stderr, "%s: cannot create directory: %s/%s\n", *argv, DEST_DIR, ASSETS_DIR);
+		return 1;
+	}
+
+	fonts          = open_memstream(&fonts_buf,   &fonts_len);
+	rules          = open_memstream(&rules_buf,   &rules_len);
+	assets.preload = open_memstream(&preload_buf, &preload_len);
+
+	trace_span("setup", NULL, start, -1);
+	start = trace_start();
+	subset_fonts(fonts, &assets);
+	trace_span("fonts", NULL, start, -1);
+	for (size_t i = 0; i < NSTYLESHEETS; i++)
+	{
+		start = trace_start();
+		bundle(fonts, rules, &assets, &STYLESHEETS_[i]);
+		trace_span("bundle", STYLESHEETS_[i].path, start, -1);
+	}
+	fclose(rules);	// rules_buf is only valid after this
+	fputs(rules_buf, fonts);
+	fclose(fonts);
+	fclose(assets.preload);
+
+	start = trace_start();
+	stylesheet = fingerprint(&assets, "style.css", fonts_buf, fonts_len);
+	favicon    = fingerprint_file(&assets, FAVICON_FILE);
+	trace_span("fingerprint", NULL, start, fonts_len);
+	if (assets.error)
+		return 1;	// Leave the pages pointing at the last good assets
+
+	/* Before ASSETS_HEAD, which tells blogify that the pages are stale */
+	if ((out = outfile_open(&outfile, ASSETS_CSS)) == NULL)
+		return 1;
+	print_for_pages(out, fonts_buf);
+	if (outfile_close(&outfile) == -1)
+		return 1;
+
+	if ((out = outfile_open(&outfile, ASSETS_HEAD)) == NULL)
+		return 1;
+	fprintf(out, "        <link rel=\"icon\" type=\"image/png\" href=\"%s/%s\">\n", ASSETS_DIR, favicon);
+	fputs(preload_buf, out);
+	fprintf(out, "        <link rel=\"stylesheet\" href=\"%s/%s\">\n", ASSETS_DIR, stylesheet);
+	if (outfile_close(&outfile) == -1)
+		return 1;
+	remove_stale(&assets);
+
+#ifdef PRINT_FILENAMES
+	printf("%s: %d files rewritten\n", ASSETS_HEAD, assets.written);
+#endif /* PRINT_FILENAMES */
+
+	free(fonts_buf);
+	free(rules_buf);
+	free(preload_buf);
+	return 0;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
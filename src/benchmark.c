@@ -0,0 +1,309 @@
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE		// wait4()
+#include <errno.h>
+#include <fcntl.h>
+#include <ftw.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * errno.h		- EEXIST
+ * fcntl.h		- open()
+ * ftw.h		- nftw(), to clear out the output of the last run
+ * stdio.h		- printf(), fprintf(), fopen()
+ * stdlib.h		- strtoul(), strtoull()
+ * string.h		- strcmp()
+ * sys/resource.h	- struct rusage
+ * sys/stat.h		- mkdir()
+ * sys/wait.h		- waitid(), wait4()
+ * time.h		- clock_gettime()
+ * unistd.h		- fork(), execv(), getopt(), symlink()
+ */
+
+#include "include/corpus.h"
+
+/*
+ * Times whole builds of a synthetic site (see corpus.c), for a few sizes of
+ * it, and prints the results as JSON, so that runs can be compared across
+ * commits -
+ *
+ *	benchmark [-s seed] [-w directory] [posts...]
+ *
+ * It has to be run from the top of the tree, which has the programs and the
+ * assets. Every size gets three builds -
+ *	full	from nothing (assets, blogify, index, feed)
+ *	noop	again, with nothing changed (blogify, index, feed)
+ *	edit	again, with one post changed (blogify, index, feed)
+ *
+ * For every program and every build, it reports the wall and CPU time, the
+ * peak RSS, the throughput (bytes of posts per second of wall time) and the
+ * number of read and write syscalls, from /proc/<pid>/io (null elsewhere).
+ * The programs are single-threaded, so there's no thread count to vary.
+ */
+
+struct result {
+	double		 wall;		/* Seconds */
+	double		 user;
+	double		 sys;
+	long		 maxrss;	/* KiB */
+	long long	 syscr;		/* -1 if unknown */
+	long long	 syscw;
+	int		 status;
+};
+
+struct build {
+	const char	*name;
+	const char	*steps[5];
+};
+
+static const struct build BUILDS[] = {
+	{ "full", { "assets", "blogify", "index", "feed", NULL } },
+	{ "noop", { "blogify", "index", "feed", NULL } },
+	{ "edit", { "blogify", "index", "feed", NULL } },
+};
+
+static const unsigned long DEFAULT_SIZES[] = { 100, 1000, 10000, 100000 };
+
+static char TOP[FILENAME_MAX];	// Where the programs and the assets are
+static int RUNS;		// Results printed so far
+
+
+static double
+seconds(const struct timeval *tv)
+{
+	return tv->tv_sec + tv->tv_usec / 1e6;
+}
+
+static void
+read_io(pid_t pid, struct result *r)
+{
+	char path[64], line[128];
+	FILE *fp;
+
+	r->syscr = r->syscw = -1;
+	snprintf(path, sizeof(path), "/proc/%ld/io", (long)pid);
+	if ((fp = fopen(path, "r")) == NULL)
+		return;
+	while (fgets(line, sizeof(line), fp) != NULL)
+		if (sscanf(line, "syscr: %lld", &r->syscr) != 1)
+			sscanf(line, "syscw: %lld", &r->syscw);
+	fclose(fp);
+}
+
+static int
+run(const char *program, struct result *r)
+/*
+ * Runs one of our programs in the current directory, with its output
+ * thrown away
+ */
+{
+	char path[FILENAME_MAX + 16];
+	struct timespec start, end;
+	struct rusage usage;
+	siginfo_t info;
+	pid_t pid;
+
+	snprintf(path, sizeof(path), "%s/%s", TOP, program);
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	if ((pid = fork()) == -1)
+		return 1;
+	if (pid == 0)
+	{
+		int null = open("/dev/null", O_WRONLY);
+		dup2(null, 1);
+		dup2(null, 2);
+		execl(path, program, (char *)NULL);
+		_exit(127);
+	}
+
+	/* Look at its counters before it's gone */
+	if (waitid(P_PID, pid, &info, WEXITED | WNOWAIT) == 0)
+		read_io(pid, r);
+	if (wait4(pid, &r->status, 0, &usage) == -1)
+		return 1;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	r->wall   = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+	r->user   = seconds(&usage.ru_utime);
+	r->sys    = seconds(&usage.ru_stime);
+	r->maxrss = usage.ru_maxrss;
+	return 0;
+}
+
+static void
+print_count(const char *name, long long n)
+{
+	if (n < 0)
+		printf(", \"%s\": null", name);
+	else
+		printf(", \"%s\": %lld", name, n);
+}
+
+static void
+print_result(unsigned long posts, long long bytes, const char *build, const char *step, const struct result *r)
+{
+	printf("%s\n\t\t{ \"posts\": %lu, \"bytes\": %lld, \"build\": \"%s\", \"step\": \"%s\"",
+			RUNS++ ? "," : "", posts, bytes, build, step);
+	printf(", \"wall_s\": %.6f, \"user_s\": %.6f, \"sys_s\": %.6f, \"maxrss_kib\": %ld",
+			r->wall, r->user, r->sys, r->maxrss);
+	printf(", \"mb_per_s\": %.3f", r->wall > 0 ? bytes / r->wall / 1e6 : 0);
+	print_count("read_syscalls", r->syscr);
+	print_count("write_syscalls", r->syscw);
+	printf(", \"status\": %d }", WIFEXITED(r->status) ? WEXITSTATUS(r->status) : -1);
+}
+
+static int
+remove_entry(const char *path, const struct stat *st, int type, struct FTW *ftw)
+{
+	(void)st, (void)type, (void)ftw;
+	return remove(path);
+}
+
+static int
+prepare(const char *site, unsigned long posts, uint64_t seed, long long *bytes)
+/*
+ * Sets up a site with a fresh corpus and no output, and cd's into it (the
+ * caller cd's back to TOP)
+ */
+{
+	static const char *const LINKED[] = { "css", "logo", "fonts" };
+	char path[2 * FILENAME_MAX];
+
+	if (mkdir(site, 0755) && errno != EEXIST)
+		return 1;
+	for (size_t i = 0; i < sizeof(LINKED) / sizeof(*LINKED); i++)
+	{
+		char target[FILENAME_MAX + 16];
+		snprintf(path, sizeof(path), "%s/%s", site, LINKED[i]);
+		snprintf(target, sizeof(target), "%s/%s", TOP, LINKED[i]);
+		unlink(path);
+		if (symlink(target, path))
+			return 1;
+	}
+
+	snprintf(path, sizeof(path), "%s/raw", site);
+	if ((mkdir(path, 0755) && errno != EEXIST) || (*bytes = corpus_write(path, posts, seed)) < 0)
+		return 1;
+
+	const char *const OUTPUT[] = { "docs", ".cache" };
+	for (size_t i = 0; i < sizeof(OUTPUT) / sizeof(*OUTPUT); i++)
+	{
+		snprintf(path, sizeof(path), "%s/%s", site, OUTPUT[i]);
+		nftw(path, remove_entry, 16, FTW_DEPTH | FTW_PHYS);
+	}
+	snprintf(path, sizeof(path), "%s/docs", site);
+	return mkdir(path, 0755) || chdir(site);
+}
+
+static int
+edit(unsigned long posts)
+/*
+ * Changes the post in the middle, the way a typo fix would
+ */
+{
+	char path[FILENAME_MAX];
+	FILE *fp;
+
+	snprintf(path, sizeof(path), "raw/%lu-post.blog", posts / 2 + 1);
+	if ((fp = fopen(path, "a")) == NULL)
+		return 1;
+	fputs("One more sentence, added by the benchmark.\n", fp);
+	return fclose(fp) != 0;
+}
+
+static int
+bench(const char *dir, unsigned long posts, uint64_t seed)
+{
+	char site[FILENAME_MAX];
+	long long bytes;
+
+	snprintf(site, sizeof(site), "%s/%lu", dir, posts);
+	fprintf(stderr, "benchmark: %lu posts in %s\n", posts, site);
+	if (prepare(site, posts, seed, &bytes))
+	{
+		fprintf(stderr, "benchmark: cannot set up %s\n", site);
+		return 1;
+	}
+
+	for (size_t b = 0; b < sizeof(BUILDS) / sizeof(*BUILDS); b++)
+	{
+		struct result total = { 0 };
+
+		if (!strcmp(BUILDS[b].name, "edit") && edit(posts))
+		{
+			fprintf(stderr, "benchmark: cannot change a post in %s\n", site);
+			return 1;
+		}
+		for (const char *const *step = BUILDS[b].steps; *step != NULL; step++)
+		{
+			struct result r;
+			if (run(*step, &r))
+			{
+				fprintf(stderr, "benchmark: cannot run %s/%s\n", TOP, *step);
+				return 1;
+			}
+			print_result(posts, bytes, BUILDS[b].name, *step, &r);
+			if (r.status != 0)
+			{
+				fprintf(stderr, "benchmark: %s failed in %s, run it there to see why\n", *step, site);
+				return 1;
+			}
+
+			total.wall += r.wall;
+			total.user += r.user;
+			total.sys  += r.sys;
+			total.maxrss = r.maxrss > total.maxrss ? r.maxrss : total.maxrss;
+			total.syscr  = r.syscr < 0 || total.syscr < 0 ? -1 : total.syscr + r.syscr;
+			total.syscw  = r.syscw < 0 || total.syscw < 0 ? -1 : total.syscw + r.syscw;
+			total.status = total.status ? total.status : r.status;
+		}
+		print_result(posts, bytes, BUILDS[b].name, "total", &total);
+		fprintf(stderr, "benchmark: %lu posts, %s build: %.3fs\n", posts, BUILDS[b].name, total.wall);
+	}
+	return 0;
+}
+
+int
+main(int argc, char **argv)
+{
+	const char *dir = "/tmp/blog-bench";
+	uint64_t seed = 1;
+	int retval = 0;
+
+	for (int opt; (opt = getopt(argc, argv, "s:w:")) != -1;)
+		switch (opt)
+		{
+			case 's':
+				seed = strtoull(optarg, NULL, 0);
+				break;
+			case 'w':
+				dir = optarg;
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-s seed] [-w directory] [posts...]\n", *argv);
+				return 1;
+		}
+
+	if (getcwd(TOP, sizeof(TOP)) == NULL || (mkdir(dir, 0755) && errno != EEXIST))
+	{
+		fprintf(stderr, "%s: cannot create directory: %s\n", *argv, dir);
+		return 1;
+	}
+
+	printf("{\n\t\"seed\": %llu,\n\t\"runs\": [", (unsigned long long)seed);
+	if (optind == argc)
+		for (size_t i = 0; i < sizeof(DEFAULT_SIZES) / sizeof(*DEFAULT_SIZES) && !retval; i++)
+			retval = bench(dir, DEFAULT_SIZES[i], seed) || chdir(TOP);
+	for (int i = optind; i < argc && !retval; i++)
+		retval = bench(dir, strtoul(argv[i], NULL, 10), seed) || chdir(TOP);
+	printf("\n\t]\n}\n");
+	return retval;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
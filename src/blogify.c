@@ -1,34 +1,63 @@
+#define _XOPEN_SOURCE 700
 #include <dirent.h>
 #include <errno.h>
+#include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /*
- * dirent.h	- opendir(), readdir()
- * errno.h	- if opendir() fails, show proper error msg
- * stdio.h	- printf(), fopen(), fprintf(), etc
- * string.h	- str*(), mem*()
+ * dirent.h		- opendir(), readdir()
+ * errno.h		- if opendir() fails, show proper error msg
+ * stdbool.h		- bool, true, false
+ * stdio.h		- printf(), fopen(), fprintf(), open_memstream(), etc
+ * stdlib.h		- free()
+ * string.h		- str*(), mem*()
+ * sys/stat.h		- stat(), mkdir()
+ * unistd.h		- getopt()
  */
 
 #include "constants.h"
+#include "include/arena.h"
 #include "include/cd.h"
-#include "include/date_to_text.h"
+#include "include/css.h"
+#include "include/date.h"
 #include "include/escape.h"
+#include "include/glyphs.h"
+#include "include/head.h"
 #include "include/htmlize.h"
+#include "include/imgsize.h"
+#include "include/linkdefs.h"
+#include "include/links.h"
+#include "include/outfile.h"
+#include "include/postdb.h"
+#include "include/probes.h"
+#include "include/search.h"
+#include "include/stats.h"
+#include "include/tags.h"
+#include "include/trace.h"
+#include "include/transclude.h"
+#include "include/urlencode.h"
+#include "include/weight.h"
 
 #define cd(x) \
         cd(x, argv)
 
+#define MTIME_NS(st) \
+	((int64_t)(st).st_mtim.tv_sec * 1000000000 + (st).st_mtim.tv_nsec)
 
-static const char INITIAL_HTML_PRE_SUBTITLE[] = "\
+
+static const char INITIAL_HTML_HEAD[] = "\
 <html>\n\
     <head>\n\
         <meta charset=\"utf-8\"/>\n\
         <title>%s</title>\n\
-        %s\n\
-        <link rel=\"stylesheet\" href=\"style.css\" media=\"screen\">\n\
-        <link rel=\"stylesheet\" href=\"recursive.css\" media=\"screen\">\n\
-        <link rel=\"stylesheet\" href=\"print.css\" media=\"print\">\n\
+%s\
+        <link rel=\"alternate\" type=\"application/atom+xml\" href=\"feed.xml\">\n\
+";
+static const char INITIAL_HTML_PRE_SUBTITLE[] = "\
     </head>\n\
     <body>\n\
         <header>\n\
@@ -43,6 +72,8 @@ static const char INITIAL_HTML_POST_SUBTITLE[] = "\
                 Published on %s.\n\
                 Last modified on %s.\n\
             </p>\n\
+";
+static const char INITIAL_HTML_MAIN[] = "\
             <main>\n\
 <!-- Blog content starts here -->\n\
 ";
@@ -57,73 +88,218 @@ static const char FINAL_HTML[] = "\
 ";
 
 
-static void
-initial_html(FILE *in, FILE *out)
-{
+/* The header lines of a .blog file, without their trailing '\n' */
+struct header {
 	char TITLE[MAX_LINE_LENGTH];
 	char DATE_CREATED[MAX_LINE_LENGTH];
 	char DATE_MODIFIED[MAX_LINE_LENGTH];
+	char TAGS[MAX_LINE_LENGTH];	// Optional "tags:" line, normalized
+	uint32_t created;		// The dates, parsed (see date.h)
+	uint32_t modified;
+};
+
+static char *HEAD;	// The <link>s to the assets, from ASSETS_HEAD
+static char *STYLESHEET;	// ... but the stylesheet's, which is taken out
+static char STYLESHEET_HREF[FILENAME_MAX];
+static struct css CSS;	// ASSETS_CSS, if it could be read
+static struct css_used USED;	// By the page being written
+static struct weight BASE;	// What every page fetches for the <link>s in HEAD
+static struct glyphs GLYPHS;	// Used by the pages, for assets to subset the font
+static size_t NEW_GLYPHS;	// ... that weren't in GLYPHS_FILE
+static struct linkgraph GRAPH;	// Pages that are linked to the most
+
+
+static long
+initial_html(FILE *in, FILE *out, struct doc *doc, struct header *header)
+{
+	char *TITLE         = header->TITLE;
+	char *DATE_CREATED  = header->DATE_CREATED;
+	char *DATE_MODIFIED = header->DATE_MODIFIED;
+	char *TAGS          = header->TAGS;
 	char BUFFER[MAX_LINE_LENGTH];
 
 	fgets(TITLE,         MAX_LINE_LENGTH, in);
 	fgets(DATE_CREATED,  MAX_LINE_LENGTH, in);
 	fgets(DATE_MODIFIED, MAX_LINE_LENGTH, in);
-	fgets(BUFFER,        MAX_LINE_LENGTH, in);	// ---\n
+	search_text(doc->search, TITLE);
+
+	/*
+	 * Optional "field: value" lines may follow, up to the "---" that ends
+	 * the header. Fields we don't know about are ignored.
+	 */
+	*TAGS = '\0';
+	while (fgets(BUFFER, MAX_LINE_LENGTH, in) != NULL && memcmp(BUFFER, "---\n", 5))
+		if (!memcmp(BUFFER, "tags:", 5))
+			tags_normalize(BUFFER + 5, TAGS, MAX_LINE_LENGTH);
+	search_text(doc->search, TAGS);
 
 	fputs("<!--\n", out);
 	fprintf(out, "TITLE: %s", TITLE);
 	fprintf(out, "CREATED: %s", DATE_CREATED);
 	fprintf(out, "MODIFIED: %s", DATE_MODIFIED);
+	if (*TAGS != '\0')
+		fprintf(out, "TAGS: %s\n", TAGS);
 	fputs("-->\n", out);
 
 	char *p;
 	*(p = memchr(TITLE,			'\n', MAX_LINE_LENGTH)) = '\0';
 	*(p = memchr(DATE_CREATED,	'\n', MAX_LINE_LENGTH)) = '\0';
 	*(p = memchr(DATE_MODIFIED, '\n', MAX_LINE_LENGTH)) = '\0';
+	header->created  = date_parse(DATE_CREATED);
+	header->modified = date_parse(DATE_MODIFIED);
 
-	fprintf(out, INITIAL_HTML_PRE_SUBTITLE, TITLE, FAVICON, TITLE);
-	htmlize(in, out);	// htmlize the subtitle text
+	fprintf(out, INITIAL_HTML_HEAD, TITLE, HEAD);
+	long head_end = ftell(out);
+	fprintf(out, INITIAL_HTML_PRE_SUBTITLE, TITLE);
+	htmlize(in, out, doc);	// htmlize the subtitle text
 
 	/*
-	 * NOTE: This will not work -
-	 *
-	 * 		char buffer[15];
-	 *
-	 * 		fprintf(out, INITIAL_HTML_POST_SUBTITLE,
-	 * 				date_to_text(DATE_CREATED, buffer),
-	 * 				date_to_text(DATE_MODIFIED, buffer)
-	 * 			   );
-	 *
-	 * Why? Because both date_to_text() invocations shall return a
-	 * pointer to the same buffer, and both shall operate on that same buffer.
-	 *
-	 * So, when fprintf() starts formatting the string, it finds the buffer's
-	 * value to be what the last invocation of date_to_text() had put in it.
-	 * (ie. the string form of DATE_MODIFIED)
-	 *
-	 * This will cause both "Date created" and "Last modified" table fields to
-	 * show the value of DATE_MODIFIED.
-	 *
-	 *
-	 * The solution?
-	 * Use different buffers for DATE_CREATED and DATE_MODIFIED
+	 * Each date is formatted into a buffer of its own, since fprintf() only
+	 * gets to them once both are done. A date we can't parse is shown as
+	 * written.
 	 */
-
-	char DATE_CREATED_str[15];
-	char DATE_MODIFIED_str[15];
+	char created[DATE_TEXT_SIZE], modified[DATE_TEXT_SIZE];
 	fprintf(out, INITIAL_HTML_POST_SUBTITLE,
-			date_to_text(DATE_CREATED, DATE_CREATED_str),
-			date_to_text(DATE_MODIFIED, DATE_MODIFIED_str)
+			header->created  ? date_text(header->created,  created)  : DATE_CREATED,
+			header->modified ? date_text(header->modified, modified) : DATE_MODIFIED
 		   );
+
+	/* Link each tag to its archive page */
+	if (*TAGS != '\0')
+	{
+		const char *list = TAGS;
+		char tag[MAX_LINE_LENGTH], slug[MAX_LINE_LENGTH];
+		char url[MAX_LINE_LENGTH * 3 + 1];
+
+		fputs("            <p class=\"blog-tags\">\n                Tags:", out);
+		while (tags_next(&list, tag, sizeof(tag)))
+		{
+			tag_slug(tag, slug, sizeof(slug));
+			urlencode_s(slug, url, sizeof(url));
+			fprintf(out, "\n                <a href=\"tag/%s.html\">", url);
+			fputs_escaped(tag, out);
+			fputs("</a>", out);
+		}
+		fputs("\n            </p>\n", out);
+	}
+	fputs(INITIAL_HTML_MAIN, out);
+	return head_end;
 }
 
 
+static bool
+split_head(void)
+/*
+ * Takes the stylesheet's <link> out of HEAD, into STYLESHEET
+ */
+{
+	static const char link[] = "        <link rel=\"stylesheet\" href=\"";
+	char *p = strstr(HEAD, link), *end;
+
+	if (p == NULL || (end = strchr(p, '\n')) == NULL
+			|| strcspn(p + sizeof(link) - 1, "\"") >= sizeof(STYLESHEET_HREF))
+		return false;
+	end++;
+	if ((STYLESHEET = malloc(end - p + 1)) == NULL)
+		return false;
+	memcpy(STYLESHEET, p, end - p);
+	STYLESHEET[end - p] = '\0';
+	snprintf(STYLESHEET_HREF, sizeof(STYLESHEET_HREF), "%.*s",
+			(int)strcspn(p + sizeof(link) - 1, "\""), p + sizeof(link) - 1);
+	memmove(p, end, strlen(end) + 1);
+	return true;
+}
+
 static void
-process_file(FILE *src, FILE *dest)
+print_stylesheet(const char *page, size_t len, FILE *out)
+/*
+ * Inlines the rules that the page might use, so that it can be painted
+ * without waiting for the stylesheet, which is then loaded without
+ * blocking, for everything else. media="print" is how it is kept from
+ * blocking; onload switches it on.
+ *
+ * What the page uses is read off the finished page, rather than recorded
+ * as it is written. Its markup comes from the template, every handler in
+ * htmlize(), the raw HTML that posts pass through, highlight.c and cached
+ * fragments, and a hook in each would miss whatever is added next. The
+ * page is still in memory, and one pass over it costs a fraction of
+ * rendering it (see the "css" spans of -t).
+ */
+{
+	char *subset = NULL;
+	size_t subset_len = 0;
+	FILE *fp;
+	double start = trace_start();
+
+	if (STYLESHEET == NULL)
+		return;	// It's still in HEAD
+	if ((fp = open_memstream(&subset, &subset_len)) != NULL)
+	{
+		css_used_clear(&USED);
+		css_used_scan(&USED, page, len);
+		css_print_used(&CSS, &USED, fp);
+		fclose(fp);
+	}
+	trace_span("css", NULL, start, len);
+	if (subset == NULL || subset_len > CSS_INLINE_MAX)
+		fputs(STYLESHEET, out);
+	else
+	{
+		fprintf(out, "        <style>%s</style>\n", subset);
+		fprintf(out, "        <link rel=\"stylesheet\" href=\"%s\" media=\"print\" onload=\"this.media='all'\">\n",
+				STYLESHEET_HREF);
+		fprintf(out, "        <noscript><link rel=\"stylesheet\" href=\"%s\"></noscript>\n", STYLESHEET_HREF);
+	}
+	free(subset);
+}
+
+static int
+process_file(FILE *src, const char *dest, struct doc *doc, struct header *header)
+/*
+ * The page is rendered into memory first, since what goes at the end of its
+ * <head> (the CSS it uses, and the pages to prefetch) is only known once the
+ * body is done
+ */
 {
-	initial_html(src, dest);
-	htmlize(src, dest);
-	fprintf(dest, FINAL_HTML, FOOTER);
+	struct outfile outfile;
+	FILE *page, *out;
+	char *buf = NULL;
+	size_t len = 0;
+	long head_end;
+	double start = trace_start();
+
+	if ((page = open_memstream(&buf, &len)) == NULL)
+		return 1;
+	head_end = initial_html(src, page, doc, header);
+	htmlize(src, page, doc);
+	fprintf(page, FINAL_HTML, FOOTER);
+	fclose(page);
+	trace_span("render", dest, start, ftell(src));
+	STAT_PHASE(STAT_WRITE);
+	start = trace_start();
+
+	if ((out = outfile_open(&outfile, dest)) == NULL)
+	{
+		free(buf);
+		return 1;
+	}
+	fwrite(buf, 1, head_end, out);
+	print_stylesheet(buf, len, out);
+	links_print_hints(doc->links, strrchr(dest, '/') + 1, &GRAPH, out);
+	fwrite(buf + head_end, 1, len - head_end, out);
+	NEW_GLYPHS += glyphs_scan(&GLYPHS, buf);
+	free(buf);
+
+	/* The page is weighed as it will be served */
+	fflush(out);
+	if (doc->weight != NULL)
+		weight_html(doc->weight, outfile.buf, outfile.len);
+
+	int written = outfile_close(&outfile);
+	trace_span(written == 1 ? "write" : "write (unchanged)", dest, start, len);
+	STAT_ADD(written, written == 1);
+	STAT_ADD(unchanged, written == 0);
+	return written == -1;
 }
 
 
@@ -132,8 +308,128 @@ main(int argc, const char **argv)
 {
 	DIR *dir;
 	FILE *sfp;		// (s)ource      (f)ile (p)ointer
-	FILE *dfp;		// (d)estination (f)ile (p)ointer
 	struct dirent *dirent;
+	struct arena arena;	// Reused by every document, reset in between
+	struct doc doc;
+	struct header header;
+	struct postdb db;
+	struct imgcache images;
+	struct linkdefs linkdefs;
+	struct stat head_st, defs_st;
+	bool have_glyphs;
+	struct weights weights, before;	// Of the pages, now and as of the last build
+	struct weight weight;
+	const struct weight *was;
+	unsigned over;
+	bool force = false;	// Re-render posts even if they haven't changed
+	int format = STATS_TABLE;	// Of the -s report
+	double start = 0, scan, post_start;	// Of the spans being traced
+
+	for (int opt; (opt = getopt(argc, (char * const *)argv, "fs:t:")) != -1;)
+		switch (opt)
+		{
+			case 'f':
+				force = true;
+				break;
+			case 't':
+				if (trace_open(optarg, "blogify"))
+				{
+					fprintf(stderr, "%s: cannot write trace: %s\n", *argv, optarg);
+					return 1;
+				}
+				start = trace_start();
+				break;
+			case 's':
+				if (!strcmp(optarg, "table") || !strcmp(optarg, "json"))
+				{
+					format = !strcmp(optarg, "json") ? STATS_JSON : STATS_TABLE;
+					STATS.enabled = true;
+					break;
+				}
+				/* FALLTHROUGH */
+			default:
+				fprintf(stderr, "usage: %s [-f] [-s table | json] [-t trace.json]\n", *argv);
+				return 1;
+		}
+	STAT_PHASE(STAT_SETUP);
+
+	/*
+	 * Every page links to the assets by their fingerprinted names, so when
+	 * any of them changes, every page that is older than ASSETS_HEAD has to
+	 * be rendered again. Without it, the pages link to no assets at all,
+	 * until assets is run.
+	 */
+	if ((HEAD = head_load()) == NULL || stat(ASSETS_HEAD, &head_st))
+	{
+		fprintf(stderr, "%s: cannot read %s (run assets first), the pages won't have any assets\n",
+				*argv, ASSETS_HEAD);
+		free(HEAD);
+		if ((HEAD = strdup("")) == NULL)
+			return 1;
+		memset(&head_st, 0, sizeof(head_st));
+	}
+	weight_head(&BASE, HEAD);
+
+	/*
+	 * ASSETS_CSS is written along with ASSETS_HEAD, so it is only ever as
+	 * stale as the pages are. Without it, every page just links to the
+	 * stylesheet.
+	 */
+	if (!css_load(&CSS, ASSETS_CSS) && !split_head())
+		css_free(&CSS);
+
+	arena_init(&arena);
+	doc.arena    = &arena;
+	doc.fragment = false;
+
+	/*
+	 * <img src>s are relative to the post's source. Local images end up in
+	 * the page itself or in DEST_DIR/IMAGES_DIR (see images.c).
+	 */
+	imgcache_load(&images, IMAGES_FILE);
+	doc.images   = &images;
+	doc.base_dir = SOURCE_DIR;
+
+	if ((mkdir(CACHE_DIR, 0755) && errno != EEXIST) || (mkdir(SEARCH_DIR, 0755) && errno != EEXIST)
+			|| (mkdir(LINKS_DIR, 0755) && errno != EEXIST)
+			|| (mkdir(DEST_DIR "/" IMAGES_DIR, 0755) && errno != EEXIST))
+	{
+		fprintf(stderr, "%s: cannot create directories: %s, %s, %s/%s\n",
+				*argv, SEARCH_DIR, LINKS_DIR, DEST_DIR, IMAGES_DIR);
+		return 1;
+	}
+
+	/*
+	 * The graph is from the last run of index, which is good enough for
+	 * picking what to prefetch
+	 */
+	linkgraph_load(&GRAPH, LINKGRAPH_FILE);
+
+	/*
+	 * The characters the pages use only ever grow, so the posts that aren't
+	 * rendered again are already in GLYPHS_FILE. Without it, every post is.
+	 */
+	have_glyphs = !glyphs_load(&GLYPHS, GLYPHS_FILE);
+
+	/* Posts that aren't rendered again weigh what they did last time */
+	weights_load(&before, WEIGHT_FILE);
+	memset(&weights, 0, sizeof(weights));
+
+	/*
+	 * The site-wide link definitions are mapped once, for every post. When
+	 * they change, every page that is older than them is rendered again.
+	 */
+	if (linkdefs_open(&linkdefs, LINKDEFS_FILE, LINKDEFS_CACHE))
+		fprintf(stderr, "%s: cannot compile %s into %s\n", *argv, LINKDEFS_FILE, LINKDEFS_CACHE);
+	if (stat(LINKDEFS_CACHE, &defs_st))
+		defs_st = head_st;
+	doc.linkdefs = &linkdefs;
+
+	if (postdb_open(&db, POSTDB_FILE, true))
+	{
+		fprintf(stderr, "%s: cannot open post database: %s\n", *argv, POSTDB_FILE);
+		return 1;
+	}
 
 	if ((dir = opendir(SOURCE_DIR)) == NULL)
 	{
@@ -155,10 +451,14 @@ main(int argc, const char **argv)
 		return 1;
 	}
 
+	trace_span("load", NULL, start, -1);
+	STAT_PHASE(STAT_SCAN);
+	scan = trace_start();
 	while ((dirent = readdir(dir)) != NULL)
 	{
 		char *name = dirent->d_name;
-		if (!memcmp(strrchr(name, '.'), SOURCE_EXT, strlen(SOURCE_EXT)))
+		char *ext  = strrchr(name, '.');	// NULL for eg. a directory of images
+		if (ext != NULL && !strcmp(ext, SOURCE_EXT))
 		{
 			/* Copy name to new_name */
 			char new_name[FILENAME_MAX];
@@ -168,22 +468,91 @@ main(int argc, const char **argv)
 			char *p = strrchr(new_name, '.');
 			memmove(p, ".html", 6);		// 6, because ".html" has \0 at end
 
+			/*
+			 * Skip the post if neither it nor anything it includes
+			 * has changed since it was last rendered, and its output
+			 * is still around.
+			 */
+			char path[2 * FILENAME_MAX];
+			char links[2 * FILENAME_MAX];
+			struct stat src_st, dest_st;
+			struct postdb_record *rec;
+
+			snprintf(path, sizeof(path), "%s/%s", SOURCE_DIR, name);
+			if (stat(path, &src_st))
+				continue;
+			snprintf(links, sizeof(links), "%s/%s.links", LINKS_DIR, new_name);
+			snprintf(path, sizeof(path), "%s/%s", DEST_DIR, new_name);
+			if (!force
+					&& (rec = postdb_find(&db, new_name)) != NULL
+					&& rec->mtime == MTIME_NS(src_st)
+					&& rec->size  == src_st.st_size
+					&& !stat(path, &dest_st)
+					&& MTIME_NS(dest_st) >= MTIME_NS(head_st)
+					&& MTIME_NS(dest_st) >= MTIME_NS(defs_st)
+					&& !stat(links, &dest_st)
+					&& deps_fresh(postdb_str(&db, rec->deps))
+					&& have_glyphs
+					&& (was = weights_find(&before, new_name)) != NULL)
+			{
+				postdb_keep(&db, rec);
+				weights_add(&weights, new_name, was);
+				continue;
+			}
+
 			/* Open source file */
+			post_start = start = trace_start();
 			if (cd(SOURCE_DIR))
 				return 1;
 			sfp = fopen(name, "r");
 			cd("..");
-
-			/* Open destination file */
-			if (cd(DEST_DIR))
-				return 1;
-			dfp = fopen(new_name, "w");
-			cd("..");
+			PROBE1(file__open, name);
+			trace_span("open", name, start, -1);
 
 			/* Process file content and close files  */
-			process_file(sfp, dfp);
+			doc.search  = search_doc_new(&arena);
+			doc.links   = links_doc_new(&arena);
+			doc.nimages = 0;
+			doc.deps    = NULL;
+			doc.weight  = &weight;
+			weight      = BASE;
+			STAT_PHASE(STAT_RENDER);
+			if (process_file(sfp, path, &doc, &header))
+				fprintf(stderr, "%s: cannot write %s\n", *argv, path);
+			if (header.created == 0 || header.modified == 0)
+				fprintf(stderr, "%s: %s: dates must be DD/MM/YYYY: %s, %s\n",
+						*argv, name, header.DATE_CREATED, header.DATE_MODIFIED);
 			fclose(sfp);
-			fclose(dfp);
+			PROBE2(file__close, name, src_st.st_size);
+			weights_add(&weights, new_name, &weight);
+
+			/* Keep the post's terms, for index to build the search index */
+			STAT_PHASE(STAT_SAVE);
+			start = trace_start();
+			snprintf(path, sizeof(path), "%s/%s.terms", SEARCH_DIR, new_name);
+			search_doc_save(doc.search, path);
+
+			/* And its anchors and links, for index to check them */
+			links_doc_save(doc.links, links);
+
+			/* Remember what index needs to know about this post */
+			struct postdb_post post = {
+				.name		= new_name,
+				.title		= header.TITLE,
+				.created	= header.created,
+				.modified	= header.modified,
+				.tags		= header.TAGS,
+				.deps		= deps_list(&doc),
+				.mtime		= MTIME_NS(src_st),
+				.size		= src_st.st_size,
+			};
+			postdb_put(&db, &post);
+
+			/* Everything the document allocated goes away in one go */
+			arena_reset(&arena);
+			trace_span("save", new_name, start, -1);
+			trace_span("post", name, post_start, src_st.st_size);
+			STAT_PHASE(STAT_SCAN);
 
 #ifdef PRINT_FILENAMES
 			printf("%s -> %s\n", name, new_name);
@@ -191,6 +560,43 @@ main(int argc, const char **argv)
 		}
 	}
 	closedir(dir);
+	trace_span("scan", SOURCE_DIR, scan, -1);
+	STAT_PHASE(STAT_SAVE);
+	start = trace_start();
+	postdb_close(&db);
+	if (imgcache_save(&images, IMAGES_FILE))
+		fprintf(stderr, "%s: cannot write %s\n", *argv, IMAGES_FILE);
+	imgcache_free(&images);
+	linkgraph_free(&GRAPH);
+	linkdefs_close(&linkdefs);
+	fragments_free();
+	css_used_free(&USED);
+	css_free(&CSS);
+	if ((NEW_GLYPHS > 0 || !have_glyphs) && glyphs_save(&GLYPHS, GLYPHS_FILE))
+		fprintf(stderr, "%s: cannot write %s\n", *argv, GLYPHS_FILE);
+	trace_span("save", NULL, start, -1);
+
+	/* Every post's weight, against the budgets and the last build */
+	start = trace_start();
+	struct outfile report;
+	FILE *fp;
+	over = 0;
+	if ((fp = outfile_open(&report, WEIGHT_REPORT)) != NULL)
+		over = weights_report(&weights, &before, fp);
+	if (fp == NULL || outfile_close(&report) == -1)
+		fprintf(stderr, "%s: cannot write %s\n", *argv, WEIGHT_REPORT);
+	if (weights_save(&weights, WEIGHT_FILE))
+		fprintf(stderr, "%s: cannot write %s\n", *argv, WEIGHT_FILE);
+	weights_free(&weights);
+	weights_free(&before);
+	trace_span("weight", NULL, start, -1);
+
+	if (STATS.enabled)
+		stats_print(&arena, stderr, format);
+	arena_free(&arena);
+	free(HEAD);
+	free(STYLESHEET);
+	return over > 0;
 }
 
 // vim:noet:ts=4:sts=0:sw=0:fdm=syntax
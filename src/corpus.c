@@ -0,0 +1,268 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * stdbool.h	- bool, true, false
+ * stdio.h	- fopen(), fprintf(), fputs()
+ * string.h	- strlen(), strcat()
+ */
+
+#include "include/corpus.h"
+
+/*
+ * Synthetic posts, for benchmarking.
+ *
+ * Every post is generated from the seed and its own number, so a corpus is
+ * the same on every machine. The posts use every construct that htmlize()
+ * knows - headings, paragraphs with bold, italic, code, character references,
+ * links and footnotes, code blocks, tables and lists - in roughly the
+ * proportions of the real ones.
+ */
+
+#define CHANCE(rng, n)	(corpus_next(rng) % 100 < (n))
+#define PICK(rng, a)	((a)[corpus_next(rng) % (sizeof(a) / sizeof(*(a)))])
+#define LINE_WIDTH	72
+
+static const char *const WORDS[] = {
+	"the", "of", "and", "a", "to", "in", "is", "it", "that", "for", "on",
+	"with", "as", "this", "be", "at", "by", "from", "or", "an", "not",
+	"file", "shell", "kernel", "process", "memory", "page", "buffer",
+	"pointer", "string", "function", "compiler", "linker", "signal",
+	"socket", "terminal", "editor", "config", "build", "cache", "thread",
+	"simple", "faster", "portable", "broken", "quietly", "really", "every",
+	"write", "read", "parse", "render", "allocate", "return", "call",
+	"café", "naïve", "résumé", "Ελληνικά", "日本語",
+};
+
+static const char *const CHARREFS[] = {
+	"&amp;", "&copy;", "&mdash;", "&ndash;", "&nbsp;", "&#x263A;", "&#8364;",
+};
+
+static const char *const TAGS[] = {
+	"C", "Unix tips", "Linux", "Shell", "Vim", "Networking", "Build systems",
+};
+
+static const char *const CODE[] = {
+	"#include <stdio.h>",
+	"int main(int argc, char **argv)",
+	"{",
+	"\tfor (int i = 0; i < argc; i++)",
+	"\t\tprintf(\"%s\\n\", argv[i]);",
+	"\treturn 0;",
+	"}",
+	"$ make CFLAGS=-O2 && ./a.out < input.txt",
+};
+
+
+/**** [START] Random numbers ****/
+void
+corpus_seed(struct corpus_rng *rng, uint64_t seed)
+{
+	rng->state = seed;
+}
+
+uint64_t
+corpus_next(struct corpus_rng *rng)
+/*
+ * splitmix64
+ */
+{
+	uint64_t z = (rng->state += 0x9E3779B97F4A7C15);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EB;
+	return z ^ (z >> 31);
+}
+
+static unsigned
+between(struct corpus_rng *rng, unsigned lo, unsigned hi)
+{
+	return lo + corpus_next(rng) % (hi - lo + 1);
+}
+/**** [END] Random numbers ****/
+
+
+/**** [START] Writing posts ****/
+struct writer {
+	FILE		*out;
+	size_t		 column;
+	unsigned	 links;		/* Link definitions owed after this paragraph */
+	unsigned	 footnotes;
+};
+
+static void
+word(struct writer *w, const char *s)
+/*
+ * Wraps the text, since htmlize() only looks MAX_LINE_LENGTH bytes ahead
+ */
+{
+	size_t len = strlen(s);
+	if (w->column > 0 && w->column + 1 + len > LINE_WIDTH)
+	{
+		fputc('\n', w->out);
+		w->column = 0;
+	}
+	else if (w->column > 0)
+	{
+		fputc(' ', w->out);
+		w->column++;
+	}
+	fputs(s, w->out);
+	w->column += len;
+}
+
+static void
+sentence(struct corpus_rng *rng, struct writer *w, unsigned words, const char *end, bool refs)
+/*
+ * *end goes right after the last word. Links and footnotes only go where
+ * refs is true, ie. in paragraphs, which are followed by link definitions.
+ */
+{
+	char buf[128];
+
+	for (unsigned i = 0; i < words; i++)
+	{
+		const char *s = PICK(rng, WORDS);
+		unsigned kind = corpus_next(rng) % 100;
+
+		if (kind < 4)
+			snprintf(buf, sizeof(buf), "*%s*", s);
+		else if (kind < 8)
+			snprintf(buf, sizeof(buf), "_%s_", s);
+		else if (kind < 11)
+			snprintf(buf, sizeof(buf), "`%s()`", s);
+		else if (kind < 13)
+			snprintf(buf, sizeof(buf), "%s", PICK(rng, CHARREFS));
+		else if (kind < 15 && refs)
+			snprintf(buf, sizeof(buf), "!(l%u)[%s %s]", ++w->links, s, PICK(rng, WORDS));
+		else if (kind < 16 && refs && w->footnotes < 9)
+			snprintf(buf, sizeof(buf), "%s[^%u]", s, ++w->footnotes);
+		else
+			snprintf(buf, sizeof(buf), "%s", s);
+		if (i == words - 1)
+			strcat(buf, end);
+		word(w, buf);
+	}
+}
+
+static void
+paragraph(struct corpus_rng *rng, struct writer *w, unsigned long number, unsigned long total)
+{
+	unsigned first = w->links;
+
+	w->column = 0;
+	for (unsigned i = between(rng, 1, 5); i > 0; i--)
+		sentence(rng, w, between(rng, 6, 20), ".", true);
+	fputc('\n', w->out);
+
+	/* Most links go to other posts, some to their headings, some away */
+	for (unsigned i = first + 1; i <= w->links; i++)
+	{
+		unsigned long to = 1 + corpus_next(rng) % total;
+		unsigned kind = corpus_next(rng) % 10;
+		if (kind < 6)
+			fprintf(w->out, "\t[l%u]: %lu-post.html\n", i, to);
+		else if (kind < 8)
+			fprintf(w->out, "\t[l%u]: %lu-post.html#Introduction\n", i, to);
+		else
+			fprintf(w->out, "\t[l%u]: https://example.com/%lu/%u\n", i, number, i);
+	}
+	fputc('\n', w->out);
+}
+
+void
+corpus_post(struct corpus_rng *rng, unsigned long number, unsigned long total, FILE *out)
+{
+	struct writer w = { out, 0, 0, 0 };
+	unsigned year = between(rng, 2015, 2025), month = between(rng, 1, 12);
+	unsigned day = between(rng, 1, 28);
+
+	/* Header */
+	fprintf(out, "Post %lu: %s %s\n", number, PICK(rng, WORDS), PICK(rng, WORDS));
+	fprintf(out, "%02u/%02u/%04u\n", day, month, year);
+	fprintf(out, "%02u/%02u/%04u\n", day, month, year + (CHANCE(rng, 30) ? 1 : 0));
+	fprintf(out, "tags: %s, %s\n", PICK(rng, TAGS), PICK(rng, TAGS));
+	fputs("---\n", out);
+	sentence(rng, &w, between(rng, 4, 10), "", false);
+	fputs("\n---\n", out);
+
+	fputs("# Introduction\n", out);
+	paragraph(rng, &w, number, total);
+
+	for (unsigned section = between(rng, 1, 6); section > 0; section--)
+	{
+		fprintf(out, "## %s %s %s\n", PICK(rng, WORDS), PICK(rng, WORDS), PICK(rng, WORDS));
+		for (unsigned i = between(rng, 1, 4); i > 0; i--)
+			paragraph(rng, &w, number, total);
+
+		unsigned kind = corpus_next(rng) % 100;
+		if (kind < 35)
+		{
+			fputs("```\n", out);
+			for (unsigned i = between(rng, 3, 12); i > 0; i--)
+				fprintf(out, "%s\n", PICK(rng, CODE));
+			fputs("```\n\n", out);
+		}
+		else if (kind < 50)
+		{
+			fputs("<table>\n", out);
+			for (unsigned i = between(rng, 2, 8); i > 0; i--)
+				fprintf(out, "%s | %s | %u\n", PICK(rng, WORDS), PICK(rng, WORDS), between(rng, 0, 9999));
+			fputs("</table>\n\n", out);
+		}
+		else if (kind < 70)
+		{
+			const char *list = CHANCE(rng, 50) ? "ul" : "ol";
+			fprintf(out, "<%s>\n", list);
+			for (unsigned i = between(rng, 2, 7); i > 0; i--)
+			{
+				fputs("- ", out);
+				w.column = 2;
+				sentence(rng, &w, between(rng, 2, 8), "", false);
+				fputc('\n', out);
+			}
+			fprintf(out, "</%s>\n\n", list);
+		}
+	}
+
+	if (w.footnotes > 0)
+	{
+		fputs("^^^\n", out);
+		for (unsigned i = 1; i <= w.footnotes; i++)
+		{
+			fprintf(out, "%u:", i);
+			w.column = 2;
+			sentence(rng, &w, between(rng, 3, 12), ".", false);
+			fputc('\n', out);
+		}
+	}
+}
+
+long long
+corpus_write(const char *dir, unsigned long count, uint64_t seed)
+/*
+ * Writes posts 1 to count into dir, as <number>-post.blog. Returns the
+ * total size of the posts, or -1 if a file couldn't be written.
+ */
+{
+	struct corpus_rng rng;
+	char path[FILENAME_MAX];
+	long long bytes = 0;
+	FILE *fp;
+
+	for (unsigned long n = 1; n <= count; n++)
+	{
+		corpus_seed(&rng, seed ^ (n * 0xD1B54A32D192ED03));
+		snprintf(path, sizeof(path), "%s/%lu-post.blog", dir, n);
+		if ((fp = fopen(path, "w")) == NULL)
+			return -1;
+		corpus_post(&rng, n, count, fp);
+		bytes += ftell(fp);
+		if (fclose(fp))
+			return -1;
+	}
+	return bytes;
+}
+/**** [END] Writing posts ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,505 @@
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/*
+ * ctype.h	- isalpha(), isalnum(), isspace(), tolower()
+ * stdbool.h	- bool, true, false
+ * stdint.h	- uint64_t
+ * stdio.h	- fopen(), fread(), fwrite()
+ * stdlib.h	- malloc(), realloc(), calloc(), free()
+ * string.h	- mem*(), str*()
+ * strings.h	- strncasecmp()
+ */
+
+#include "include/css.h"
+#include "include/hash.h"
+
+/*
+ * Tags, classes and ids are all kept as hashes of their kind ('t', 'c' or
+ * 'i') and name, tags lowercased. A collision can only make a rule look
+ * used, so it costs bytes, never a rule that applies.
+ */
+#define MAX_NAME 64
+
+static uint64_t
+key(char kind, const char *name, size_t len)
+{
+	char buf[1 + MAX_NAME];
+
+	buf[0] = kind;
+	for (size_t i = 0; i < len; i++)
+		buf[1 + i] = kind == 't' ? tolower((unsigned char)name[i]) : name[i];
+	return hash_bytes(buf, 1 + len) | 1;	// 0 ends a selector
+}
+
+static bool
+is_name(int c)
+{
+	return isalnum(c) || c == '-' || c == '_' || c >= 0x80;
+}
+
+static size_t
+name_len(const char *p, const char *end)
+{
+	const char *start = p;
+	while (p < end && is_name((unsigned char)*p))
+		p++;
+	return p - start;
+}
+
+
+/**** [START] Parsing ****/
+static const char *
+skip_string(const char *p, const char *end)
+/*
+ * Past the string that starts at p
+ */
+{
+	int quote = *p++;
+	for (; p < end && *p != quote; p++)
+		if (*p == '\\' && p + 1 < end)
+			p++;
+	return p < end ? p + 1 : end;
+}
+
+static const char *
+statement_end(const char *p, const char *end)
+/*
+ * Past the statement at p: its ';', or the '}' that closes its block
+ */
+{
+	int depth = 0;
+	while (p < end)
+	{
+		if (*p == '"' || *p == '\'')
+		{
+			p = skip_string(p, end);
+			continue;
+		}
+		if (*p == '{')
+			depth++;
+		else if (*p == '}' && --depth <= 0)
+			return p + 1;
+		else if (*p == ';' && depth == 0)
+			return p + 1;
+		p++;
+	}
+	return end;
+}
+
+static bool
+add_need(struct css *css, uint64_t need)
+{
+	if (css->nneeds == css->needs_size)
+	{
+		size_t size = css->needs_size ? 2 * css->needs_size : 256;
+		uint64_t *needs = realloc(css->needs, size * sizeof(*needs));
+		if (needs == NULL)
+			return false;
+		css->needs      = needs;
+		css->needs_size = size;
+	}
+	css->needs[css->nneeds++] = need;
+	return true;
+}
+
+static bool
+parse_selectors(struct css *css, struct css_rule *rule, const char *p, const char *end)
+/*
+ * Fills in what the rule's selectors (in [p, end)) need, or nothing if one
+ * of them might match without any of it
+ */
+{
+	size_t start = css->nneeds, count = 0;
+	bool always = false, compound = true;	// At the start of a compound selector
+	size_t len;
+
+	while (p < end && !always)
+	{
+		char c = *p;
+		if (c == ',')
+		{
+			always = count == 0;
+			if (!add_need(css, 0))
+				return false;
+			count = 0;
+			compound = true;
+			p++;
+		}
+		else if (c == ' ' || c == '>' || c == '+' || c == '~')
+		{
+			compound = true;
+			p++;
+		}
+		else if ((c == '.' || c == '#') && (len = name_len(p + 1, end)) > 0 && len <= MAX_NAME)
+		{
+			if (!add_need(css, key(c == '.' ? 'c' : 'i', p + 1, len)))
+				return false;
+			count++;
+			compound = false;
+			p += 1 + len;
+		}
+		else if (compound && isalpha((unsigned char)c) && (len = name_len(p, end)) <= MAX_NAME)
+		{
+			if (!add_need(css, key('t', p, len)))
+				return false;
+			count++;
+			compound = false;
+			p += len;
+		}
+		else if (c == ':')
+		{
+			/* Pseudo-classes and -elements, with their arguments */
+			p += p + 1 < end && p[1] == ':' ? 2 : 1;
+			p += name_len(p, end);
+			for (int depth = 0; p < end && (depth > 0 || *p == '('); p++)
+				if (*p == '(')
+					depth++;
+				else if (*p == ')')
+					depth--;
+			compound = false;
+		}
+		else if (c == '[')
+		{
+			/* Attribute selectors */
+			while (p < end && *p != ']')
+				p = *p == '"' || *p == '\'' ? skip_string(p, end) : p + 1;
+			p += p < end;
+			compound = false;
+		}
+		else if (c == '*')
+		{
+			compound = false;
+			p++;
+		}
+		else
+			always = true;	// Escapes, namespaces, and whatever else
+	}
+	if (count == 0)
+		always = true;
+
+	if (always)
+	{
+		css->nneeds  = start;
+		rule->needs  = 0;
+		rule->nneeds = 0;
+	}
+	else
+	{
+		if (!add_need(css, 0))
+			return false;
+		rule->needs  = start;
+		rule->nneeds = css->nneeds - start;
+	}
+	return true;
+}
+
+static bool
+is_block(const char *p)
+/*
+ * Whether the at-rule at p holds rules, as opposed to declarations
+ */
+{
+	static const char *const BLOCKS[] = { "@media", "@supports", "@layer", "@container" };
+	for (size_t i = 0; i < sizeof(BLOCKS) / sizeof(*BLOCKS); i++)
+		if (!strncmp(p, BLOCKS[i], strlen(BLOCKS[i])))
+			return true;
+	return false;
+}
+
+static bool
+parse_rules(struct css *css, const char *p, const char *end)
+{
+	while (p < end)
+	{
+		const char *next  = statement_end(p, end);
+		const char *brace = memchr(p, '{', next - p);
+		size_t i = css->nrules;
+
+		if (css->nrules == css->rules_size)
+		{
+			size_t size = css->rules_size ? 2 * css->rules_size : 64;
+			struct css_rule *rules = realloc(css->rules, size * sizeof(*rules));
+			if (rules == NULL)
+				return false;
+			css->rules      = rules;
+			css->rules_size = size;
+		}
+		css->rules[i] = (struct css_rule){ .text = p, .len = next - p };
+		css->nrules++;
+
+		if (*p == '@')
+		{
+			if (brace != NULL && is_block(p) && next[-1] == '}')
+			{
+				css->rules[i].prelude = brace + 1 - p;
+				if (!parse_rules(css, brace + 1, next - 1))
+					return false;
+				css->rules[i].inside = css->nrules - i - 1;
+			}
+		}
+		else if (brace != NULL && !parse_selectors(css, &css->rules[i], p, brace))
+			return false;
+		p = next;
+	}
+	return true;
+}
+
+int
+css_load(struct css *css, const char *path)
+/*
+ * Reads and indexes the (minified) stylesheet at *path. Returns 1 if it
+ * can't, which leaves *css empty.
+ */
+{
+	FILE *fp;
+	long size;
+
+	memset(css, 0, sizeof(*css));
+	if ((fp = fopen(path, "r")) == NULL)
+		return 1;
+	if (!fseek(fp, 0, SEEK_END) && (size = ftell(fp)) >= 0 && !fseek(fp, 0, SEEK_SET)
+			&& (css->text = malloc(size + 1)) != NULL)
+		css->text[css->len = fread(css->text, 1, size, fp)] = '\0';
+	fclose(fp);
+
+	if (css->text == NULL || !parse_rules(css, css->text, css->text + css->len))
+	{
+		css_free(css);
+		return 1;
+	}
+	return 0;
+}
+
+void
+css_free(struct css *css)
+{
+	free(css->text);
+	free(css->rules);
+	free(css->needs);
+	memset(css, 0, sizeof(*css));
+}
+/**** [END] Parsing ****/
+
+
+/**** [START] Pages ****/
+static void
+use(struct css_used *used, uint64_t k)
+{
+	if (2 * (used->count + 1) > used->nslots)
+	{
+		size_t nslots = used->nslots ? 2 * used->nslots : 256;
+		uint64_t *slots = calloc(nslots, sizeof(*slots));
+		if (slots == NULL)
+			return;
+		for (size_t i = 0; i < used->nslots; i++)
+			if (used->slots[i] != 0)
+			{
+				size_t h = used->slots[i] & (nslots - 1);
+				while (slots[h] != 0)
+					h = (h + 1) & (nslots - 1);
+				slots[h] = used->slots[i];
+			}
+		free(used->slots);
+		used->slots  = slots;
+		used->nslots = nslots;
+	}
+
+	size_t h = k & (used->nslots - 1);
+	for (; used->slots[h] != 0; h = (h + 1) & (used->nslots - 1))
+		if (used->slots[h] == k)
+			return;
+	used->slots[h] = k;
+	used->count++;
+}
+
+static bool
+is_used(const struct css_used *used, uint64_t k)
+{
+	if (used->nslots == 0)
+		return false;
+	for (size_t h = k & (used->nslots - 1); used->slots[h] != 0; h = (h + 1) & (used->nslots - 1))
+		if (used->slots[h] == k)
+			return true;
+	return false;
+}
+
+static void
+use_names(struct css_used *used, char kind, const char *p, const char *end)
+/*
+ * Every name in a class="..." (or the one in an id="...")
+ */
+{
+	while (p < end)
+	{
+		while (p < end && isspace((unsigned char)*p))
+			p++;
+		const char *name = p;
+		while (p < end && !isspace((unsigned char)*p))
+			p++;
+		if (p > name && p - name <= MAX_NAME)
+			use(used, key(kind, name, p - name));
+	}
+}
+
+void
+css_used_scan(struct css_used *used, const char *html, size_t len)
+/*
+ * Adds the tags, classes and ids in html to the set
+ */
+{
+	const char *p = html, *end = html + len;
+
+	while (p < end && (p = memchr(p, '<', end - p)) != NULL)
+	{
+		p++;
+		if (end - p >= 3 && !memcmp(p, "!--", 3))
+		{
+			const char *close = NULL;
+			for (const char *q = p + 3; q + 3 <= end && close == NULL; q++)
+				if (!memcmp(q, "-->", 3))
+					close = q + 3;
+			p = close != NULL ? close : end;
+			continue;
+		}
+		if (p == end || !isalpha((unsigned char)*p))
+			continue;
+
+		size_t n = name_len(p, end);
+		if (n <= MAX_NAME)
+			use(used, key('t', p, n));
+		p += n;
+
+		/* The attributes, up to the '>' */
+		while (p < end && *p != '>')
+		{
+			if (isspace((unsigned char)*p) || *p == '/')
+			{
+				p++;
+				continue;
+			}
+			const char *name = p, *value = NULL, *value_end = NULL;
+			while (p < end && !isspace((unsigned char)*p) && *p != '=' && *p != '>' && *p != '/')
+				p++;
+			size_t name_len = p - name;
+			if (p < end && *p == '=')
+			{
+				p++;
+				if (p < end && (*p == '"' || *p == '\''))
+				{
+					const char *close = memchr(p + 1, *p, end - p - 1);
+					value     = p + 1;
+					value_end = close != NULL ? close : end;
+					p = close != NULL ? close + 1 : end;
+				}
+				else
+				{
+					value = p;
+					while (p < end && !isspace((unsigned char)*p) && *p != '>')
+						p++;
+					value_end = p;
+				}
+			}
+			if (value == NULL)
+				continue;
+			if (name_len == 5 && !strncasecmp(name, "class", 5))
+				use_names(used, 'c', value, value_end);
+			else if (name_len == 2 && !strncasecmp(name, "id", 2))
+				use_names(used, 'i', value, value_end);
+		}
+	}
+}
+
+void
+css_used_clear(struct css_used *used)
+{
+	if (used->slots != NULL)
+		memset(used->slots, 0, used->nslots * sizeof(*used->slots));
+	used->count = 0;
+}
+
+void
+css_used_free(struct css_used *used)
+{
+	free(used->slots);
+	memset(used, 0, sizeof(*used));
+}
+
+static bool
+applies(const struct css *css, const struct css_used *used, const struct css_rule *rule)
+/*
+ * Whether any of the rule's selectors might match something on the page
+ */
+{
+	if (rule->nneeds == 0)
+		return true;
+
+	bool all = true;
+	for (const uint64_t *need = css->needs + rule->needs; need < css->needs + rule->needs + rule->nneeds; need++)
+		if (*need == 0)
+		{
+			if (all)
+				return true;
+			all = true;
+		}
+		else if (all && !is_used(used, *need))
+			all = false;
+	return false;
+}
+
+static size_t
+print_rules(const struct css *css, const struct css_used *used, size_t i, size_t n, FILE *out)
+/*
+ * Prints what applies of rules i to i + n (a block's, with those inside
+ * its blocks). Returns how many it printed.
+ */
+{
+	size_t printed = 0;
+
+	for (size_t end = i + n; i < end; i++)
+	{
+		const struct css_rule *rule = &css->rules[i];
+		if (rule->prelude == 0)
+		{
+			if (applies(css, used, rule))
+			{
+				fwrite(rule->text, 1, rule->len, out);
+				printed++;
+			}
+			continue;
+		}
+
+		/* A block is only printed if something in it is */
+		long start = ftell(out);
+		fwrite(rule->text, 1, rule->prelude, out);
+		size_t inner = print_rules(css, used, i + 1, rule->inside, out);
+		if (inner > 0)
+		{
+			fputc('}', out);
+			printed++;
+		}
+		else if (start >= 0)
+			fseek(out, start, SEEK_SET);
+		i += rule->inside;
+	}
+	return printed;
+}
+
+void
+css_print_used(const struct css *css, const struct css_used *used, FILE *out)
+/*
+ * Prints the rules that might apply to the page whose set *used is. out
+ * has to be seekable (eg. an open_memstream()), so that empty blocks can
+ * be taken back.
+ */
+{
+	print_rules(css, used, 0, css->nrules, out);
+}
+/**** [END] Pages ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,198 @@
+#define _XOPEN_SOURCE 700
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * stdbool.h	- bool, true, false
+ * stdio.h	- getline()
+ * stdlib.h	- realloc(), free()
+ * string.h	- memchr(), memcpy(), memset()
+ */
+
+#include "include/csv.h"
+
+void
+csv_open(struct csv *csv, FILE *fp, char sep)
+{
+	memset(csv, 0, sizeof(*csv));
+	csv->fp  = fp;
+	csv->sep = sep;
+}
+
+void
+csv_open_mem(struct csv *csv, char *mem, size_t len, char sep)
+/*
+ * Reads the len bytes at mem, which are overwritten as they are read, and
+ * must be followed by a '\0'
+ */
+{
+	memset(csv, 0, sizeof(*csv));
+	csv->mem     = mem;
+	csv->mem_len = len;
+	csv->sep     = sep;
+}
+
+static bool
+next_line(struct csv *csv)
+/*
+ * Points csv->p and csv->end at the next line, without its "\r\n"
+ */
+{
+	size_t len;
+
+	if (csv->fp != NULL)
+	{
+		ssize_t n = getline(&csv->line, &csv->line_size, csv->fp);
+		if (n == -1)
+			return false;
+		csv->p = csv->line;
+		len = n;
+	}
+	else
+	{
+		if (csv->mem_len == 0)
+			return false;
+		char *nl = memchr(csv->mem, '\n', csv->mem_len);
+		len = nl != NULL ? (size_t)(nl - csv->mem) + 1 : csv->mem_len;
+		csv->p        = csv->mem;
+		csv->mem     += len;
+		csv->mem_len -= len;
+	}
+
+	csv->end = csv->p + len;
+	if (csv->end > csv->p && csv->end[-1] == '\n')
+		csv->end--;
+	if (csv->end > csv->p && csv->end[-1] == '\r')
+		csv->end--;
+	return true;
+}
+
+static bool
+append(struct csv *csv, size_t *len, const char *s, size_t n)
+{
+	if (*len + n + 1 > csv->quoted_size)
+	{
+		size_t size = csv->quoted_size ? 2 * csv->quoted_size : 256;
+		while (size < *len + n + 1)
+			size *= 2;
+		char *quoted = realloc(csv->quoted, size);
+		if (quoted == NULL)
+			return false;
+		csv->quoted      = quoted;
+		csv->quoted_size = size;
+	}
+	memcpy(csv->quoted + *len, s, n);
+	*len += n;
+	csv->quoted[*len] = '\0';
+	return true;
+}
+
+static int
+end_field(struct csv *csv, char *at)
+/*
+ * The field ends at the separator (or the end of the line) that *at is
+ */
+{
+	if (at == csv->end)
+	{
+		csv->p = NULL;
+		return CSV_LAST;
+	}
+	csv->p = at + 1;
+	return CSV_FIELD;
+}
+
+static int
+quoted_field(struct csv *csv)
+{
+	char *s = csv->p + 1, *quote;
+	size_t len = 0;
+
+	if (!append(csv, &len, "", 0))
+		return CSV_ERROR;
+	for (;;)
+	{
+		if ((quote = memchr(s, '"', csv->end - s)) == NULL)
+		{
+			/* The field goes on, on the next line */
+			if (!append(csv, &len, s, csv->end - s) || !append(csv, &len, "\n", 1))
+				return CSV_ERROR;
+			if (!next_line(csv))
+			{
+				csv->p = csv->end = NULL;	// It ended with the file
+				csv->quoted[--len] = '\0';
+				quote = NULL;
+				break;
+			}
+			s = csv->p;
+			continue;
+		}
+		if (!append(csv, &len, s, quote - s))
+			return CSV_ERROR;
+		s = quote + 1;
+		if (s < csv->end && *s == '"')	// "" is a quote
+		{
+			if (!append(csv, &len, "\"", 1))
+				return CSV_ERROR;
+			s++;
+			continue;
+		}
+		break;
+	}
+
+	/* Whatever is between the closing quote and the separator is kept */
+	char *sep = NULL;
+	if (quote != NULL)
+	{
+		if ((sep = memchr(s, csv->sep, csv->end - s)) == NULL)
+			sep = csv->end;
+		if (!append(csv, &len, s, sep - s))
+			return CSV_ERROR;
+	}
+	csv->field = csv->quoted;
+	csv->len   = len;
+	return quote != NULL ? end_field(csv, sep) : CSV_LAST;
+}
+
+int
+csv_next(struct csv *csv)
+/*
+ * Reads the next field into csv->field and csv->len. Returns CSV_FIELD if
+ * more of its row follows, CSV_LAST if it ended the row, CSV_END if there
+ * are no more fields, or CSV_ERROR if we ran out of memory.
+ */
+{
+	if (csv->p == NULL)
+		do
+			if (!next_line(csv))
+				return CSV_END;
+		while (csv->p == csv->end);
+
+	if (*csv->p == '"')
+		return quoted_field(csv);
+
+	/* Unquoted fields are read in place */
+	char *sep = memchr(csv->p, csv->sep, csv->end - csv->p);
+	if (sep == NULL)
+		sep = csv->end;
+	csv->field = csv->p;
+	csv->len   = sep - csv->p;
+	*sep = '\0';
+	return end_field(csv, sep);
+}
+
+void
+csv_close(struct csv *csv)
+/*
+ * Frees what csv_next() allocated. The FILE is the caller's to close.
+ */
+{
+	free(csv->line);
+	free(csv->quoted);
+	csv->line   = csv->quoted = NULL;
+	csv->p      = NULL;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
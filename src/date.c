@@ -0,0 +1,172 @@
+#include <stdint.h>
+#include <string.h>
+
+/*
+ * stdint.h	- uint32_t
+ * string.h	- memcpy()
+ */
+
+#include "include/date.h"
+
+static const char MONTHS[12][5] = {
+	"Jan", "Feb", "Mar", "Apr", "May", "June",
+	"July", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+static const char MONTHS_822[12][4] = {
+	"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+	"Jul", "Aug", "Sep", "Oct", "Nov", "Dec",
+};
+static const char WEEKDAYS[7][4] = {
+	"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat",
+};
+
+
+static int
+days_in_month(unsigned year, unsigned month)
+{
+	static const unsigned char DAYS[12] = { 31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31 };
+	if (month == 2 && year % 4 == 0 && (year % 100 != 0 || year % 400 == 0))
+		return 29;
+	return DAYS[month - 1];
+}
+
+static char *
+put_digits(char *p, unsigned n, int width)
+/*
+ * Writes n with width digits (zero-padded), and returns where it stopped
+ */
+{
+	for (int i = width; i-- > 0; n /= 10)
+		p[i] = '0' + n % 10;
+	return p + width;
+}
+
+uint32_t
+date_parse(const char *date)
+/*
+ * Turns "DD/MM/YYYY" (or "D/M/YYYY") into the key YYYYMMDD. Returns 0 if
+ * *date isn't a valid date.
+ */
+{
+	unsigned part[3] = { 0, 0, 0 };
+	int digits[3]    = { 0, 0, 0 };
+
+	for (int i = 0; i < 3; i++, date++)
+	{
+		for (; *date >= '0' && *date <= '9'; date++, digits[i]++)
+			part[i] = part[i] * 10 + (*date - '0');
+		if (*date != (i < 2 ? '/' : '\0'))
+			return 0;
+	}
+	if (digits[0] < 1 || digits[0] > 2 || digits[1] < 1 || digits[1] > 2 || digits[2] != 4)
+		return 0;
+	if (part[2] == 0 || part[1] < 1 || part[1] > 12)
+		return 0;
+	if (part[0] < 1 || part[0] > (unsigned)days_in_month(part[2], part[1]))
+		return 0;
+	return part[2] * 10000 + part[1] * 100 + part[0];
+}
+
+char *
+date_text(uint32_t key, char *text)
+/*
+ * "21st June 2024", or "" if there's no date
+ */
+{
+	static const char SUFFIXES[4][3] = { "th", "st", "nd", "rd" };
+	unsigned day = DATE_DAY(key), month = DATE_MONTH(key);
+	char *p = text;
+
+	if (key == 0)
+	{
+		*text = '\0';
+		return text;
+	}
+
+	p = day >= 10 ? put_digits(p, day, 2) : put_digits(p, day, 1);
+	memcpy(p, SUFFIXES[(day / 10 == 1 || day % 10 > 3) ? 0 : day % 10], 2);
+	p += 2;
+	*p++ = ' ';
+
+	size_t len = strlen(MONTHS[month - 1]);
+	memcpy(p, MONTHS[month - 1], len);
+	p += len;
+	*p++ = ' ';
+
+	p = put_digits(p, DATE_YEAR(key), 4);
+	*p = '\0';
+	return text;
+}
+
+char *
+date_iso8601(uint32_t key, char *text)
+/*
+ * "2024-06-21", or "" if there's no date
+ */
+{
+	char *p = text;
+
+	if (key != 0)
+	{
+		p = put_digits(p, DATE_YEAR(key), 4);
+		*p++ = '-';
+		p = put_digits(p, DATE_MONTH(key), 2);
+		*p++ = '-';
+		p = put_digits(p, DATE_DAY(key), 2);
+	}
+	*p = '\0';
+	return text;
+}
+
+char *
+date_rfc3339(uint32_t key, char *text)
+/*
+ * "2024-06-21T00:00:00Z" (as in Atom feeds), or "" if there's no date
+ */
+{
+	if (key != 0)
+	{
+		date_iso8601(key, text);
+		memcpy(text + DATE_ISO8601_SIZE - 1, "T00:00:00Z", 11);
+	}
+	else
+		*text = '\0';
+	return text;
+}
+
+char *
+date_rfc822(uint32_t key, char *text)
+/*
+ * "Fri, 21 Jun 2024 00:00:00 +0000" (as in RSS feeds and HTTP headers), or
+ * "" if there's no date
+ */
+{
+	static const unsigned char OFFSETS[12] = { 0, 3, 2, 5, 0, 3, 5, 1, 4, 6, 2, 4 };
+	unsigned year = DATE_YEAR(key), month = DATE_MONTH(key), day = DATE_DAY(key);
+	char *p = text;
+
+	if (key == 0)
+	{
+		*text = '\0';
+		return text;
+	}
+
+	/* Sakamoto's day of the week, 0 being Sunday */
+	unsigned y = month < 3 ? year - 1 : year;
+	unsigned weekday = (y + y / 4 - y / 100 + y / 400 + OFFSETS[month - 1] + day) % 7;
+
+	memcpy(p, WEEKDAYS[weekday], 3);
+	p += 3;
+	*p++ = ',';
+	*p++ = ' ';
+	p = put_digits(p, day, 2);
+	*p++ = ' ';
+	memcpy(p, MONTHS_822[month - 1], 3);
+	p += 3;
+	*p++ = ' ';
+	p = put_digits(p, year, 4);
+	memcpy(p, " 00:00:00 +0000", 16);
+	return text;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
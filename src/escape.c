@@ -18,3 +18,25 @@ fputs_escaped(const char *s, FILE *stream)
 	for (int i=0; s[i] != '\0'; i++)
 		fputc_escaped(s[i], stream);
 }
+
+void
+fputs_json_escaped(const char *s, FILE *stream)
+/*
+ * Writes *s as the contents of a JSON string (without the quotes)
+ */
+{
+	for (; *s != '\0'; s++)
+		switch (*s)
+		{
+			case '"':  fputs("\\\"", stream); break;
+			case '\\': fputs("\\\\", stream); break;
+			case '\n': fputs("\\n",  stream); break;
+			case '\t': fputs("\\t",  stream); break;
+			default:
+				if ((unsigned char)*s < 0x20)
+					fprintf(stream, "\\u%04x", *s);
+				else
+					fputc(*s, stream);
+				break;
+		}
+}
@@ -0,0 +1,195 @@
+#define _XOPEN_SOURCE 700
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * stdbool.h - bool
+ * stdint.h  - uint32_t, uint64_t
+ * stdio.h   - fopen, fread, fprintf
+ * stdlib.h  - malloc, free
+ * string.h  - strstr, strlen
+ */
+
+#include "constants.h"
+#include "include/cd.h"
+#include "include/date.h"
+#include "include/escape.h"
+#include "include/outfile.h"
+#include "include/postdb.h"
+#include "include/radix.h"
+#include "include/urlencode.h"
+
+#define cd(x) \
+        cd(x, argv)
+
+/*
+ * Writes an Atom feed of the FEED_ENTRIES newest posts.
+ *
+ * The metadata comes from the post database and each entry's content is
+ * taken straight out of the HTML that blogify already wrote, between the
+ * "Blog content" markers. So, the cost is O(FEED_ENTRIES), no matter how
+ * big the site is, and nothing is htmlize()d a second time.
+ */
+
+static const char CONTENT_START[] = "<!-- Blog content starts here -->\n";
+static const char CONTENT_END[]   = "<!-- Blog content ends here -->";
+
+static const char INITIAL_TEXT[] = "\
+<?xml version=\"1.0\" encoding=\"utf-8\"?>\n\
+<feed xmlns=\"http://www.w3.org/2005/Atom\" xml:base=\"" SITE_URL "\">\n\
+  <title>" SITE_TITLE "</title>\n\
+  <author><name>" SITE_AUTHOR "</name></author>\n\
+  <id>" SITE_URL "</id>\n\
+  <link href=\"" SITE_URL "\"/>\n\
+  <link rel=\"self\" href=\"" SITE_URL "feed.xml\"/>\n\
+  <updated>%s</updated>\n\
+";
+
+static const char FINAL_TEXT[] = "\
+</feed>\n\
+";
+
+
+static char *
+read_file(const char *path, size_t *len)
+{
+	FILE *fp;
+	char *buf;
+	long size;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET))
+	{
+		fclose(fp);
+		return NULL;
+	}
+	if ((buf = malloc(size + 1)) != NULL)
+	{
+		*len = fread(buf, 1, size, fp);
+		buf[*len] = '\0';
+	}
+	fclose(fp);
+	return buf;
+}
+
+static void
+print_entry(FILE *out, const struct postdb *db, const struct postdb_record *rec)
+{
+	const char *name = postdb_str(db, rec->name);
+	char created[DATE_RFC3339_SIZE], modified[DATE_RFC3339_SIZE];
+	char url[FILENAME_MAX*3 + 1];
+	char *html, *start, *end;
+	size_t len;
+
+	urlencode_s(name, url, sizeof(url));
+	date_rfc3339(rec->created, created);
+	date_rfc3339(rec->modified ? rec->modified : rec->created, modified);
+
+	fputs("  <entry>\n    <title>", out);
+	fputs_escaped(postdb_str(db, rec->title), out);
+	fprintf(out, "</title>\n"
+			"    <id>" SITE_URL "%s</id>\n"
+			"    <link href=\"%s\"/>\n"
+			"    <published>%s</published>\n"
+			"    <updated>%s</updated>\n",
+			url, url, created, modified);
+
+	/* The body, exactly as blogify rendered it */
+	if ((html = read_file(name, &len)) != NULL
+			&& (start = strstr(html, CONTENT_START)) != NULL
+			&& (end = strstr(start, CONTENT_END)) != NULL)
+	{
+		*end = '\0';
+		fputs("    <content type=\"html\">", out);
+		fputs_escaped(start + strlen(CONTENT_START), out);
+		fputs("</content>\n", out);
+	}
+	else
+		fprintf(stderr, "feed: no rendered content in %s/%s\n", DEST_DIR, name);
+	free(html);
+
+	fputs("  </entry>\n", out);
+}
+
+int
+main(int argc, const char **argv)
+{
+	struct postdb db;
+	struct radix_item *items, *scratch, *posts;
+	struct outfile outfile;
+	FILE *out;
+	size_t count = 0;
+	uint32_t updated = 0;	// Index of the most recently modified entry
+
+	(void)argc;	// There are no options
+	if (postdb_open(&db, POSTDB_FILE, false))
+	{
+		fprintf(stderr, "%s: cannot open %s (run blogify first)\n", *argv, POSTDB_FILE);
+		return 1;
+	}
+
+	items   = malloc((db.header->count + 1) * sizeof(*items));
+	scratch = malloc((db.header->count + 1) * sizeof(*scratch));
+	if (items == NULL || scratch == NULL)
+	{
+		fprintf(stderr, "%s: out of memory\n", *argv);
+		return 1;
+	}
+
+	for (uint32_t i = 0; i < db.header->count; i++)
+	{
+		const struct postdb_record *rec = &db.records[i];
+		const char *name = postdb_str(&db, rec->name);
+		if (name[0] == '.' || name[0] == '0' || rec->created == 0)
+			continue;
+		items[count].key   = (uint64_t)rec->created << 32 | rec->number;
+		items[count].value = i;
+		count++;
+	}
+	posts = radix_sort(items, scratch, count);
+
+	/* The newest entries are at the end */
+	size_t first = count > FEED_ENTRIES ? count - FEED_ENTRIES : 0;
+	for (size_t i = first; i < count; i++)
+	{
+		const struct postdb_record *rec = &db.records[posts[i].value];
+		const struct postdb_record *max = &db.records[posts[updated].value];
+		uint32_t a = rec->modified ? rec->modified : rec->created;
+		uint32_t b = max->modified ? max->modified : max->created;
+		if (i == first || a > b)
+			updated = i;
+	}
+
+	if (cd(DEST_DIR))
+		return 1;
+	if ((out = outfile_open(&outfile, "feed.xml")) == NULL)
+		return 1;
+
+	char updated_str[DATE_RFC3339_SIZE] = "1970-01-01T00:00:00Z";
+	if (count > 0)
+	{
+		const struct postdb_record *rec = &db.records[posts[updated].value];
+		date_rfc3339(rec->modified ? rec->modified : rec->created, updated_str);
+	}
+	fprintf(out, INITIAL_TEXT, updated_str);
+	for (size_t i = count; i-- > first;)	// Newest first
+		print_entry(out, &db, &db.records[posts[i].value]);
+	fputs(FINAL_TEXT, out);
+
+	int retval = outfile_close(&outfile) == -1;
+#ifdef PRINT_FILENAMES
+	if (retval == 0)
+		printf("feed.xml\n");
+#endif /* PRINT_FILENAMES */
+
+	postdb_close(&db);
+	free(items);
+	free(scratch);
+	return retval;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax:nowrap
@@ -0,0 +1,28 @@
+#include <stdio.h>
+#include <string.h>
+
+/*
+ * stdio.h	- snprintf()
+ * string.h	- strrchr(), strlen()
+ */
+
+#include "include/fingerprint.h"
+#include "include/hash.h"
+
+void
+fingerprint_name(char *name, size_t size, const char *path, const void *data, size_t len)
+/*
+ * The name is made from the last component of path, and the hash goes
+ * right before its extension
+ */
+{
+	const char *base, *ext;
+
+	base = (base = strrchr(path, '/')) != NULL ? base + 1 : path;
+	if ((ext = strrchr(base, '.')) == NULL)
+		ext = base + strlen(base);
+	snprintf(name, size, "%.*s.%012llx%s", (int)(ext - base), base,
+			(unsigned long long)(hash_bytes(data, len) >> 16), ext);
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
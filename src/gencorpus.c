@@ -0,0 +1,66 @@
+#define _XOPEN_SOURCE 700
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * errno.h	- EEXIST
+ * stdio.h	- printf(), fprintf()
+ * stdlib.h	- strtoul(), strtoull()
+ * sys/stat.h	- mkdir()
+ * unistd.h	- getopt()
+ */
+
+#include "include/corpus.h"
+
+/*
+ * Writes a synthetic corpus of posts (see corpus.c), eg. to try out a change
+ * on more posts than there are -
+ *
+ *	gencorpus -s 42 raw 10000
+ */
+
+int
+main(int argc, char **argv)
+{
+	uint64_t seed = 1;
+	unsigned long count;
+	long long bytes;
+	char *end;
+
+	for (int opt; (opt = getopt(argc, argv, "s:")) != -1;)
+		switch (opt)
+		{
+			case 's':
+				seed = strtoull(optarg, NULL, 0);
+				break;
+			default:
+				goto usage;
+		}
+	if (argc - optind != 2)
+		goto usage;
+	count = strtoul(argv[optind + 1], &end, 10);
+	if (*end != '\0' || count == 0)
+		goto usage;
+
+	if (mkdir(argv[optind], 0755) && errno != EEXIST)
+	{
+		fprintf(stderr, "%s: cannot create directory: %s\n", *argv, argv[optind]);
+		return 1;
+	}
+	if ((bytes = corpus_write(argv[optind], count, seed)) < 0)
+	{
+		fprintf(stderr, "%s: cannot write posts into %s\n", *argv, argv[optind]);
+		return 1;
+	}
+	printf("%lu posts, %lld bytes\n", count, bytes);
+	return 0;
+
+usage:
+	fprintf(stderr, "usage: %s [-s seed] directory count\n", *argv);
+	return 1;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
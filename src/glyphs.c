@@ -0,0 +1,242 @@
+#define _XOPEN_SOURCE 700
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+/*
+ * ctype.h	- isalpha()
+ * stdbool.h	- bool, true, false
+ * stdio.h	- fopen(), fread(), fwrite(), fprintf()
+ * stdlib.h	- strtol()
+ * string.h	- memset(), str*()
+ * strings.h	- strncasecmp()
+ */
+
+#include "include/glyphs.h"
+
+#define HAS(set, c)	((set)[(c) >> 3] &   (1 << ((c) & 7)))
+#define ADD(set, c)	((set)[(c) >> 3] |=  (1 << ((c) & 7)))
+
+/* The named references in htmlize()'s output (see charref.c and escape.c) */
+static const struct {
+	const char	*name;
+	unsigned	 codepoint;
+} named_references[] = {
+	{ "&amp;",  '&'    }, { "&lt;",   '<'    }, { "&gt;", '>' }, { "&quot;", '"' },
+	{ "&nbsp;", 0x00A0 },
+	{ "&reg;",  0x00AE }, { "&REG;",  0x00AE },
+	{ "&copy;", 0x00A9 }, { "&COPY;", 0x00A9 },
+	{ "&mdash", 0x2014 }, { "&ndash", 0x2013 },
+};
+
+
+void
+glyphs_init(struct glyphs *glyphs)
+/*
+ * Printable ASCII is always in both sets, since the pages around the posts
+ * (index, dates, footer) and the markup itself use it anyway
+ */
+{
+	memset(glyphs, 0, sizeof(*glyphs));
+	for (unsigned c = 0x20; c < 0x7F; c++)
+	{
+		ADD(glyphs->prose, c);
+		ADD(glyphs->code, c);
+	}
+}
+
+int
+glyphs_load(struct glyphs *glyphs, const char *path)
+{
+	FILE *fp;
+	int retval = 1;
+
+	glyphs_init(glyphs);
+	if ((fp = fopen(path, "r")) == NULL)
+		return 1;
+	if (fread(glyphs->prose, GLYPHS_SET_SIZE, 1, fp) == 1
+			&& fread(glyphs->code, GLYPHS_SET_SIZE, 1, fp) == 1)
+		retval = 0;
+	else
+		glyphs_init(glyphs);
+	fclose(fp);
+	return retval;
+}
+
+int
+glyphs_save(const struct glyphs *glyphs, const char *path)
+{
+	FILE *fp;
+	int retval;
+
+	if ((fp = fopen(path, "w")) == NULL)
+		return 1;
+	retval = fwrite(glyphs->prose, GLYPHS_SET_SIZE, 1, fp) != 1
+		|| fwrite(glyphs->code, GLYPHS_SET_SIZE, 1, fp) != 1;
+	return fclose(fp) || retval;
+}
+
+static unsigned
+next_codepoint(const char **text)
+/*
+ * Decodes one UTF-8 sequence. Anything malformed comes out as U+FFFD.
+ */
+{
+	const unsigned char *s = (const unsigned char *)*text;
+	unsigned c = *s++, n = 0;
+
+	if (c >= 0xF8)                  { c = 0xFFFD; }
+	else if (c >= 0xF0)             { c &= 0x07; n = 3; }
+	else if (c >= 0xE0)             { c &= 0x0F; n = 2; }
+	else if (c >= 0xC0)             { c &= 0x1F; n = 1; }
+	else if (c >= 0x80)             { c = 0xFFFD; }	// A stray continuation byte
+
+	for (; n > 0; n--, s++)
+	{
+		if ((*s & 0xC0) != 0x80)
+		{
+			c = 0xFFFD;
+			break;
+		}
+		c = c << 6 | (*s & 0x3F);
+	}
+	*text = (const char *)s;
+	return c < GLYPHS_MAX ? c : 0xFFFD;
+}
+
+static bool
+charref(const char **text, unsigned *c)
+/*
+ * Decodes a character reference, the way the browser would see it
+ */
+{
+	const char *s = *text;
+	char *end;
+
+	if (s[1] == '#')
+	{
+		bool hex = s[2] == 'x' || s[2] == 'X';
+		long n = strtol(s + (hex ? 3 : 2), &end, hex ? 16 : 10);
+		if (*end != ';' || end == s + (hex ? 3 : 2) || n <= 0 || n > 0x10FFFF)
+			return false;
+		*c = n;
+		*text = end + 1;
+		return true;
+	}
+	for (size_t i = 0; i < sizeof(named_references) / sizeof(*named_references); i++)
+	{
+		size_t len = strlen(named_references[i].name);
+		if (!strncmp(s, named_references[i].name, len))
+		{
+			*c = named_references[i].codepoint;
+			*text = s + len + (s[len] == ';');
+			return true;
+		}
+	}
+	return false;
+}
+
+static const char *
+skip_tag(const char *html, const char **name, size_t *name_len, bool *closing)
+/*
+ * Skips the tag at html, which starts with '<', and returns where it ends
+ */
+{
+	char quote = '\0';
+
+	*closing  = html[1] == '/';
+	*name     = html + 1 + *closing;
+	*name_len = strspn(*name, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789");
+	for (html = *name + *name_len; *html != '\0' && (quote || *html != '>'); html++)
+		if (quote ? *html == quote : (*html == '"' || *html == '\''))
+			quote = quote ? '\0' : *html;
+	return *html == '>' ? html + 1 : html;
+}
+
+static bool
+is_tag(const char *name, size_t name_len, const char *tag)
+{
+	return name_len == strlen(tag) && !strncasecmp(name, tag, name_len);
+}
+
+size_t
+glyphs_scan(struct glyphs *glyphs, const char *html)
+/*
+ * Adds the text of a rendered page to the sets. Text in a <pre> or <code>
+ * goes into the code set, everything else into the prose set. Only what
+ * is set in the page's fonts counts, so tags, comments, the <head> and
+ * <script>s are skipped.
+ *
+ * Returns the number of characters that weren't in the sets before.
+ */
+{
+	const char *body = strstr(html, "<body");
+	unsigned code = 0;	// How many <pre>s and <code>s the text is in
+	size_t added = 0;
+
+	html = body != NULL ? body : html;
+	while (*html != '\0')
+	{
+		const char *name;
+		size_t name_len;
+		bool closing;
+		unsigned char *set;
+		unsigned c;
+
+		if (!strncmp(html, "<!--", 4))
+		{
+			const char *end = strstr(html + 4, "-->");
+			html = end != NULL ? end + 3 : html + strlen(html);
+			continue;
+		}
+		if (*html == '<' && (isalpha((unsigned char)html[1]) || html[1] == '/'))
+		{
+			html = skip_tag(html, &name, &name_len, &closing);
+			if (is_tag(name, name_len, "pre") || is_tag(name, name_len, "code"))
+				code = closing ? code - (code > 0) : code + 1;
+			else if (!closing && (is_tag(name, name_len, "script") || is_tag(name, name_len, "style")))
+			{
+				/* Their contents aren't text, and can't have a "</" in them */
+				const char *end = strstr(html, "</");
+				html = end != NULL ? end : html + strlen(html);
+			}
+			continue;
+		}
+		if (*html != '&' || !charref(&html, &c))
+			c = next_codepoint(&html);
+
+		set = code > 0 ? glyphs->code : glyphs->prose;
+		if (c >= 0x20 && !HAS(set, c))
+		{
+			ADD(set, c);
+			added++;
+		}
+	}
+	return added;
+}
+
+void
+glyphs_print_ranges(const unsigned char *set, FILE *out)
+/*
+ * Prints the set as a CSS unicode-range, eg. "U+20-7E,U+A9"
+ */
+{
+	bool first = true;
+
+	for (unsigned c = 0; c < GLYPHS_MAX; c++)
+	{
+		if (!HAS(set, c))
+			continue;
+		unsigned end = c;
+		while (end + 1 < GLYPHS_MAX && HAS(set, end + 1))
+			end++;
+		fprintf(out, end == c ? "%sU+%X" : "%sU+%X-%X", first ? "" : ",", c, end);
+		first = false;
+		c = end;
+	}
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,39 @@
+#include "include/hash.h"
+
+/*
+ * 64-bit FNV-1a.
+ *
+ * Not cryptographic in any way, but it is tiny, has no alignment
+ * requirements, and spreads short strings such as file names and link ids
+ * well enough for open-addressing hash tables.
+ */
+
+#define FNV_OFFSET	UINT64_C(14695981039346656037)
+#define FNV_PRIME	UINT64_C(1099511628211)
+
+uint64_t
+hash_bytes(const void *data, size_t len)
+{
+	const unsigned char *p = data;
+	uint64_t hash = FNV_OFFSET;
+	for (size_t i = 0; i < len; i++)
+	{
+		hash ^= p[i];
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+uint64_t
+hash_str(const char *s)
+{
+	uint64_t hash = FNV_OFFSET;
+	for (; *s != '\0'; s++)
+	{
+		hash ^= (unsigned char)*s;
+		hash *= FNV_PRIME;
+	}
+	return hash;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
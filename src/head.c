@@ -0,0 +1,31 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * stdio.h	- fopen(), fread(), fseek(), ftell()
+ * stdlib.h	- malloc()
+ */
+
+#include "constants.h"
+#include "include/head.h"
+
+char *
+head_load(void)
+/*
+ * Returns a malloc()ed copy of ASSETS_HEAD, or NULL if it can't be read
+ */
+{
+	FILE *fp;
+	char *buf = NULL;
+	long size;
+
+	if ((fp = fopen(ASSETS_HEAD, "r")) == NULL)
+		return NULL;
+	if (!fseek(fp, 0, SEEK_END) && (size = ftell(fp)) >= 0 && !fseek(fp, 0, SEEK_SET)
+			&& (buf = malloc(size + 1)) != NULL)
+		buf[fread(buf, 1, size, fp)] = '\0';
+	fclose(fp);
+	return buf;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
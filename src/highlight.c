@@ -0,0 +1,350 @@
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * stdbool.h	- bool, true, false
+ * stdio.h	- fputs(), fwrite()
+ * stdlib.h	- bsearch()
+ * string.h	- memcmp(), strlen()
+ */
+
+#include "include/highlight.h"
+
+/*
+ * One lexer for every language, driven by its struct syntax, and by a table
+ * of character classes. It never looks back more than one character, and
+ * every token it starts, it finishes on the same line (or leaves in
+ * struct highlight, for the next one), so a block takes time linear in its
+ * length.
+ */
+
+/**** [START] Languages ****/
+static const char *const C_KEYWORDS[] = {
+	"NULL", "_Bool", "auto", "bool", "break", "case", "char", "const",
+	"continue", "default", "do", "double", "else", "enum", "extern", "false",
+	"float", "for", "goto", "if", "inline", "int", "long", "register",
+	"restrict", "return", "short", "signed", "sizeof", "static", "struct",
+	"switch", "true", "typedef", "union", "unsigned", "void", "volatile",
+	"while",
+};
+static const char *const SH_KEYWORDS[] = {
+	"break", "case", "continue", "do", "done", "elif", "else", "esac", "exit",
+	"export", "fi", "for", "function", "if", "in", "local", "readonly",
+	"return", "select", "set", "shift", "then", "unset", "until", "while",
+};
+static const char *const PYTHON_KEYWORDS[] = {
+	"False", "None", "True", "and", "as", "assert", "async", "await", "break",
+	"class", "continue", "def", "del", "elif", "else", "except", "finally",
+	"for", "from", "global", "if", "import", "in", "is", "lambda", "nonlocal",
+	"not", "or", "pass", "raise", "return", "try", "while", "with", "yield",
+};
+
+#define KEYWORDS(list)	list, sizeof(list) / sizeof(*list)
+
+struct syntax {
+	const char		*name;		/* As in class="lang-..." */
+	const char		*aliases;	/* Fence names, each followed by ' ' */
+	const char *const	*keywords;	/* Sorted, for bsearch() */
+	size_t			 nkeywords;
+	const char		*quotes;	/* That start a string */
+	char			 comment;	/* Starts a line comment */
+	bool			 comment_word;	/* ... only at the start of a word */
+	bool			 slashes;	/* C's line and block comments */
+	bool			 preprocessor;	/* # at the start of a line */
+	bool			 decorators;	/* @ at the start of a line */
+	bool			 triple_quotes;	/* """strings""" that span lines */
+	bool			 variables;	/* $name, ${name}, $1 */
+	bool			 diff;		/* Line-wise: + - @@ */
+};
+
+static const struct syntax SYNTAXES[] = {
+	{ "c",      "c h ",                 KEYWORDS(C_KEYWORDS),      "\"'",  '\0', false, true,  true,  false, false, false, false },
+	{ "sh",     "sh bash shell zsh ",   KEYWORDS(SH_KEYWORDS),     "\"'`", '#',  true,  false, false, false, false, true,  false },
+	{ "python", "python py python3 ",   KEYWORDS(PYTHON_KEYWORDS), "\"'",  '#',  false, false, false, true,  true,  false, false },
+	{ "diff",   "diff patch ",          NULL, 0,                   "",     '\0', false, false, false, false, false, false, true  },
+};
+
+enum { NORMAL, BLOCK_COMMENT, TRIPLE_QUOTE };
+
+/* Character classes */
+#define IDENT_START	1
+#define IDENT		2
+#define DIGIT		4
+
+static unsigned char CLASS[256];
+
+static void
+classes(void)
+{
+	for (int c = 'a'; c <= 'z'; c++)
+		CLASS[c] = CLASS[c - 'a' + 'A'] = IDENT_START | IDENT;
+	for (int c = '0'; c <= '9'; c++)
+		CLASS[c] = IDENT | DIGIT;
+	CLASS['_'] = IDENT_START | IDENT;
+}
+/**** [END] Languages ****/
+
+
+/**** [START] Output ****/
+static void
+put_escaped(const char *s, const char *end, FILE *out)
+/*
+ * Like fputs_escaped(), but for [s, end), and a run at a time
+ */
+{
+	const char *run = s;
+
+	for (; s < end; s++)
+	{
+		const char *entity;
+		switch (*s)
+		{
+			case '<': entity = "&lt;";  break;
+			case '>': entity = "&gt;";  break;
+			case '&': entity = "&amp;"; break;
+			default:  continue;
+		}
+		fwrite(run, 1, s - run, out);
+		fputs(entity, out);
+		run = s + 1;
+	}
+	fwrite(run, 1, s - run, out);
+}
+
+static void
+put_span(char class, const char *s, const char *end, FILE *out)
+{
+	char open[] = "<span class=\"X\">";
+	open[13] = class;
+	fputs(open, out);
+	put_escaped(s, end, out);
+	fputs("</span>", out);
+}
+/**** [END] Output ****/
+
+
+/**** [START] Lexing ****/
+struct word {
+	const char	*s;
+	size_t		 len;
+};
+
+static int
+compare_word(const void *key, const void *elem)
+{
+	const struct word *w = key;
+	const char *keyword = *(const char *const *)elem;
+	size_t len = strlen(keyword);
+	int cmp = memcmp(w->s, keyword, w->len < len ? w->len : len);
+	return cmp != 0 ? cmp : (w->len > len) - (w->len < len);
+}
+
+static const char *
+find(const char *s, const char *end, const char *needle, size_t len)
+/*
+ * Where needle starts in [s, end), or NULL
+ */
+{
+	for (; s + len <= end; s++)
+		if (*s == *needle && !memcmp(s, needle, len))
+			return s;
+	return NULL;
+}
+
+static const char *
+string_end(struct highlight *h, const char *s, const char *end, char quote)
+/*
+ * Where the string that goes on at s ends (past its closing quote), or end
+ * if it doesn't end on this line
+ */
+{
+	if (h->state == TRIPLE_QUOTE)
+	{
+		char triple[3] = { quote, quote, quote };
+		const char *close = find(s, end, triple, 3);
+		if (close == NULL)
+			return end;
+		h->state = NORMAL;
+		return close + 3;
+	}
+	for (; s < end; s++)
+		if (*s == '\\' && s + 1 < end)
+			s++;
+		else if (*s == quote)
+			return s + 1;
+	return end;
+}
+
+static void
+lex(struct highlight *h, const char *line, const char *end, FILE *out)
+{
+	const struct syntax *syn = h->syntax;
+	const char *s = line, *run = line, *t;
+
+	/* Whatever the last line left open */
+	if (h->state == BLOCK_COMMENT)
+	{
+		if ((t = find(s, end, "*/", 2)) != NULL)
+		{
+			h->state = NORMAL;
+			t += 2;
+		}
+		put_span('c', s, t ? t : end, out);
+		run = s = t ? t : end;
+	}
+	else if (h->state == TRIPLE_QUOTE)
+	{
+		t = string_end(h, s, end, h->quote);
+		put_span('s', s, t, out);
+		run = s = t;
+	}
+
+	/* Things that only count at the start of a line */
+	for (t = s; t < end && (*t == ' ' || *t == '\t'); t++)
+		;
+	if (t < end && ((syn->preprocessor && *t == '#') || (syn->decorators && *t == '@')))
+	{
+		put_escaped(s, t, out);
+		put_span('p', t, end, out);
+		return;
+	}
+
+	while (s < end)
+	{
+		unsigned char c = *s;
+		char class = 0;
+
+		if (CLASS[c] & IDENT_START)
+		{
+			struct word w = { s, 0 };
+			for (t = s; t < end && (CLASS[(unsigned char)*t] & IDENT); t++)
+				;
+			w.len = t - s;
+			if (syn->nkeywords && bsearch(&w, syn->keywords, syn->nkeywords, sizeof(*syn->keywords), compare_word))
+				class = 'k';
+		}
+		else if ((CLASS[c] & DIGIT) || (c == '.' && s + 1 < end && (CLASS[(unsigned char)s[1]] & DIGIT)))
+		{
+			for (t = s + 1; t < end && ((CLASS[(unsigned char)*t] & IDENT) || *t == '.'); t++)
+				;
+			class = 'n';
+		}
+		else if (c != '\0' && strchr(syn->quotes, c) != NULL)
+		{
+			if (syn->triple_quotes && s + 2 < end && s[1] == c && s[2] == c)
+			{
+				h->state = TRIPLE_QUOTE;
+				h->quote = c;
+				t = string_end(h, s + 3, end, c);
+			}
+			else
+				t = string_end(h, s + 1, end, c);
+			class = 's';
+		}
+		else if (c == syn->comment && c != '\0'
+				&& (!syn->comment_word || s == line || s[-1] == ' ' || s[-1] == '\t'))
+		{
+			t = end;
+			class = 'c';
+		}
+		else if (syn->slashes && c == '/' && s + 1 < end && (s[1] == '/' || s[1] == '*'))
+		{
+			t = end;
+			if (s[1] == '*' && (t = find(s + 2, end, "*/", 2)) != NULL)
+				t += 2;
+			else if (s[1] == '*')
+			{
+				h->state = BLOCK_COMMENT;
+				t = end;
+			}
+			class = 'c';
+		}
+		else if (syn->variables && c == '$' && s + 1 < end)
+		{
+			t = s + 1;
+			if (*t == '{')
+			{
+				const char *close = memchr(t, '}', end - t);
+				t = close ? close + 1 : end;
+			}
+			else if (CLASS[(unsigned char)*t] & IDENT_START)
+				while (t < end && (CLASS[(unsigned char)*t] & IDENT))
+					t++;
+			else if (*t != '(')
+				t++;	// $1, $?, $@, ...
+			class = t > s + 1 ? 'v' : 0;
+		}
+		else
+			t = s + 1;
+
+		if (class != 0)
+		{
+			put_escaped(run, s, out);
+			put_span(class, s, t, out);
+			run = t;
+		}
+		s = t;
+	}
+	put_escaped(run, end, out);
+}
+
+static void
+lex_diff(const char *line, const char *end, FILE *out)
+{
+	char class = 0;
+
+	if (end - line >= 3 && (!memcmp(line, "+++", 3) || !memcmp(line, "---", 3)))
+		class = 'h';
+	else if (end - line >= 2 && !memcmp(line, "@@", 2))
+		class = 'h';
+	else if (line < end && *line == '+')
+		class = 'a';
+	else if (line < end && *line == '-')
+		class = 'd';
+
+	if (class != 0)
+		put_span(class, line, end, out);
+	else
+		put_escaped(line, end, out);
+}
+/**** [END] Lexing ****/
+
+
+const char *
+highlight_start(struct highlight *h, const char *name, size_t len)
+/*
+ * Starts a code block of the language that its fence names (eg. "c" for
+ * ```c). Returns the language's own name, or NULL if we don't know it, in
+ * which case highlight_line() only escapes.
+ */
+{
+	if (CLASS['a'] == 0)
+		classes();
+
+	h->syntax = NULL;
+	h->state  = NORMAL;
+	h->quote  = '\0';
+	for (size_t i = 0; len > 0 && i < sizeof(SYNTAXES) / sizeof(*SYNTAXES); i++)
+		for (const char *alias = SYNTAXES[i].aliases; *alias != '\0'; alias += strcspn(alias, " ") + 1)
+			if (strcspn(alias, " ") == len && !memcmp(alias, name, len))
+				return (h->syntax = &SYNTAXES[i])->name;
+	return NULL;
+}
+
+void
+highlight_line(struct highlight *h, const char *line, FILE *out)
+{
+	const char *end = line + strcspn(line, "\n");
+
+	if (h->syntax == NULL)
+		put_escaped(line, end, out);
+	else if (h->syntax->diff)
+		lex_diff(line, end, out);
+	else
+		lex(h, line, end, out);
+	fputs(end, out);	// The '\n', if any
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
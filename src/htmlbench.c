@@ -0,0 +1,444 @@
+#define _XOPEN_SOURCE 700
+#define _DEFAULT_SOURCE		// syscall()
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif /* __linux__ */
+
+/*
+ * stdbool.h		- bool, true, false
+ * stdint.h		- uint64_t
+ * stdio.h		- open_memstream(), fmemopen(), printf()
+ * stdlib.h		- free(), strtod()
+ * string.h		- strcmp(), strlen()
+ * time.h		- clock_gettime()
+ * unistd.h		- getopt()
+ * linux/perf_event.h	- perf_event_open(), for the hardware counters
+ * sys/ioctl.h		- ioctl(), to start and stop the counters
+ * sys/syscall.h	- SYS_perf_event_open
+ */
+
+#include "include/arena.h"
+#include "include/corpus.h"
+#include "include/htmlize.h"
+
+/*
+ * Microbenchmarks for htmlize(), one input per construct, so that a change
+ * in speed can be pinned on the handler that caused it -
+ *
+ *	htmlbench [-t seconds] > after.json
+ *	htmlbench -c before.json after.json
+ *
+ * For each case, it reports the best time of several runs in ns per byte
+ * of input, and, where perf_event_open() is allowed, CPU cycles and
+ * instructions per byte and branch misses per KiB (null otherwise).
+ *
+ * With -c, it compares the reports of two builds side by side.
+ */
+
+#define CASE_SIZE	(1024 * 1024)	/* Bytes of input per case */
+#define MIN_RUNS	5
+
+struct counters {
+	double		 ns;
+	long long	 cycles;		/* -1 if unknown */
+	long long	 instructions;
+	long long	 branch_misses;
+};
+
+
+/**** [START] Inputs ****/
+static const char *const WORDS[] = {
+	"the", "of", "and", "to", "in", "is", "that", "for", "with", "file",
+	"shell", "kernel", "process", "memory", "buffer", "pointer", "string",
+	"compiler", "signal", "terminal", "simple", "portable", "write", "read",
+};
+
+#define WORD(rng)	(WORDS[corpus_next(rng) % (sizeof(WORDS) / sizeof(*WORDS))])
+
+static void
+prose(struct corpus_rng *rng, FILE *out)
+{
+	for (unsigned i = 0; i < 12; i++)
+		fprintf(out, "%s %s %s %s %s %s %s %s %s %s.\n", WORD(rng), WORD(rng),
+				WORD(rng), WORD(rng), WORD(rng), WORD(rng), WORD(rng),
+				WORD(rng), WORD(rng), WORD(rng));
+	fputc('\n', out);
+}
+
+static void
+code_block(struct corpus_rng *rng, FILE *out, const char *fence)
+{
+	fprintf(out, "%s\n", fence);
+	for (unsigned i = 0; i < 200; i++)
+		fprintf(out, "\tif (%s->%s < %u && *%s != '<')\t// %s & %s\n",
+				WORD(rng), WORD(rng), i, WORD(rng), WORD(rng), WORD(rng));
+	fputs("```\n\n", out);
+}
+
+static void
+code(struct corpus_rng *rng, FILE *out)
+{
+	code_block(rng, out, "```");
+}
+
+static void
+highlight(struct corpus_rng *rng, FILE *out)
+/*
+ * The same code, through the C lexer (see highlight.c)
+ */
+{
+	code_block(rng, out, "```c");
+}
+
+static void
+emphasis(struct corpus_rng *rng, FILE *out)
+{
+	for (unsigned i = 0; i < 12; i++)
+		fprintf(out, "*%s* _%s_ `%s` *%s _%s_* &amp; `%s` _%s_ &copy; *%s*\n",
+				WORD(rng), WORD(rng), WORD(rng), WORD(rng), WORD(rng),
+				WORD(rng), WORD(rng), WORD(rng));
+	fputc('\n', out);
+}
+
+static void
+links(struct corpus_rng *rng, FILE *out)
+/*
+ * The definitions are as far from the links as htmlize() can see
+ */
+{
+	unsigned lines = READAHEAD_LINES - 6;
+	for (unsigned i = 0; i < lines; i++)
+		fprintf(out, "%s !(link%u)[%s %s] %s\n", WORD(rng), i, WORD(rng), WORD(rng), WORD(rng));
+	for (unsigned i = 0; i < lines; i++)
+		fprintf(out, "\t[link%u]: https://example.com/%s/%s-%u.html\n", i, WORD(rng), WORD(rng), i);
+	fputc('\n', out);
+}
+
+static void
+table(struct corpus_rng *rng, FILE *out)
+{
+	fputs("<table>\n", out);
+	for (unsigned i = 0; i < 20; i++)
+	{
+		for (unsigned j = 0; j < 16; j++)
+			fprintf(out, "%s%s", j ? " | " : "", WORD(rng));
+		fputc('\n', out);
+	}
+	fputs("</table>\n\n", out);
+}
+
+static void
+csv(struct corpus_rng *rng, FILE *out)
+{
+	fputs("<table csv>\n", out);
+	for (unsigned i = 0; i < 20; i++)
+	{
+		for (unsigned j = 0; j < 16; j++)
+		{
+			const char *sep = j ? "," : "";
+			if (j == 7)	// Quoted
+				fprintf(out, "%s\"%s, %s\"", sep, WORD(rng), WORD(rng));
+			else if (j == 11)	// Markup, which takes the slow path
+				fprintf(out, "%s*%s*", sep, WORD(rng));
+			else
+				fprintf(out, "%s%s", sep, WORD(rng));
+		}
+		fputc('\n', out);
+	}
+	fputs("</table>\n\n", out);
+}
+
+static void
+list(struct corpus_rng *rng, FILE *out)
+{
+	fputs("<ul>\n", out);
+	for (unsigned i = 0; i < 64; i++)
+		fprintf(out, "%*s- %s %s %s\n", (int)(i % 16) * 2, "", WORD(rng), WORD(rng), WORD(rng));
+	fputs("</ul>\n\n", out);
+}
+
+static const struct {
+	const char	*name;
+	void		(*write)(struct corpus_rng *, FILE *);
+} CASES[] = {
+	{ "prose",     prose     },
+	{ "code",      code      },
+	{ "highlight", highlight },
+	{ "emphasis",  emphasis  },
+	{ "links",     links     },
+	{ "table",     table     },
+	{ "csv",       csv       },
+	{ "list",      list      },
+};
+
+static char *
+make_input(size_t n, size_t *len)
+{
+	struct corpus_rng rng;
+	char *buf = NULL;
+	FILE *out = open_memstream(&buf, len);
+
+	corpus_seed(&rng, n + 1);
+	while (out != NULL && ftell(out) < CASE_SIZE)
+		CASES[n].write(&rng, out);
+	if (out == NULL || fclose(out))
+	{
+		free(buf);
+		return NULL;
+	}
+	return buf;
+}
+/**** [END] Inputs ****/
+
+
+/**** [START] Measuring ****/
+#ifdef __linux__
+static int
+perf_open(uint32_t type, uint64_t config, int group)
+{
+	struct perf_event_attr attr;
+
+	memset(&attr, 0, sizeof(attr));
+	attr.size           = sizeof(attr);
+	attr.type           = type;
+	attr.config         = config;
+	attr.disabled       = group == -1;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv     = 1;
+	attr.read_format    = PERF_FORMAT_GROUP;
+	return syscall(SYS_perf_event_open, &attr, 0, -1, group, 0);
+}
+#endif /* __linux__ */
+
+static int PERF = -1;	// Group of cycles, instructions and branch misses
+
+static void
+perf_init(void)
+{
+#ifdef __linux__
+	if ((PERF = perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, -1)) == -1)
+		return;
+	if (perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS, PERF) == -1
+			|| perf_open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES, PERF) == -1)
+	{
+		close(PERF);
+		PERF = -1;
+	}
+#endif /* __linux__ */
+}
+
+static void
+run(const char *input, size_t len, FILE *sink, struct arena *arena, struct counters *c)
+{
+	struct timespec start, end;
+	struct doc doc = { .arena = arena };
+	FILE *src = fmemopen((void *)input, len, "r");
+
+#ifdef __linux__
+	if (PERF != -1)
+	{
+		ioctl(PERF, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+		ioctl(PERF, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+	}
+#endif /* __linux__ */
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	htmlize(src, sink, &doc);
+	fflush(sink);
+	clock_gettime(CLOCK_MONOTONIC, &end);
+
+	c->ns = (end.tv_sec - start.tv_sec) * 1e9 + (end.tv_nsec - start.tv_nsec);
+	c->cycles = c->instructions = c->branch_misses = -1;
+#ifdef __linux__
+	uint64_t values[4];	// Number of counters, then the counters
+	if (PERF != -1)
+	{
+		ioctl(PERF, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+		if (read(PERF, values, sizeof(values)) == sizeof(values))
+		{
+			c->cycles        = values[1];
+			c->instructions  = values[2];
+			c->branch_misses = values[3];
+		}
+	}
+#endif /* __linux__ */
+
+	fclose(src);
+	arena_reset(arena);
+}
+
+static void
+print_per(const char *name, long long n, double per, const char *sep)
+{
+	if (n < 0)
+		printf("\"%s\": null%s", name, sep);
+	else
+		printf("\"%s\": %.4f%s", name, n / per, sep);
+}
+
+static int
+bench(double seconds)
+{
+	struct arena arena;
+	FILE *sink;
+
+	if ((sink = fopen("/dev/null", "w")) == NULL)
+		return 1;
+	arena_init(&arena);
+	perf_init();
+
+	printf("{\n\t\"cases\": [\n");
+	for (size_t n = 0; n < sizeof(CASES) / sizeof(*CASES); n++)
+	{
+		struct counters best = { 0 }, c;
+		struct timespec start, now;
+		size_t len;
+		char *input;
+
+		if ((input = make_input(n, &len)) == NULL)
+			return 1;
+
+		/* Keep the best run, as the one least disturbed by anything else */
+		clock_gettime(CLOCK_MONOTONIC, &start);
+		for (unsigned runs = 0;; runs++)
+		{
+			run(input, len, sink, &arena, &c);
+			if (runs == 0 || c.ns < best.ns)
+				best = c;
+			clock_gettime(CLOCK_MONOTONIC, &now);
+			if (runs + 1 >= MIN_RUNS && (now.tv_sec - start.tv_sec) + (now.tv_nsec - start.tv_nsec) / 1e9 >= seconds)
+				break;
+		}
+
+		printf("\t\t{ \"case\": \"%s\", \"bytes\": %zu, \"ns_per_byte\": %.4f, ",
+				CASES[n].name, len, best.ns / len);
+		print_per("cycles_per_byte", best.cycles, len, ", ");
+		print_per("instructions_per_byte", best.instructions, len, ", ");
+		print_per("branch_misses_per_kib", best.branch_misses, len / 1024.0, " }");
+		printf("%s\n", n + 1 < sizeof(CASES) / sizeof(*CASES) ? "," : "");
+		free(input);
+	}
+	printf("\t]\n}\n");
+
+	if (PERF == -1)
+		fputs("htmlbench: no hardware counters (perf_event_open() not allowed?)\n", stderr);
+	arena_free(&arena);
+	return fclose(sink) != 0;
+}
+/**** [END] Measuring ****/
+
+
+/**** [START] Comparing ****/
+struct report {
+	char		 name[32];
+	double		 values[4];	/* Negative if unknown */
+};
+
+static const char *const METRICS[] = {
+	"ns_per_byte", "cycles_per_byte", "instructions_per_byte", "branch_misses_per_kib",
+};
+
+static size_t
+load(const char *path, struct report *reports, size_t max)
+/*
+ * Reads back what bench() printed, one case per line
+ */
+{
+	char line[512];
+	size_t count = 0;
+	FILE *fp;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return 0;
+	while (count < max && fgets(line, sizeof(line), fp) != NULL)
+	{
+		struct report *r = &reports[count];
+		if (sscanf(line, " { \"case\": \"%31[^\"]\"", r->name) != 1)
+			continue;
+		for (size_t i = 0; i < 4; i++)
+		{
+			char key[48], *p;
+			snprintf(key, sizeof(key), "\"%s\": ", METRICS[i]);
+			p = strstr(line, key);
+			r->values[i] = p == NULL || !strncmp(p + strlen(key), "null", 4)
+				? -1 : strtod(p + strlen(key), NULL);
+		}
+		count++;
+	}
+	fclose(fp);
+	return count;
+}
+
+static int
+compare(const char *before_path, const char *after_path)
+{
+	struct report before[32], after[32];
+	size_t nbefore = load(before_path, before, 32);
+	size_t nafter  = load(after_path, after, 32);
+
+	if (nbefore == 0 || nafter == 0)
+	{
+		fprintf(stderr, "htmlbench: cannot read %s\n", nbefore == 0 ? before_path : after_path);
+		return 1;
+	}
+
+	printf("%-10s %-22s %12s %12s %8s\n", "case", "metric", "before", "after", "change");
+	for (size_t i = 0; i < nafter; i++)
+	{
+		size_t j = 0;
+		while (j < nbefore && strcmp(before[j].name, after[i].name))
+			j++;
+		if (j == nbefore)
+			continue;
+		for (size_t m = 0; m < 4; m++)
+		{
+			double b = before[j].values[m], a = after[i].values[m];
+			if (b < 0 || a < 0)
+				continue;
+			printf("%-10s %-22s %12.4f %12.4f %+7.1f%%\n", after[i].name, METRICS[m],
+					b, a, b > 0 ? (a - b) / b * 100 : 0);
+		}
+	}
+	return 0;
+}
+/**** [END] Comparing ****/
+
+
+int
+main(int argc, char **argv)
+{
+	double seconds = 0.5;
+	bool comparing = false;
+
+	for (int opt; (opt = getopt(argc, argv, "ct:")) != -1;)
+		switch (opt)
+		{
+			case 'c':
+				comparing = true;
+				break;
+			case 't':
+				seconds = strtod(optarg, NULL);
+				break;
+			default:
+				goto usage;
+		}
+
+	if (comparing && argc - optind == 2)
+		return compare(argv[optind], argv[optind + 1]);
+	if (!comparing && argc == optind)
+		return bench(seconds);
+
+usage:
+	fprintf(stderr, "usage: %s [-t seconds]\n       %s -c before.json after.json\n", *argv, *argv);
+	return 1;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
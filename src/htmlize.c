@@ -1,22 +1,38 @@
 #include <ctype.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 
 /*
  * ctype.h	- isalnum(), isalpha(), etc.
  * stbool.h	- bool, true, false
  * stdio.h	- printf(), fopen(), fprintf(), etc
+ * stdlib.h	- strtol()
  * string.h	- str*(), mem*()
+ * sys/stat.h	- stat()
  */
 
 #include "constants.h"
+#include "include/arena.h"
 #include "include/charref.h"
+#include "include/csv.h"
 #include "include/debug.h"
 #include "include/escape.h"
+#include "include/highlight.h"
 #include "include/htmlize.h"
+#include "include/images.h"
+#include "include/imgsize.h"
+#include "include/linkdefs.h"
+#include "include/links.h"
+#include "include/probes.h"
+#include "include/search.h"
+#include "include/stats.h"
 #include "include/stoi.h"
+#include "include/transclude.h"
 #include "include/urlencode.h"
+#include "include/weight.h"
 
 
 /*
@@ -32,11 +48,27 @@
 #define REMAINING_CHARS \
 	((int)((MAX_LINE_LENGTH - 1) - (ptr->line - ptr->readahead[0]) - 1))
 
+/*
+ * Tries one of the line-wise or character-wise functions on ptr, counting
+ * the calls and the hits (see stats.h). True if the function did its job.
+ */
+#define TRY(function) \
+	(STAT_CALL(function), !function(ptr) && STAT_HIT(function))
+
+/*
+ * TRY() for the line-wise functions, which also fires the block probe (see
+ * probes.h) when one of them takes a block
+ */
+#define TRY_BLOCK(function) \
+	(block = ptr->offset, TRY(function) && probe_block(ptr, #function, block))
+
 
 static void shift_lines         (struct data *);
 static void get_next_line       (struct data *);
 static int  print_linkdef       (struct data *);
 static int  LINKDEF             (struct data *);
+static int  INCLUDE             (struct data *);
+static int  CSV_TABLE           (struct data *);
 static int  TABLE               (struct data *);
 static int  LISTS               (struct data *);
 static int  CODEBLOCK           (struct data *);
@@ -52,6 +84,11 @@ static int  ITALIC              (struct data *);
 static int  FOOTNOTE            (struct data *);
 static int  LINKS               (struct data *);
 static void parse_line          (struct data *);
+static bool local_path          (const struct data *, const char *, size_t, char *, size_t);
+static const char *next_attribute(const char *, const char **, size_t *, const char **, size_t *);
+static void tag_links           (struct data *, const char *);
+static void print_img_hints     (struct data *, bool, FILE *);
+static void weigh_img           (struct data *, const char *, size_t);
 
 
 /**** [START] Utility functions ****/
@@ -64,6 +101,16 @@ strnlen(const char *str, size_t maxlen)
 	return p == NULL ? maxlen : (size_t)(p - str);
 }
 
+static inline int
+casecmp(const char *a, const char *b, size_t n)
+{
+	/* strncasecmp is defined in POSIX, not in C standard */
+	for (; n > 0; a++, b++, n--)
+		if (tolower((unsigned char)*a) != tolower((unsigned char)*b))
+			return 1;
+	return 0;
+}
+
 static inline void
 toggle(bool *val)
 {
@@ -81,10 +128,11 @@ shift_lines(struct data *ptr)
 	 */
 
 	/* Shift all history lines backward */
-	for (int i = HISTORY_LINES - 1; i >= 0; i--)
+	for (int i = HISTORY_LINES - 1; i > 0; i--)
 		memcpy(ptr->history[i], ptr->history[i - 1], MAX_LINE_LENGTH);
 
 	/* Copy current line to history */
+	ptr->offset += strlen(ptr->readahead[0]);
 	memcpy(ptr->history[0], ptr->readahead[0], MAX_LINE_LENGTH);
 
 	/* Move one line ahead in the readahead buffer */
@@ -98,6 +146,7 @@ shift_lines(struct data *ptr)
 static void
 get_next_line(struct data *ptr)
 {
+	STAT_ADD(next_line, 1);
 	shift_lines(ptr);
 
 	/*
@@ -134,6 +183,8 @@ get_next_line(struct data *ptr)
 	/* Read a new line. If NULL, that means EOF, so mark buffer empty */
 	if (fgets(ptr->readahead[READAHEAD_LINES-1], MAX_LINE_LENGTH, ptr->files->src) == NULL)
 		ptr->readahead[READAHEAD_LINES-1][0] = '\0';	// Mark buffer as empty
+	STAT_ADD(lines, ptr->readahead[READAHEAD_LINES-1][0] != '\0');
+	STAT_ADD(bytes_in, strlen(ptr->readahead[READAHEAD_LINES-1]));
 
 	/* If current line marks End of blog, then mark buffer empty */
 	if (!memcmp(ptr->readahead[READAHEAD_LINES-1], "---\n", 5))
@@ -145,6 +196,10 @@ print_linkdef(struct data *ptr)
 {
 	char *id;
 	char link_id[MAX_LINE_LENGTH];
+	char url[MAX_LINE_LENGTH];
+	size_t url_len = 0;
+	const char *global;
+	bool found = false;
 	memset(link_id, '\0', MAX_LINE_LENGTH);
 	id = link_id;	// *id shall point to the start of link_id
 
@@ -158,17 +213,19 @@ print_linkdef(struct data *ptr)
 	}
 	ptr->line++;
 
+	/* The post's own definitions come first */
+	size_t id_len = strlen(link_id);
 	fputs("<a href=\"", ptr->files->dest);
 	for (int i = 1; i < READAHEAD_LINES; i++)
 	{
-		if (strnlen(ptr->readahead[i], 4) < 3)
-			continue;
-
 		char *line;
 		line = ptr->readahead[i] + 2;	// +2 for "\t["
-		if (!memcmp(line, link_id, strlen(link_id)))
+		if (!memcmp(ptr->readahead[i], "\t[", 2)
+				&& !strncmp(line, link_id, id_len)
+				&& !strncmp(line + id_len, "]:", 2))
 		{
-			line += strlen(link_id);	// skip over the link_id
+			found = true;
+			line += id_len;	// skip over the link_id
 			line += 2;	// +2 for "]:"
 
 			/* Trim any whitespaces (padding) */
@@ -188,11 +245,23 @@ print_linkdef(struct data *ptr)
 				if (i == READAHEAD_LINES)
 					break;
 				fputc(line[0], ptr->files->dest);
+				if (url_len < sizeof(url))
+					url[url_len++] = line[0];
 				line++;
 			}
 			break;
 		}
 	}
+
+	/* Then the site-wide ones (see linkdefs.c) */
+	if (!found && (global = linkdefs_find(ptr->doc->linkdefs, link_id, id_len)) != NULL)
+	{
+		fputs(global, ptr->files->dest);
+		url_len = strnlen(global, sizeof(url));
+		memcpy(url, global, url_len);
+	}
+	if (ptr->doc->links != NULL)
+		links_href(ptr->doc->links, url, url_len);
 	fputs("\" ", ptr->files->dest);
 	while (ptr->line[0] != '[')
 	{
@@ -206,6 +275,23 @@ print_linkdef(struct data *ptr)
 	fputc('>', ptr->files->dest);
 	return 0;
 }
+
+static void
+footnote_links(struct data *ptr, const char *anchor, const char *target, const char *note)
+/*
+ * Tells the link graph about a footnote's id and the one that it links to
+ */
+{
+	char buf[MAX_LINE_LENGTH + 8];
+	int len;
+
+	if (ptr->doc->links == NULL)
+		return;
+	len = snprintf(buf, sizeof(buf), "%s%s", anchor, note);
+	links_anchor(ptr->doc->links, buf, len < (int)sizeof(buf) ? len : (int)sizeof(buf) - 1);
+	len = snprintf(buf, sizeof(buf), "%s%s", target, note);
+	links_href(ptr->doc->links, buf, len < (int)sizeof(buf) ? len : (int)sizeof(buf) - 1);
+}
 /**** [END] Utility functions ****/
 
 
@@ -230,6 +316,368 @@ LINKDEF(struct data *ptr)
 	return 0;
 }
 
+#define IS(attr) (name_len == sizeof(attr) - 1 && !casecmp(name, attr, name_len))
+
+static bool
+src_path(const struct data *ptr, const char *src, size_t len, char *path, size_t size)
+/*
+ * The file that a src attribute names, relative to the post if we know
+ * where that is (see local_path()), or else to where we are
+ */
+{
+	if (ptr->doc->base_dir != NULL)
+		return local_path(ptr, src, len, path, size);
+	return snprintf(path, size, "%.*s", (int)len, src) < (int)size;
+}
+
+/*
+ * What parse_line() would take for markup, in a cell of a CSV table. '#'
+ * isn't here, as it only matters at the start of a cell (see print_cell()).
+ */
+#define CELL_MARKUP "*_`!<&\\["
+
+static void
+print_cell(struct data *cell, const char *s, size_t len)
+/*
+ * Most cells are plain text, and are escaped a run at a time. Only those
+ * with something that could be markup go through parse_line(), in the line
+ * buffers of *cell.
+ */
+{
+	FILE *dest = cell->files->dest;
+	const size_t chunk = MAX_LINE_LENGTH - 2;	// Room for the '\n' and '\0'
+
+	if (s[strcspn(s, CELL_MARKUP)] == '\0')
+	{
+		const char *gt;
+		if (cell->doc->search != NULL)
+			search_text(cell->doc->search, s);
+		while ((gt = memchr(s, '>', len)) != NULL)
+		{
+			fwrite(s, 1, gt - s, dest);
+			fputs("&gt;", dest);
+			len -= gt + 1 - s;
+			s = gt + 1;
+		}
+		fwrite(s, 1, len, dest);
+		return;
+	}
+	if (len + 1 > chunk * (READAHEAD_LINES - 1))	// Too big for the buffers
+	{
+		if (cell->doc->search != NULL)
+			search_text(cell->doc->search, s);
+		fputs_escaped(s, dest);
+		return;
+	}
+
+	/* A cell is one line, and "#1" is a number, not a heading */
+	size_t i = 0, n = 0;
+	if (*s == '#')
+		cell->readahead[0][n++] = '\\';
+	for (const char *end = s + len; s < end; s++)
+	{
+		if (n == chunk)
+		{
+			cell->readahead[i++][n] = '\0';
+			n = 0;
+		}
+		cell->readahead[i][n++] = *s == '\n' ? ' ' : *s;
+	}
+	cell->readahead[i][n++] = '\n';
+	cell->readahead[i][n]   = '\0';
+	while (++i < READAHEAD_LINES)
+		cell->readahead[i][0] = '\0';
+
+	struct config config = { false, false, false, false };
+	cell->config = &config;
+	cell->line   = cell->readahead[0];
+	parse_line(cell);
+}
+
+static int
+CSV_TABLE(struct data *ptr)
+/*
+ * A table whose rows are CSV, either read from a file -
+ *	<table src="data.csv"></table>
+ * or inline, up to the </table> -
+ *	<table csv>
+ *	Name,"Quoted, with a "" in it"
+ *	</table>
+ * "tsv" (or a .tsv file) takes TSV instead. The rows are streamed through
+ * a CSV reader (see csv.h), so they can be as long, and as many, as they
+ * like. The other attributes stay on the <table>.
+ */
+{
+	if (memcmp(ptr->line, "<table", 6) || !isspace((unsigned char)ptr->line[6]))
+		return 1;
+
+	char *close = strchr(ptr->line, '>');
+	const char *src = NULL, *name, *value;
+	size_t src_len = 0, name_len, value_len;
+	char sep = '\0';
+	if (close == NULL)
+		return 1;
+
+	*close = '\0';	// For next_attribute()
+	for (const char *p = ptr->line + 6; *p != '\0';)
+	{
+		p = next_attribute(p, &name, &name_len, &value, &value_len);
+		if (IS("src"))
+		{
+			src     = value;
+			src_len = value_len;
+		}
+		else if (IS("csv"))
+			sep = ',';
+		else if (IS("tsv"))
+			sep = '\t';
+	}
+	if (src == NULL && sep == '\0')
+	{
+		*close = '>';
+		return 1;
+	}
+	if (sep == '\0')
+		sep = src_len > 4 && !casecmp(src + src_len - 4, ".tsv", 4) ? '\t' : ',';
+
+	FILE *dest = ptr->files->dest;
+	fputs("<table", dest);
+	for (const char *p = ptr->line + 6, *start; *p != '\0';)
+	{
+		start = p;
+		p = next_attribute(p, &name, &name_len, &value, &value_len);
+		if (!IS("src") && !IS("csv") && !IS("tsv"))
+			fwrite(start, 1, p - start, dest);
+	}
+	fputs(">\n", dest);
+	*close = '>';
+
+	struct csv csv;
+	FILE *fp = NULL;
+	char *mem = NULL;
+	bool readable = true;
+	if (src != NULL)
+	{
+		char path[FILENAME_MAX];
+		bool found = src_path(ptr, src, src_len, path, sizeof(path));
+		if (found)
+			deps_add(ptr->doc, path);	// Even if it isn't there (yet)
+		if (!found || (fp = fopen(path, "r")) == NULL)
+		{
+			fprintf(stderr, "htmlize(): cannot read table: %.*s\n", (int)src_len, src);
+			readable = false;
+		}
+		else
+			csv_open(&csv, fp, sep);
+
+		/* Whatever is left of the table is ignored */
+		if (strstr(close, "</table") == NULL)
+			while (ptr->line[0] != '\0' && memcmp(ptr->line, "</table", 7))
+				get_next_line(ptr);
+	}
+	else
+	{
+		size_t len = 0, size = 0;
+		for (get_next_line(ptr); ptr->line[0] != '\0' && memcmp(ptr->line, "</table", 7); get_next_line(ptr))
+		{
+			size_t n = strlen(ptr->line);
+			if (len + n + 1 > size)
+			{
+				size = size ? 2 * size : 4096;
+				while (size < len + n + 1)
+					size *= 2;
+				char *grown = realloc(mem, size);
+				if (grown == NULL)
+				{
+					readable = false;
+					break;
+				}
+				mem = grown;
+			}
+			memcpy(mem + len, ptr->line, n + 1);
+			len += n;
+		}
+		if (readable)
+			csv_open_mem(&csv, mem, len, sep);
+	}
+
+	if (readable)
+	{
+		/* Cells with markup get line buffers of their own */
+		struct files files = { NULL, dest };
+		struct data *cell = arena_alloc(ptr->doc->arena, sizeof(struct data));
+		cell->doc    = ptr->doc;
+		cell->files  = &files;
+		cell->offset = 0;
+		for (int i = 0; i < HISTORY_LINES; i++)
+			memset(cell->history[i], '\0', MAX_LINE_LENGTH);
+
+		int field;
+		bool row = false;
+		while ((field = csv_next(&csv)) > CSV_END)
+		{
+			fputs(row ? "</td><td>" : "<tr><td>", dest);
+			print_cell(cell, csv.field, csv.len);
+			if (!(row = field == CSV_FIELD))
+				fputs("</td></tr>\n", dest);
+		}
+		if (field == CSV_ERROR)
+			fputs("htmlize(): out of memory reading a table\n", stderr);
+		if (row)
+			fputs("</td></tr>\n", dest);
+		csv_close(&csv);
+	}
+	if (fp != NULL)
+		fclose(fp);
+	free(mem);
+
+	char *end = strstr(ptr->line, "</table");
+	fputs(end != NULL ? end : "</table>\n", dest);
+	return 0;
+}
+
+static void
+replay(struct data *ptr, const char *html, size_t len)
+/*
+ * Tells the document about the search terms and the links in a fragment
+ * that was rendered before (for another post), the way rendering it would
+ * have
+ */
+{
+	char tag[2 * MAX_LINE_LENGTH];
+	const char *end = html + len, *close;
+
+	if (ptr->doc->search == NULL && ptr->doc->links == NULL)
+		return;
+	for (const char *p = html; p < end; p++)
+		if (*p == '<' && (close = memchr(p, '>', end - p)) != NULL)
+		{
+			if ((size_t)(close - p) < sizeof(tag))
+			{
+				memcpy(tag, p + 1, close - p - 1);
+				tag[close - p - 1] = '\0';
+				tag_links(ptr, tag);
+			}
+			if (ptr->doc->search != NULL)
+				search_break(ptr->doc->search);
+			p = close;
+		}
+		else if (*p == '&' && (close = memchr(p, ';', end - p)) != NULL && close - p < 10)
+			p = close;	// A character reference stands for one character
+		else if (ptr->doc->search != NULL)
+			search_char(ptr->doc->search, *p);
+	if (ptr->doc->search != NULL)
+		search_break(ptr->doc->search);
+}
+
+static void
+print_fragment(struct data *ptr, const struct fragment *fragment)
+/*
+ * Writes out a fragment, adding what its <img>s get for being in this page
+ * (see print_img_hints()), which the fragment itself can't have
+ */
+{
+	FILE *dest = ptr->files->dest;
+	const char *html = fragment->html, *end = html + fragment->len, *close;
+	char tag[2 * MAX_LINE_LENGTH];
+
+	for (const char *p = html; fragment->markup && !ptr->doc->fragment && p + 4 < end; p++)
+	{
+		if (*p != '<' || casecmp(p + 1, "img", 3)
+				|| !(isspace((unsigned char)p[4]) || p[4] == '/' || p[4] == '>')
+				|| (close = memchr(p, '>', end - p)) == NULL || (size_t)(close - p) >= sizeof(tag))
+			continue;
+
+		bool given = false;
+		const char *name, *value, *src = NULL, *at = close;
+		size_t name_len, value_len, src_len = 0;
+		memcpy(tag, p + 1, close - p - 1);
+		tag[close - p - 1] = '\0';
+		for (const char *q = tag + 3; *q != '\0';)
+		{
+			q = next_attribute(q, &name, &name_len, &value, &value_len);
+			if (IS("loading") || IS("fetchpriority"))
+				given = true;
+			else if (IS("src"))
+			{
+				src     = value;
+				src_len = value_len;
+			}
+		}
+
+		/* The hints go before the " />" or ">" that print_img() ended it with */
+		if (at[-1] == '/')
+			at -= at[-2] == ' ' ? 2 : 1;
+		fwrite(html, 1, at - html, dest);
+		print_img_hints(ptr, given, dest);
+		if (src != NULL)
+			weigh_img(ptr, src, src_len);
+		html = at;
+		p = close;
+	}
+	fwrite(html, 1, end - html, dest);
+}
+
+static int
+INCLUDE(struct data *ptr)
+/*
+ * A line that is only -
+ *	<include src="snippet.blog">
+ *	<include src="../src/hash.c" lines="12-30">
+ * is replaced by the file, rendered (see transclude.h). lines="12" is just
+ * the one line, and lines="12-" runs to the end. Fragments go in a
+ * directory of their own (eg. raw/snippets), where blogify won't take them
+ * for posts.
+ */
+{
+	if (memcmp(ptr->line, "<include", 8) || !isspace((unsigned char)ptr->line[8]))
+		return 1;
+
+	char *close = strchr(ptr->line, '>');
+	const char *src = NULL, *lines = NULL, *name, *value;
+	size_t src_len = 0, name_len, value_len;
+	unsigned first = 0, last = 0;
+	if (close == NULL)
+		return 1;
+
+	*close = '\0';	// For next_attribute()
+	for (const char *p = ptr->line + 8; *p != '\0';)
+	{
+		p = next_attribute(p, &name, &name_len, &value, &value_len);
+		if (IS("src"))
+		{
+			src     = value;
+			src_len = value_len;
+		}
+		else if (IS("lines") && value_len > 0)
+			lines = value;
+	}
+	if (lines != NULL)
+	{
+		char *end;
+		first = strtoul(lines, &end, 10);
+		last  = *end == '-' ? strtoul(end + 1, NULL, 10) : first;
+	}
+	*close = '>';
+	if (src == NULL)
+		return 1;
+
+	char path[FILENAME_MAX];
+	const struct fragment *fragment = NULL;
+	bool cached = false;
+	if (src_path(ptr, src, src_len, path, sizeof(path)))
+		fragment = fragment_get(ptr->doc, path, first, last, &cached);
+	if (fragment == NULL)
+	{
+		fprintf(stderr, "htmlize(): cannot include %.*s\n", (int)src_len, src);
+		return 0;
+	}
+	print_fragment(ptr, fragment);
+	if (cached && fragment->markup)
+		replay(ptr, fragment->html, fragment->len);
+	return 0;
+}
+
 static int
 TABLE(struct data *ptr)	// XXX: MAX_LINE_LENGTH dependent
 {
@@ -319,7 +767,13 @@ CODEBLOCK(struct data *ptr)
 	}
 	if (!memcmp(ptr->line, "```", 3))
 	{
-		fputs("<pre>\n", ptr->files->dest);
+		/* ```lang highlights the block, if we know the language */
+		struct highlight highlight;
+		const char *lang = ptr->line + 3;
+		if ((lang = highlight_start(&highlight, lang, strcspn(lang, " \t\n"))) != NULL)
+			fprintf(ptr->files->dest, "<pre class=\"lang-%s\">\n", lang);
+		else
+			fputs("<pre>\n", ptr->files->dest);
 		get_next_line(ptr);
 		while (memcmp(ptr->line, "```", 3) && memcmp(ptr->line, "", 1))
 		{
@@ -328,7 +782,7 @@ CODEBLOCK(struct data *ptr)
 				ptr->line += 4;
 				fputs("```", ptr->files->dest);
 			}
-			fputs_escaped(ptr->line, ptr->files->dest);
+			highlight_line(&highlight, ptr->line, ptr->files->dest);
 			get_next_line(ptr);
 		}
 		fputs("</pre>\n", ptr->files->dest);
@@ -358,6 +812,7 @@ FOOTNOTES(struct data *ptr)
 						"<a class=\"footnote\" id=\"fn:%s\" href=\"#fnref:%s\">[%s]</a>",
 						ptr->line, ptr->line, ptr->line
 				       );
+				footnote_links(ptr, "fn:", "#fnref:", ptr->line);
 				*p = ':';
 				ptr->line = p;
 			}
@@ -495,6 +950,8 @@ HEADINGS(struct data *ptr)
 	fprintf(ptr->files->dest,
 			"<h%i id=\"%s\"><a class=\"self-link\" href=\"#%s\">",
 			H_LEVEL, h_id, h_id);
+	if (ptr->doc->links != NULL)
+		links_anchor(ptr->doc->links, h_id, strnlen(h_id, MAX_LINE_LENGTH));
 
 	/* Parse the remaining of the line */
 	parse_line(ptr);
@@ -545,6 +1002,215 @@ CHARREFS(struct data *ptr)	// XXX: MAX_LINE_LENGTH dependent
 	return 1;
 }
 
+static bool
+local_path(const struct data *ptr, const char *src, size_t len, char *path, size_t size)
+/*
+ * Turns a relative src into the path of the file, if it is one of ours
+ */
+{
+	if (ptr->doc->base_dir == NULL || len == 0 || src[0] == '/'
+			|| memchr(src, ':', len) != NULL
+			|| snprintf(path, size, "%s/", ptr->doc->base_dir) >= (int)size)
+		return false;
+
+	char *p = path + strlen(path);
+	for (size_t i = 0; i < len && src[i] != '?' && src[i] != '#'; i++)
+	{
+		if (p == path + size - 1)
+			return false;
+		if (src[i] == '%' && i + 2 < len && isxdigit((unsigned char)src[i+1]) && isxdigit((unsigned char)src[i+2]))
+		{
+			char hex[3] = { src[i+1], src[i+2], '\0' };
+			*p++ = (char)strtol(hex, NULL, 16);
+			i += 2;
+		}
+		else
+			*p++ = src[i];
+	}
+	*p = '\0';
+	return true;
+}
+
+static const char *
+next_attribute(const char *p, const char **name, size_t *name_len, const char **value, size_t *value_len)
+/*
+ * Reads the attribute of a tag that *p is at (or the spaces before it), and
+ * returns where the next one starts. *value_len is 0 if it has no value.
+ */
+{
+	while (isspace((unsigned char)*p) || *p == '/')
+		p++;
+	*name = p;
+	while (*p != '\0' && !isspace((unsigned char)*p) && *p != '=' && *p != '/')
+		p++;
+	*name_len = p - *name;
+
+	*value = p;
+	*value_len = 0;
+	if (*p == '=')
+	{
+		p++;
+		if (*p == '"' || *p == '\'')
+		{
+			char quote = *p++;
+			*value = p;
+			while (*p != '\0' && *p != quote)
+				p++;
+			*value_len = p - *value;
+			if (*p != '\0')
+				p++;
+		}
+		else
+		{
+			*value = p;
+			while (*p != '\0' && !isspace((unsigned char)*p))
+				p++;
+			*value_len = p - *value;
+		}
+	}
+	return p;
+}
+
+static void
+tag_links(struct data *ptr, const char *tag)
+/*
+ * Tells the link graph about the id of a tag (given without its '<' and
+ * '>'), and where it links to, if it's an <a>
+ */
+{
+	const char *p = tag, *name, *value;
+	size_t name_len, value_len;
+
+	if (ptr->doc->links == NULL || !isalpha((unsigned char)*tag))	// Closing tags, etc.
+		return;
+	while (*p != '\0' && !isspace((unsigned char)*p) && *p != '/')
+		p++;
+	bool is_a = p - tag == 1 && tolower((unsigned char)*tag) == 'a';
+
+	while (*p != '\0')
+	{
+		p = next_attribute(p, &name, &name_len, &value, &value_len);
+		if (IS("id") || (is_a && IS("name")))
+			links_anchor(ptr->doc->links, value, value_len);
+		else if (is_a && IS("href"))
+			links_href(ptr->doc->links, value, value_len);
+	}
+}
+
+static void
+print_img(struct data *ptr, char *tag)
+/*
+ * Prints an <img> tag (given without its '<' and '>'), adding the
+ * attributes it doesn't already have -
+ *	- width and height, read from the image file, so that the page doesn't
+ *	  jump around as images load
+ *	- loading="lazy", or fetchpriority="high" for the first image, which
+ *	  is likely to be the biggest thing above the fold
+ *	- decoding="async"
+ */
+{
+	bool width = false, height = false, loading = false, decoding = false, priority = false;
+	const char *src = NULL;
+	size_t src_len = 0;
+	size_t src_start = 0, src_end = 0;	// The whole src="..." attribute
+	FILE *dest = ptr->files->dest;
+
+	/* Look at the attributes we care about, after the "img" */
+	for (const char *p = tag + 3, *name, *value; *p != '\0';)
+	{
+		size_t name_len, value_len;
+		p = next_attribute(p, &name, &name_len, &value, &value_len);
+
+		if      (IS("width"))         width    = true;
+		else if (IS("height"))        height   = true;
+		else if (IS("loading"))       loading  = true;
+		else if (IS("decoding"))      decoding = true;
+		else if (IS("fetchpriority")) priority = true;
+		else if (IS("src"))
+		{
+			src       = value;
+			src_len   = value_len;
+			src_start = name - tag;
+			src_end   = p - tag;
+		}
+	}
+
+	/* Take the self-closing '/' off, to put it back after our attributes */
+	size_t len = strlen(tag);
+	while (len > 3 && isspace((unsigned char)tag[len - 1]))
+		len--;
+	bool self_closing = len > 3 && tag[len - 1] == '/';
+	if (self_closing)
+		len--;
+	while (len > 3 && isspace((unsigned char)tag[len - 1]))
+		len--;
+
+	/* Local images may be inlined or renamed (see images.c) */
+	struct imgsize_entry *image = NULL;
+	char path[FILENAME_MAX];
+	if (ptr->doc->images != NULL && local_path(ptr, src, src_len, path, sizeof(path)))
+		image = imgcache_entry(ptr->doc->images, path);
+
+	const char *url = image != NULL ? image_url(image) : NULL;
+	fputc('<', dest);
+	if (url != NULL)
+	{
+		fwrite(tag, 1, src_start, dest);
+		fprintf(dest, "src=\"%s\"", url);
+		fwrite(tag + src_end, 1, len - src_end, dest);
+	}
+	else
+		fwrite(tag, 1, len, dest);
+
+	if (!width && !height && image != NULL && image->width != 0 && image->height != 0)
+		fprintf(dest, " width=\"%u\" height=\"%u\"", image->width, image->height);
+
+	print_img_hints(ptr, loading || priority, dest);
+	if (!decoding)
+		fputs(" decoding=\"async\"", dest);
+
+	fputs(self_closing ? " />" : ">", dest);
+
+	if (url != NULL)
+		weigh_img(ptr, url, strlen(url));
+	else if (src != NULL)
+		weigh_img(ptr, src, src_len);
+}
+
+static void
+print_img_hints(struct data *ptr, bool given, FILE *dest)
+/*
+ * fetchpriority="high" for the first image of the page, and loading="lazy"
+ * for the rest, unless the <img> already says. Not in fragments, which are
+ * shared by every post that includes them (see print_fragment()).
+ */
+{
+	if (ptr->doc->fragment)
+		return;
+	bool first = ptr->doc->nimages++ == 0;
+	if (!given)
+		fputs(first ? " fetchpriority=\"high\"" : " loading=\"lazy\"", dest);
+}
+
+static void
+weigh_img(struct data *ptr, const char *url, size_t len)
+/*
+ * What fetching the image costs the page, unless it's inlined, and already
+ * in there. Fragments are weighed by each page they go in.
+ */
+{
+	struct stat st;
+	char path[2 * FILENAME_MAX];
+
+	if (ptr->doc->weight == NULL || ptr->doc->fragment || (len >= 5 && !strncmp(url, "data:", 5)))
+		return;
+	snprintf(path, sizeof(path), "%s/%.*s", DEST_DIR, (int)len, url);
+	if (memchr(url, ':', len) == NULL && !stat(path, &st))
+		ptr->doc->weight->images += st.st_size;
+	ptr->doc->weight->requests++;
+}
+#undef IS
+
 static int
 HTML_TAGS(struct data *ptr)
 {
@@ -580,7 +1246,18 @@ HTML_TAGS(struct data *ptr)
 	if (ptr->line[1] != '/' && !isalpha(ptr->line[1]))
 		return 1;
 
-	fputc('<', ptr->files->dest);
+	/*
+	 * Tags are collected whole, so that <img>s can have attributes added,
+	 * and the ids and links of the others can go into the link graph
+	 */
+	char tag[2 * MAX_LINE_LENGTH];
+	size_t len = 0;
+	bool whole = true;
+	bool is_img = tolower((unsigned char)ptr->line[1]) == 'i'
+		&& tolower((unsigned char)ptr->line[2]) == 'm'
+		&& tolower((unsigned char)ptr->line[3]) == 'g'
+		&& (isspace((unsigned char)ptr->line[4]) || ptr->line[4] == '/' || ptr->line[4] == '>');
+
 	ptr->line++;
 	while (ptr->line[0] != '>')
 	{
@@ -589,10 +1266,33 @@ HTML_TAGS(struct data *ptr)
 		if (ptr->line[0] == '\0')
 			break;
 
-		fputc(ptr->line[0], ptr->files->dest);
+		if (!whole)
+			fputc(ptr->line[0], ptr->files->dest);
+		else if (len < sizeof(tag) - 1)
+			tag[len++] = ptr->line[0];
+		else
+		{
+			/* Too long to be a sane tag. Let it through as it is. */
+			fputc('<', ptr->files->dest);
+			fwrite(tag, 1, len, ptr->files->dest);
+			fputc(ptr->line[0], ptr->files->dest);
+			whole = false;
+		}
 		ptr->line++;
 	}
-	fputc('>', ptr->files->dest);
+	tag[len] = '\0';
+	if (whole && is_img)
+		print_img(ptr, tag);
+	else
+	{
+		if (whole)
+		{
+			fputc('<', ptr->files->dest);
+			fwrite(tag, 1, len, ptr->files->dest);
+			tag_links(ptr, tag);
+		}
+		fputc('>', ptr->files->dest);
+	}
 	ptr->line++;
 	return 0;
 }
@@ -768,6 +1468,7 @@ FOOTNOTE(struct data *ptr)	// XXX: MAX_LINE_LENGTH dependent
 			"<a class=\"footnote\" id=\"fnref:%s\" href=\"#fn:%s\"><sup>[%s]</sup></a>",
 			ptr->line, ptr->line, ptr->line
 	       );
+	footnote_links(ptr, "fnref:", "#fn:", ptr->line);
 
 	ptr->line = p;
 	return 0;
@@ -879,30 +1580,50 @@ parse_line(struct data *ptr)
 
 		/* Check if the current character is worth anything to anyone */
 		if (
-				   !HEADINGS(ptr)
-				|| !CHARREFS(ptr)
-				|| !HTML_TAGS(ptr)
-				|| !CODE(ptr)
-				|| !BOLD(ptr)
-				|| !ITALIC(ptr)
-				|| !LINKS(ptr)
-				|| !FOOTNOTE(ptr)
-				|| !TABLEROW(ptr)
-				|| !DUALSPACEBREAK(ptr)
+				   TRY(HEADINGS)
+				|| TRY(CHARREFS)
+				|| TRY(HTML_TAGS)
+				|| TRY(CODE)
+				|| TRY(BOLD)
+				|| TRY(ITALIC)
+				|| TRY(LINKS)
+				|| TRY(FOOTNOTE)
+				|| TRY(TABLEROW)
+				|| TRY(DUALSPACEBREAK)
 				|| !1 // XXX: Replace the 1 with any new function
 		   )
+		{
+			/* Markup ends a word, as far as searching is concerned */
+			if (ptr->doc->search != NULL)
+				search_break(ptr->doc->search);
 			continue;
+		}
 
 		/* Nobody cared. fputc_escaped() it and move on. */
+		if (ptr->doc->search != NULL)
+			search_char(ptr->doc->search, ptr->line[0]);
 		fputc_escaped(ptr->line[0], ptr->files->dest);
 		ptr->line++;
 	}
+	if (ptr->doc->search != NULL)
+		search_break(ptr->doc->search);
 }
 /**** [END] Character-wise functions ****/
 
+static int
+probe_block(const struct data *ptr, const char *function, long start)
+/*
+ * The block runs from start to the end of the line the function stopped at
+ */
+{
+	PROBE3(block, function, start, ptr->offset + (long)strlen(ptr->readahead[0]) - start);
+	(void)ptr, (void)function, (void)start;
+	return 1;
+}
+
 
 int
-htmlize(FILE *src, FILE *dest)
+htmlize(FILE *src, FILE *dest, struct doc *doc)
 /*
  * Things that are escaped using '\\' -
  *	- \```
@@ -929,7 +1650,8 @@ htmlize(FILE *src, FILE *dest)
  *	- Lists
  *	- Linebreak if two spaces at line end
  *	- Footnotes[^10]
- *	- <table>
+ *	- <table>, and <table src="data.csv"> or <table csv> (also TSV)
+ *	- <include src="file"> (see transclude.h)
  *	- Links
  *	- <br> at Blank lines with two spaces (FIXME: Support for automatic paragraphs, without two blankspaces	XXX: Use the ptr->history and ptr->readahead for determining that.)
  */
@@ -948,17 +1670,27 @@ htmlize(FILE *src, FILE *dest)
 		return -1;
 	}
 
-	struct data data;
+	/*
+	 * The line buffers are too big to comfortably live on the stack, and
+	 * they are only needed until the document is done. So, take them from
+	 * the document's arena.
+	 */
 	struct data *ptr;
-	ptr = &data;
+	ptr = arena_alloc(doc->arena, sizeof(struct data));
+	ptr->doc = doc;
+	ptr->offset = 0;
+	long block;	// Where the block being tried starts (see TRY_BLOCK())
+	PROBE0(doc__start);
 
 	struct files files;
-	data.files	= &files;
+	ptr->files	= &files;
 	files.src	= src;
 	files.dest	= dest;
 
+	long out_start = STATS.enabled ? ftell(dest) : -1;	// -1 for pipes, which we can't measure
+
 	struct config config;
-	data.config		= &config;
+	ptr->config		= &config;
 	config.BOLD_OPEN	= false;
 	config.ITALIC_OPEN	= false;
 	config.LINK_OPEN	= false;
@@ -966,25 +1698,27 @@ htmlize(FILE *src, FILE *dest)
 
 	/* Initialize with empty lines */
 	for (int i = 0; i < READAHEAD_LINES; i++)
-		memset(data.readahead[i], '\0', MAX_LINE_LENGTH);
+		memset(ptr->readahead[i], '\0', MAX_LINE_LENGTH);
 	for (int i = 0; i < HISTORY_LINES; i++)
-		memset(data.history[i], '\0', MAX_LINE_LENGTH);
+		memset(ptr->history[i], '\0', MAX_LINE_LENGTH);
 
-	/* Populate data.readahead */
+	/* Populate ptr->readahead */
 	for (int i = 0; i < READAHEAD_LINES; i++)
 	{
-		if (fgets(data.readahead[i], MAX_LINE_LENGTH, src) == NULL)
+		if (fgets(ptr->readahead[i], MAX_LINE_LENGTH, src) == NULL)
 			break;
-		if (!memcmp(data.readahead[i], "---\n", 5))
+		STAT_ADD(lines, 1);
+		STAT_ADD(bytes_in, strlen(ptr->readahead[i]));
+		if (!memcmp(ptr->readahead[i], "---\n", 5))
 		{
-			data.readahead[i][0] = '\0';	// Mark as empty
+			ptr->readahead[i][0] = '\0';	// Mark as empty
 			break;
 		}
 	}
 
 	/* If the first line we read is empty, that means we hit EOF as-soon-as
 	 * we started reading. ie. We received no input. */
-	if (!memcmp(data.readahead[0], "", 1))
+	if (!memcmp(ptr->readahead[0], "", 1))
 		return 1;	// No input
 
 	ptr->line = ptr->readahead[0];
@@ -999,11 +1733,13 @@ htmlize(FILE *src, FILE *dest)
 
 		/* Check if the current line is worth anything to anyone */
 		if (
-				   !CODEBLOCK(ptr)
-				|| !FOOTNOTES(ptr)
-				|| !LISTS(ptr)
-				|| !TABLE(ptr)
-				|| !LINKDEF(ptr)
+				   TRY_BLOCK(CODEBLOCK)
+				|| TRY_BLOCK(FOOTNOTES)
+				|| TRY_BLOCK(LISTS)
+				|| TRY_BLOCK(INCLUDE)
+				|| TRY_BLOCK(CSV_TABLE)
+				|| TRY_BLOCK(TABLE)
+				|| TRY_BLOCK(LINKDEF)
 				|| !1 // XXX: Replace the 1 with any new function
 		   ) {;}
 		else
@@ -1014,6 +1750,14 @@ htmlize(FILE *src, FILE *dest)
 		}
 		get_next_line(ptr);
 	}
+
+	if (out_start >= 0)
+	{
+		long out_end = ftell(dest);
+		if (out_end >= out_start)
+			STAT_ADD(bytes_out, out_end - out_start);
+	}
+	PROBE1(doc__done, ptr->offset);
 	return 0;
 }
 
@@ -0,0 +1,429 @@
+#define _XOPEN_SOURCE 700
+#include <ctype.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * ctype.h	- isspace(), isalnum(), isdigit()
+ * stdbool.h	- bool, true, false
+ * stdio.h	- open_memstream(), fopen(), fread(), fprintf()
+ * stdlib.h	- malloc(), free(), strtod()
+ * string.h	- str*(), mem*()
+ */
+
+#include "constants.h"
+#include "include/fingerprint.h"
+#include "include/images.h"
+#include "include/outfile.h"
+
+/*
+ * What a page links to, for each local image it has -
+ *
+ *  - SVGs are minified first (see svg_minify())
+ *  - Images of up to INLINE_IMAGE_MAX bytes become data: URIs, which saves
+ *    a request per image
+ *  - Anything bigger is copied to DEST_DIR/IMAGES_DIR under a fingerprinted
+ *    name, so it can be cached forever
+ *
+ * The result is kept in the image's imgcache entry, so an image that is
+ * used by many posts is only processed once per run.
+ */
+
+static char *
+read_file(const char *path, size_t *len)
+{
+	FILE *fp;
+	char *buf;
+	long size;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return NULL;
+	if (fseek(fp, 0, SEEK_END) || (size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET))
+	{
+		fclose(fp);
+		return NULL;
+	}
+	if ((buf = malloc(size + 1)) != NULL)
+	{
+		*len = fread(buf, 1, size, fp);
+		buf[*len] = '\0';
+	}
+	fclose(fp);
+	return buf;
+}
+
+
+/**** [START] SVG ****/
+static bool
+is_junk_element(const char *name, size_t len)
+/*
+ * Elements that only mean something to the editor the SVG was made in
+ */
+{
+	return (len == 8 && !memcmp(name, "metadata", 8))
+		|| !strncmp(name, "sodipodi:", 9)
+		|| !strncmp(name, "inkscape:", 9);
+}
+
+static bool
+is_junk_attribute(const char *name, size_t len)
+{
+	static const char *junk[] = {
+		"xmlns:dc", "xmlns:cc", "xmlns:rdf", "xmlns:svg",
+		"xmlns:sodipodi", "xmlns:inkscape",
+	};
+	for (size_t i = 0; i < sizeof(junk) / sizeof(*junk); i++)
+		if (len == strlen(junk[i]) && !memcmp(name, junk[i], len))
+			return true;
+	return !strncmp(name, "sodipodi:", 9) || !strncmp(name, "inkscape:", 9);
+}
+
+static void
+print_value(FILE *out, const char *value, size_t len, bool round)
+/*
+ * Collapses whitespace, and rounds numbers to SVG_PRECISION decimals (only
+ * in attributes; the text of a <text> is left alone)
+ */
+{
+	bool space = false;
+
+	for (size_t i = 0; i < len; i++)
+	{
+		if (isspace((unsigned char)value[i]))
+		{
+			space = true;
+			continue;
+		}
+		if (space && i > 0)
+			fputc(' ', out);
+		space = false;
+
+		bool number_start = isdigit((unsigned char)value[i])
+			|| (value[i] == '.' && i + 1 < len && isdigit((unsigned char)value[i+1]));
+		bool in_word = i > 0 && (isalnum((unsigned char)value[i-1])
+				|| value[i-1] == '_' || value[i-1] == '#');
+		if (!round || !number_start || in_word)
+		{
+			fputc(value[i], out);
+			continue;
+		}
+
+		/* Digits before and after the point */
+		size_t j = i, decimals = 0;
+		while (j < len && isdigit((unsigned char)value[j]))
+			j++;
+		if (j < len && value[j] == '.')
+			for (j++; j < len && isdigit((unsigned char)value[j]); j++)
+				decimals++;
+		bool exponent = j < len && (value[j] == 'e' || value[j] == 'E');
+
+		if (decimals <= SVG_PRECISION || exponent)
+			fwrite(value + i, 1, j - i, out);
+		else
+		{
+			char number[64];
+			size_t n = j - i < sizeof(number) - 1 ? j - i : sizeof(number) - 1;
+			memcpy(number, value + i, n);
+			number[n] = '\0';
+			snprintf(number, sizeof(number), "%.*f", SVG_PRECISION, strtod(number, NULL));
+
+			/* 1.500 -> 1.5, 2.000 -> 2 */
+			char *end = number + strlen(number);
+			while (end[-1] == '0')
+				*--end = '\0';
+			if (end[-1] == '.')
+				*--end = '\0';
+			fputs(number, out);
+		}
+		i = j - 1;
+	}
+}
+
+static const char *
+skip_element(const char *p, const char *name, size_t len)
+/*
+ * Skips past the end of an element that starts at p (right after its
+ * start tag), along with everything inside it
+ */
+{
+	int depth = 1;
+	while (depth > 0 && (p = strchr(p, '<')) != NULL)
+	{
+		bool closing = p[1] == '/';
+		const char *tag = p + 1 + closing;
+		const char *end = strchr(p, '>');
+		if (end == NULL)
+			return p + strlen(p);
+		if (!strncmp(tag, name, len) && (isspace((unsigned char)tag[len]) || tag[len] == '>' || tag[len] == '/'))
+		{
+			if (closing)
+				depth--;
+			else if (end[-1] != '/')
+				depth++;
+		}
+		p = end + 1;
+	}
+	return p == NULL ? name + strlen(name) : p;
+}
+
+char *
+svg_minify(const char *svg, size_t *out_len)
+/*
+ * Drops the XML declaration, comments, editor metadata (and the namespaces
+ * that come with it), whitespace between tags, and extra precision.
+ */
+{
+	char *buf;
+	FILE *out = open_memstream(&buf, out_len);
+	int text_depth = 0;	// Inside <text>, whitespace between tags matters
+	const char *p = svg;
+
+	while (*p != '\0')
+	{
+		if (*p != '<')
+		{
+			const char *end = strchr(p, '<');
+			if (end == NULL)
+				end = p + strlen(p);
+			bool blank = true;
+			for (const char *q = p; q < end; q++)
+				blank = blank && isspace((unsigned char)*q);
+			if (!blank || text_depth > 0)
+				print_value(out, p, end - p, false);
+			p = end;
+			continue;
+		}
+
+		if (!strncmp(p, "<!--", 4))
+		{
+			p = (p = strstr(p, "-->")) != NULL ? p + 3 : svg + strlen(svg);
+			continue;
+		}
+		if (!strncmp(p, "<![CDATA[", 9))
+		{
+			const char *end = strstr(p, "]]>");
+			end = end != NULL ? end + 3 : p + strlen(p);
+			fwrite(p, 1, end - p, out);
+			p = end;
+			continue;
+		}
+		if (p[1] == '?' || p[1] == '!')	// <?xml ...?>, <!DOCTYPE ...>
+		{
+			p = (p = strchr(p, '>')) != NULL ? p + 1 : svg + strlen(svg);
+			continue;
+		}
+
+		bool closing = p[1] == '/';
+		const char *name = p + 1 + closing;
+		size_t name_len = strcspn(name, " \t\r\n/>");
+		const char *q = name + name_len;
+
+		if (closing)
+		{
+			if (name_len == 4 && !memcmp(name, "text", 4))
+				text_depth--;
+			fprintf(out, "</%.*s>", (int)name_len, name);
+			p = (p = strchr(q, '>')) != NULL ? p + 1 : svg + strlen(svg);
+			continue;
+		}
+
+		/* A start tag. Go through its attributes. */
+		char *tag_buf;
+		size_t tag_len;
+		FILE *tag = open_memstream(&tag_buf, &tag_len);
+		bool self_closing = false;
+
+		fprintf(tag, "<%.*s", (int)name_len, name);
+		while (*q != '\0' && *q != '>')
+		{
+			if (isspace((unsigned char)*q))
+			{
+				q++;
+				continue;
+			}
+			if (*q == '/')
+			{
+				self_closing = true;
+				q++;
+				continue;
+			}
+
+			const char *attr = q;
+			size_t attr_len = strcspn(q, " \t\r\n=/>");
+			const char *value = NULL;
+			size_t value_len = 0;
+			q += attr_len;
+			if (*q == '=')
+			{
+				q++;
+				char quote = (*q == '"' || *q == '\'') ? *q++ : ' ';
+				value = q;
+				while (*q != '\0' && *q != quote && (quote != ' ' || (*q != '>' && !isspace((unsigned char)*q))))
+					q++;
+				value_len = q - value;
+				if (quote != ' ' && *q != '\0')
+					q++;
+			}
+			if (attr_len == 0)
+			{
+				q++;	// Garbage. Don't get stuck on it.
+				continue;
+			}
+			if (is_junk_attribute(attr, attr_len))
+				continue;
+
+			fprintf(tag, " %.*s", (int)attr_len, attr);
+			if (value != NULL)
+			{
+				char quote = memchr(value, '"', value_len) ? '\'' : '"';
+				fputc('=', tag);
+				fputc(quote, tag);
+				print_value(tag, value, value_len, true);
+				fputc(quote, tag);
+			}
+		}
+		fputs(self_closing ? "/>" : ">", tag);
+		fclose(tag);
+		p = *q == '>' ? q + 1 : q;
+
+		if (is_junk_element(name, name_len))
+		{
+			if (!self_closing)
+				p = skip_element(p, name, name_len);
+		}
+		else
+		{
+			if (!self_closing && name_len == 4 && !memcmp(name, "text", 4))
+				text_depth++;
+			fwrite(tag_buf, 1, tag_len, out);
+		}
+		free(tag_buf);
+	}
+
+	fclose(out);
+	return buf;
+}
+/**** [END] SVG ****/
+
+
+/**** [START] data: URIs ****/
+static void
+print_base64(FILE *out, const unsigned char *data, size_t len)
+{
+	static const char digits[] =
+		"ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+	for (size_t i = 0; i < len; i += 3)
+	{
+		unsigned long n = (unsigned long)data[i] << 16
+			| (i + 1 < len ? (unsigned long)data[i+1] << 8 : 0)
+			| (i + 2 < len ? data[i+2] : 0);
+		fputc(digits[n >> 18 & 63], out);
+		fputc(digits[n >> 12 & 63], out);
+		fputc(i + 1 < len ? digits[n >> 6 & 63] : '=', out);
+		fputc(i + 2 < len ? digits[n & 63] : '=', out);
+	}
+}
+
+static void
+print_svg_uri(FILE *out, const char *svg, size_t len)
+/*
+ * SVG is mostly text, so percent-encoding it is a lot smaller than base64
+ */
+{
+	bool apostrophes = memchr(svg, '\'', len) != NULL;
+
+	fputs("data:image/svg+xml,", out);
+	for (size_t i = 0; i < len; i++)
+	{
+		unsigned char c = svg[i];
+		if (c == '"' && !apostrophes)
+			fputc('\'', out);	// Just as good in XML, and saves the "%22"
+		else if (c <= ' ' || c >= 0x7F || strchr("%#<>&?\"", c))
+			fprintf(out, "%%%02X", c);
+		else
+			fputc(c, out);
+	}
+}
+
+static const char *
+mime_type(const char *path)
+{
+	static const struct { const char *ext, *type; } types[] = {
+		{ ".png",  "image/png"  },
+		{ ".gif",  "image/gif"  },
+		{ ".jpg",  "image/jpeg" },
+		{ ".jpeg", "image/jpeg" },
+		{ ".webp", "image/webp" },
+	};
+	const char *ext = strrchr(path, '.');
+	for (size_t i = 0; ext != NULL && i < sizeof(types) / sizeof(*types); i++)
+		if (!strcmp(ext, types[i].ext))
+			return types[i].type;
+	return NULL;
+}
+/**** [END] data: URIs ****/
+
+
+const char *
+image_url(struct imgsize_entry *image)
+/*
+ * Returns the URL to use for the image, or NULL if it can't be read. Only
+ * types that have a MIME type (or SVGs) are inlined, the rest are copied.
+ */
+{
+	char *data, *buf;
+	size_t len, buf_len;
+	const char *ext = strrchr(image->path, '.');
+	bool svg = ext != NULL && !strcmp(ext, ".svg");
+
+	if (image->url != NULL)
+		return image->url;
+	if ((data = read_file(image->path, &len)) == NULL)
+		return NULL;
+	if (svg)
+	{
+		char *min = svg_minify(data, &len);
+		free(data);
+		data = min;
+	}
+
+	FILE *out = open_memstream(&buf, &buf_len);
+	if (len <= INLINE_IMAGE_MAX && (svg || mime_type(image->path) != NULL))
+	{
+		if (svg)
+			print_svg_uri(out, data, len);
+		else
+		{
+			fprintf(out, "data:%s;base64,", mime_type(image->path));
+			print_base64(out, (unsigned char *)data, len);
+		}
+	}
+	else
+	{
+		struct outfile outfile;
+		char name[FILENAME_MAX], path[2 * FILENAME_MAX];
+		FILE *fp;
+
+		fingerprint_name(name, sizeof(name), image->path, data, len);
+		snprintf(path, sizeof(path), "%s/%s/%s", DEST_DIR, IMAGES_DIR, name);
+		if ((fp = outfile_open(&outfile, path)) == NULL)
+		{
+			fclose(out);
+			free(buf);
+			free(data);
+			return NULL;
+		}
+		fwrite(data, 1, len, fp);
+		if (outfile_close(&outfile) == -1)
+			fprintf(stderr, "images: cannot write %s\n", path);
+		fprintf(out, "%s/%s", IMAGES_DIR, name);
+	}
+	fclose(out);
+	free(data);
+	return image->url = buf;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
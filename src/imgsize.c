@@ -0,0 +1,305 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * stdio.h	- fopen(), fread(), fprintf(), fscanf()
+ * stdlib.h	- realloc(), strtod()
+ * string.h	- str*(), mem*()
+ * sys/stat.h	- stat()
+ */
+
+#include "include/hash.h"
+#include "include/imgsize.h"
+
+#define MTIME_NS(st) \
+	((int64_t)(st).st_mtim.tv_sec * 1000000000 + (st).st_mtim.tv_nsec)
+
+#define BE16(p)	((unsigned)(p)[0] << 8 | (p)[1])
+#define BE32(p)	((unsigned)(p)[0] << 24 | (unsigned)(p)[1] << 16 | (unsigned)(p)[2] << 8 | (p)[3])
+#define LE16(p)	((unsigned)(p)[1] << 8 | (p)[0])
+
+
+/**** [START] Reading headers ****/
+static int
+jpeg_size(FILE *fp, unsigned *width, unsigned *height)
+/*
+ * Walks the segments up to the first SOFn, which has the frame size
+ */
+{
+	unsigned char seg[7];
+	int c;
+
+	for (;;)
+	{
+		while ((c = getc(fp)) != EOF && c != 0xFF)
+			;
+		while (c == 0xFF)
+			c = getc(fp);
+		if (c == EOF || c == 0xD9 || c == 0xDA)	// End of image, start of scan
+			return 1;
+		if (c == 0x01 || (c >= 0xD0 && c <= 0xD7))	// No length
+			continue;
+		if (fread(seg, 1, 2, fp) != 2)
+			return 1;
+
+		/* SOF0..SOF15, except DHT (C4), JPG (C8) and DAC (CC) */
+		if (c >= 0xC0 && c <= 0xCF && c != 0xC4 && c != 0xC8 && c != 0xCC)
+		{
+			if (fread(seg + 2, 1, 5, fp) != 5)
+				return 1;
+			*height = BE16(seg + 3);
+			*width  = BE16(seg + 5);
+			return 0;
+		}
+		if (BE16(seg) < 2 || fseek(fp, BE16(seg) - 2, SEEK_CUR))
+			return 1;
+	}
+}
+
+static unsigned
+svg_length(const char *tag, const char *name)
+/*
+ * The value of a width/height attribute, if it's in pixels
+ */
+{
+	char pattern[16];
+	const char *p = tag;
+	char *end;
+
+	snprintf(pattern, sizeof(pattern), " %s=", name);
+	while ((p = strstr(p, pattern)) != NULL)
+	{
+		p += strlen(pattern);
+		if (*p == '"' || *p == '\'')
+			p++;
+		double n = strtod(p, &end);
+		if (end == p || n <= 0)
+			return 0;
+		if (*end == '"' || *end == '\'' || !strncmp(end, "px", 2))
+			return (unsigned)(n + 0.5);
+		return 0;	// em, %, etc. mean nothing without a page around them
+	}
+	return 0;
+}
+
+static int
+svg_size(FILE *fp, unsigned *width, unsigned *height)
+{
+	char buf[4096], *tag, *end;
+	size_t len = fread(buf, 1, sizeof(buf) - 1, fp);
+
+	buf[len] = '\0';
+	if ((tag = strstr(buf, "<svg")) == NULL || (end = strchr(tag, '>')) == NULL)
+		return 1;
+	*end = '\0';
+	for (char *p = tag; *p != '\0'; p++)	// Makes the attribute search simpler
+		if (*p == '\n' || *p == '\t' || *p == '\r')
+			*p = ' ';
+
+	*width  = svg_length(tag, "width");
+	*height = svg_length(tag, "height");
+	if (*width != 0 && *height != 0)
+		return 0;
+
+	/* Fall back to the viewBox, which is "min-x min-y width height" */
+	char *box = strstr(tag, " viewBox=");
+	double w, h;
+	if (box == NULL || sscanf(box + 10, "%*f%*[ ,]%*f%*[ ,]%lf%*[ ,]%lf", &w, &h) != 2 || w <= 0 || h <= 0)
+		return 1;
+	*width  = (unsigned)(w + 0.5);
+	*height = (unsigned)(h + 0.5);
+	return 0;
+}
+
+int
+imgsize(const char *path, unsigned *width, unsigned *height)
+/*
+ * Gets the dimensions of a PNG, JPEG, GIF or SVG file by reading only as
+ * much of it as needed. Returns non-zero if it couldn't.
+ */
+{
+	unsigned char head[24];
+	FILE *fp;
+	size_t len;
+	int retval = 1;
+
+	if ((fp = fopen(path, "r")) == NULL)
+		return 1;
+	len = fread(head, 1, sizeof(head), fp);
+
+	if (len >= 24 && !memcmp(head, "\x89PNG\r\n\x1a\n", 8) && !memcmp(head + 12, "IHDR", 4))
+	{
+		*width  = BE32(head + 16);
+		*height = BE32(head + 20);
+		retval  = 0;
+	}
+	else if (len >= 10 && (!memcmp(head, "GIF87a", 6) || !memcmp(head, "GIF89a", 6)))
+	{
+		*width  = LE16(head + 6);
+		*height = LE16(head + 8);
+		retval  = 0;
+	}
+	else if (len >= 3 && !memcmp(head, "\xFF\xD8\xFF", 3))
+	{
+		fseek(fp, 2, SEEK_SET);
+		retval = jpeg_size(fp, width, height);
+	}
+	else if (len > 0)
+	{
+		const char *ext = strrchr(path, '.');
+		if (ext != NULL && !strcmp(ext, ".svg"))
+		{
+			rewind(fp);
+			retval = svg_size(fp, width, height);
+		}
+	}
+	fclose(fp);
+	return retval;
+}
+/**** [END] Reading headers ****/
+
+
+/**** [START] Cache ****/
+static void *
+xrealloc(void *p, size_t size)
+{
+	if ((p = realloc(p, size)) == NULL)
+	{
+		fputs("imgsize: out of memory\n", stderr);
+		exit(1);
+	}
+	return p;
+}
+
+static struct imgsize_entry *
+find(struct imgcache *cache, const char *path, size_t *slot)
+{
+	size_t h = hash_str(path) & (cache->nslots - 1);
+	for (; cache->slots[h] != 0; h = (h + 1) & (cache->nslots - 1))
+		if (!strcmp(cache->entries[cache->slots[h] - 1].path, path))
+			break;
+	*slot = h;
+	return cache->slots[h] ? &cache->entries[cache->slots[h] - 1] : NULL;
+}
+
+static struct imgsize_entry *
+add(struct imgcache *cache, const char *path)
+{
+	size_t slot;
+
+	if (2 * (cache->count + 1) > cache->nslots)
+	{
+		cache->nslots *= 2;
+		free(cache->slots);
+		cache->slots = xrealloc(NULL, cache->nslots * sizeof(*cache->slots));
+		memset(cache->slots, 0, cache->nslots * sizeof(*cache->slots));
+		for (size_t i = 0; i < cache->count; i++)
+		{
+			find(cache, cache->entries[i].path, &slot);
+			cache->slots[slot] = i + 1;
+		}
+	}
+
+	struct imgsize_entry *entry = find(cache, path, &slot);
+	if (entry != NULL)
+		return entry;
+	if (cache->count == cache->cap)
+	{
+		cache->cap = cache->cap ? 2 * cache->cap : 64;
+		cache->entries = xrealloc(cache->entries, cache->cap * sizeof(*cache->entries));
+	}
+	cache->slots[slot] = cache->count + 1;
+	entry = &cache->entries[cache->count++];
+	entry->path = strcpy(xrealloc(NULL, strlen(path) + 1), path);
+	entry->url  = NULL;
+	return entry;
+}
+
+void
+imgcache_load(struct imgcache *cache, const char *file)
+/*
+ * One image per line - "mtime width height path"
+ */
+{
+	FILE *fp;
+	char path[FILENAME_MAX];
+	long long mtime;
+	unsigned width, height;
+
+	memset(cache, 0, sizeof(*cache));
+	cache->nslots = 64;
+	cache->slots  = xrealloc(NULL, cache->nslots * sizeof(*cache->slots));
+	memset(cache->slots, 0, cache->nslots * sizeof(*cache->slots));
+
+	if ((fp = fopen(file, "r")) == NULL)
+		return;
+	while (fscanf(fp, "%lld %u %u ", &mtime, &width, &height) == 3
+			&& fgets(path, sizeof(path), fp) != NULL)
+	{
+		path[strcspn(path, "\n")] = '\0';
+		struct imgsize_entry *entry = add(cache, path);
+		entry->mtime  = mtime;
+		entry->width  = width;
+		entry->height = height;
+	}
+	fclose(fp);
+}
+
+int
+imgcache_save(struct imgcache *cache, const char *file)
+{
+	FILE *fp;
+
+	if (!cache->dirty)
+		return 0;
+	if ((fp = fopen(file, "w")) == NULL)
+		return 1;
+	for (size_t i = 0; i < cache->count; i++)
+		fprintf(fp, "%lld %u %u %s\n", (long long)cache->entries[i].mtime,
+				cache->entries[i].width, cache->entries[i].height, cache->entries[i].path);
+	cache->dirty = false;
+	return fclose(fp) != 0;
+}
+
+struct imgsize_entry *
+imgcache_entry(struct imgcache *cache, const char *path)
+/*
+ * Returns NULL if there's no such file
+ */
+{
+	struct imgsize_entry *entry;
+	struct stat st;
+	size_t slot;
+
+	if (stat(path, &st))
+		return NULL;
+	if ((entry = find(cache, path, &slot)) == NULL || entry->mtime != MTIME_NS(st))
+	{
+		entry = add(cache, path);
+		entry->mtime = MTIME_NS(st);
+		if (imgsize(path, &entry->width, &entry->height))
+			entry->width = entry->height = 0;
+		free(entry->url);
+		entry->url = NULL;
+		cache->dirty = true;
+	}
+	return entry;
+}
+
+void
+imgcache_free(struct imgcache *cache)
+{
+	for (size_t i = 0; i < cache->count; i++)
+	{
+		free(cache->entries[i].path);
+		free(cache->entries[i].url);
+	}
+	free(cache->entries);
+	free(cache->slots);
+}
+/**** [END] Cache ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
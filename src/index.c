@@ -2,21 +2,42 @@
  * TODO: Allow HTML character references in TITLE
  * (tip: use "include/charref.h")
  */
+#define _XOPEN_SOURCE 700
+#include <dirent.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stdint.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
-#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 /*
- * stdio.h  - fopen, fclose
- * string.h - memcmp, memchr
- * dirent.h - opendir, readdir
+ * dirent.h   - opendir, readdir
+ * errno.h    - EEXIST
+ * stdbool.h  - bool
+ * stdint.h   - uint32_t, uint64_t
+ * stdio.h    - fprintf, snprintf
+ * stdlib.h   - malloc, free, strtoul
+ * string.h   - strlen, strcmp, strcpy
+ * sys/stat.h - mkdir
+ * unistd.h   - getopt, unlink
  */
 
 #include "constants.h"
 #include "include/cd.h"
-#include "include/date_to_text.h"
+#include "include/date.h"
 #include "include/escape.h"
-#include "include/stoi.h"
+#include "include/head.h"
+#include "include/hash.h"
+#include "include/links.h"
+#include "include/outfile.h"
+#include "include/postdb.h"
+#include "include/radix.h"
+#include "include/search.h"
+#include "include/tags.h"
+#include "include/trace.h"
 #include "include/urlencode.h"
 
 #define cd(x) \
@@ -26,167 +47,641 @@ static const char INITIAL_TEXT[] = "\
 <html>\n\
     <head>\n\
         <meta charset=\"utf-8\"/>\n\
+%s\
         <title>subnut's blog</title>\n\
-        %s\n\
-        <link rel=\"stylesheet\" href=\"style.css\" media=\"screen\">\n\
-        <link rel=\"stylesheet\" href=\"recursive.css\" media=\"screen\">\n\
+%s\
+        <link rel=\"alternate\" type=\"application/atom+xml\" href=\"feed.xml\">\n\
+        <script src=\"index.js\" defer></script>\n\
+        <script src=\"search.js\" defer></script>\n\
     </head>\n\
     <body class=\"blog-index\">\n\
         <header>\n\
             <h1 class=\"blog-title\">subnut's blog</h1>\n\
         </header>\n\
         <div id=\"wrapper\">\n\
-            <table class=\"blog-index\">\n\
+";
+
+static const char TABLE_START[] = "\
+            <table class=\"blog-index\"%s>\n\
 <!-- Index starts here -->\n\
 ";
 
-static const char FINAL_TEXT[] = "\
+static const char TABLE_END[] = "\
 <!-- Index ends here -->\n\
             </table>\n\
-            <br>\n\
-            <br>\n\
+";
+
+static const char FINAL_TEXT[] = "\
+            <p class=\"blog-index-nav\">\n\
+%s\
+            </p>\n\
             %s\n\
         </div>\n\
     </body>\n\
-</head>\n\
+</html>\n\
 ";
 
-int
-main(int argc, const char **argv)
+/*
+ * Pages other than index.html live in a subdirectory, but all the links in
+ * them are written relative to the top of the site
+ */
+static const char PAGE_BASE[] = "        <base href=\"../\">\n";
+
+
+/*
+ * The posts are cut into pages of INDEX_PAGE_SIZE starting from the oldest
+ * post, so that page N always holds the same posts. Only the newest page
+ * (which is also index.html) changes when a post is added, and a page is
+ * written to disk only if it actually changed.
+ */
+struct pages {
+	const struct postdb	*db;
+	const struct radix_item	*posts;	/* Oldest first */
+	size_t			 count;
+	size_t			 npages;
+	const char		*head;	/* The <link>s to the assets */
+};
+
+static void
+page_html(char *path, size_t size, const struct pages *pages, size_t page)
 {
-	DIR *dir;
-	FILE *outfile;
-	struct dirent *dirent;
-	char filenames[MAX_FILES + 1][FILENAME_MAX + 1];	// +1 because index starts at 0
+	if (page == pages->npages)
+		snprintf(path, size, "index.html");
+	else
+		snprintf(path, size, "page/%zu.html", page);
+}
 
-	// Mark all records as empty
-	for (int i=1; i <= MAX_FILES; i++)
-		*filenames[i] = '\0';
+static void
+print_row(FILE *out, const struct postdb *db, const struct postdb_record *rec)
+{
+	const char *name  = postdb_str(db, rec->name);
+	const char *TITLE = postdb_str(db, rec->title);
 
-	if (cd(DEST_DIR))
-		return 1;
+	char DATE_CREATED_str[DATE_TEXT_SIZE];
 
-	outfile = fopen("index.html", "w");
-	fprintf(outfile, INITIAL_TEXT, FAVICON);
+	date_text(rec->created, DATE_CREATED_str);
 
-	if ((dir = opendir(".")) == NULL)
+	/*
+	fprintf(out,
+			"<tr>\n"
+			"    <td class=\"blog-index-name\">\n"
+			"        <a href=\"%s\">%s</a>\n"
+			"    </td>\n"
+			"    <td class=\"blog-index-date\">\n"
+			"        %s\n"
+			"    </td>\n"
+			"</tr>\n",
+			url,
+			TITLE,
+			DATE_CREATED_str
+		 );
+	*/
+
+	fputs(
+			"<tr>\n"
+			"    <td class=\"blog-index-name\">\n"
+			"        <a href=\"", out);
+	fputs_urlencoded(name, out);
+	fputs("\">", out);
+	fputs_escaped(TITLE, out);
+	fprintf(out,                  "</a>\n"
+			"    </td>\n"
+			"    <td class=\"blog-index-date\">\n"
+			"        %s\n"
+			"    </td>\n"
+			"</tr>\n",
+			DATE_CREATED_str
+		 );
+}
+
+static int
+close_page(struct outfile *outfile)
+/*
+ * Returns 1 if the page couldn't be written
+ */
+{
+	const char *path = outfile->path;
+	int written = outfile_close(outfile);
+
+#ifdef PRINT_FILENAMES
+	if (written == 1)
+		printf("%s\n", path);
+#else
+	(void)path;
+#endif /* PRINT_FILENAMES */
+	return written == -1;
+}
+
+static int
+write_page(const struct pages *pages, size_t page)
+{
+	struct outfile outfile;
+	FILE *out;
+	char path[64], link[64], older[64], nav[256];
+	size_t first = (page - 1) * INDEX_PAGE_SIZE;
+	size_t last  = first + INDEX_PAGE_SIZE;
+	if (last > pages->count)
+		last = pages->count;
+
+	/* Links to the neighbouring pages */
+	nav[0] = older[0] = '\0';
+	if (page > 1)
+	{
+		page_html(link, sizeof(link), pages, page - 1);
+		snprintf(older, sizeof(older), " data-older=\"page/%zu.json\"", page - 1);
+		snprintf(nav, sizeof(nav),
+				"                <a href=\"%s\" rel=\"prev\">Older posts</a>\n", link);
+	}
+	if (page < pages->npages)
 	{
-		fprintf(stderr, "index: opendir error");
+		page_html(link, sizeof(link), pages, page + 1);
+		snprintf(nav + strlen(nav), sizeof(nav) - strlen(nav),
+				"                <a href=\"%s\" rel=\"next\">Newer posts</a>\n", link);
+	}
+
+	page_html(path, sizeof(path), pages, page);
+	if ((out = outfile_open(&outfile, path)) == NULL)
 		return 1;
+
+	fprintf(out, INITIAL_TEXT, page == pages->npages ? "" : PAGE_BASE, pages->head);
+	fprintf(out, TABLE_START, older);
+	for (size_t i = last; i-- > first;)	// Newest first
+		print_row(out, pages->db, &pages->db->records[pages->posts[i].value]);
+	fputs(TABLE_END, out);
+	fprintf(out, FINAL_TEXT, nav, FOOTER);
+
+	return close_page(&outfile);
+}
+
+static int
+write_shard(const struct pages *pages, size_t page)
+/*
+ * The same rows as the HTML page, as compact JSON, for index.js to append
+ * to the table when the reader asks for more.
+ */
+{
+	struct outfile outfile;
+	FILE *out;
+	char path[64];
+	size_t first = (page - 1) * INDEX_PAGE_SIZE;
+	size_t last  = first + INDEX_PAGE_SIZE;
+	if (last > pages->count)
+		last = pages->count;
+
+	snprintf(path, sizeof(path), "page/%zu.json", page);
+	if ((out = outfile_open(&outfile, path)) == NULL)
+		return 1;
+
+	if (page > 1)
+		fprintf(out, "{\"older\":\"page/%zu.json\",\"posts\":[", page - 1);
+	else
+		fputs("{\"older\":null,\"posts\":[", out);
+	for (size_t i = last; i-- > first;)
+	{
+		const struct postdb_record *rec = &pages->db->records[pages->posts[i].value];
+		char DATE_CREATED_str[DATE_TEXT_SIZE];
+
+		date_text(rec->created, DATE_CREATED_str);
+
+		/* Encoded URLs have nothing that JSON would need escaped */
+		fprintf(out, "%s{\"u\":\"", i + 1 == last ? "" : ",");
+		fputs_urlencoded(postdb_str(pages->db, rec->name), out);
+		fputs("\",\"t\":\"", out);
+		fputs_json_escaped(postdb_str(pages->db, rec->title), out);
+		fprintf(out, "\",\"d\":\"%s\"}", DATE_CREATED_str);
 	}
-	while ((dirent = readdir(dir)) != NULL)
+	fputs("]}\n", out);
+
+	return close_page(&outfile);
+}
+
+/**** [START] Archives ****/
+/*
+ * Tag and month archives. One pass over the (sorted) posts files every post
+ * under each of its tags and under its month, so every group's list comes
+ * out already in order; then each group's page is written from its list.
+ */
+struct group {
+	char		*slug;		/* File name, without ".html" */
+	char		*label;		/* What the reader sees */
+	uint32_t	*posts;		/* Indices into pages->posts */
+	size_t		 count;
+	size_t		 cap;
+};
+
+struct groups {
+	const char	*dir;		/* "tag" or "archive" */
+	struct group	*group;
+	size_t		 count;
+	size_t		 cap;
+	uint32_t	*slots;		/* Hash table of group indices + 1 */
+	size_t		 nslots;
+};
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	if ((p = realloc(p, size)) == NULL)
 	{
-		char *name = dirent->d_name;
-		if (
-				name[0] == '.'		// ie. ., .., and hidden files
-				|| name[0] == '0'	// ie. 0-draft, 0-format, etc.
-				|| memcmp(strrchr(name, '.'), ".html", 5)	// not *.html
-				|| !memcmp(name, "index.html", 10)
-		   )
-			continue;
+		fputs("index: out of memory\n", stderr);
+		exit(1);
+	}
+	return p;
+}
+
+static char *
+xstrdup(const char *s)
+{
+	return strcpy(xrealloc(NULL, strlen(s) + 1), s);
+}
 
-		char *p = memchr(name, '-', FILENAME_MAX);	// defined in stdio.h
-		*p = '\0';
+static struct group *
+group_find(struct groups *groups, const char *slug)
+{
+	if (groups->nslots == 0)
+		return NULL;
+	size_t h = hash_str(slug) & (groups->nslots - 1);
+	for (; groups->slots[h] != 0; h = (h + 1) & (groups->nslots - 1))
+		if (!strcmp(groups->group[groups->slots[h] - 1].slug, slug))
+			return &groups->group[groups->slots[h] - 1];
+	return NULL;
+}
 
-		int num = stoi(name);
-		*p = '-';
+static void
+group_add(struct groups *groups, const char *slug, const char *label, uint32_t post)
+{
+	struct group *group;
 
-		strcpy(filenames[num], name);
+	if ((group = group_find(groups, slug)) == NULL)
+	{
+		if (groups->count == groups->cap)
+		{
+			groups->cap = groups->cap ? 2 * groups->cap : 16;
+			groups->group = xrealloc(groups->group, groups->cap * sizeof(*groups->group));
+		}
+		if (2 * (groups->count + 1) > groups->nslots)
+		{
+			/* Grow the hash table, and put everything back in */
+			groups->nslots = groups->nslots ? 2 * groups->nslots : 64;
+			free(groups->slots);
+			groups->slots = calloc(groups->nslots, sizeof(*groups->slots));
+			for (size_t i = 0; i < groups->count; i++)
+			{
+				size_t h = hash_str(groups->group[i].slug) & (groups->nslots - 1);
+				while (groups->slots[h] != 0)
+					h = (h + 1) & (groups->nslots - 1);
+				groups->slots[h] = i + 1;
+			}
+		}
+		size_t h = hash_str(slug) & (groups->nslots - 1);
+		while (groups->slots[h] != 0)
+			h = (h + 1) & (groups->nslots - 1);
+		groups->slots[h] = groups->count + 1;
+
+		group = &groups->group[groups->count++];
+		group->slug  = xstrdup(slug);
+		group->label = xstrdup(label);
+		group->posts = NULL;
+		group->count = group->cap = 0;
 	}
-	closedir(dir);
 
+	if (group->count == group->cap)
+	{
+		group->cap = group->cap ? 2 * group->cap : 8;
+		group->posts = xrealloc(group->posts, group->cap * sizeof(*group->posts));
+	}
+	group->posts[group->count++] = post;
+}
 
-	FILE *file;
+static void
+groups_free(struct groups *groups)
+{
+	for (size_t i = 0; i < groups->count; i++)
+	{
+		free(groups->group[i].slug);
+		free(groups->group[i].label);
+		free(groups->group[i].posts);
+	}
+	free(groups->group);
+	free(groups->slots);
+}
 
-	/*
-	 * Title.
-	 * +7 for the leading "TITLE: "
-	 * +2 for the trailing '\n' and '\0'
-	 */
-	char TITLE[MAX_TITLE_LENGTH + 9];
+static void
+collect_groups(const struct pages *pages, struct groups *tags, struct groups *months)
+{
+	static const char *month_names[] = {
+		"January", "February", "March", "April", "May", "June", "July",
+		"August", "September", "October", "November", "December",
+	};
 
-	/*
-	 * Date published.
-	 * 10 for the "YYYY/MM/DD"
-	 * +9 for the leading "CREATED:"
-	 * +1 for the trailing '\0'
-	 */
-	char DATE_CREATED[20];
+	for (size_t i = 0; i < pages->count; i++)
+	{
+		const struct postdb_record *rec = &pages->db->records[pages->posts[i].value];
+		const char *list = postdb_str(pages->db, rec->tags);
+		char tag[MAX_LINE_LENGTH], slug[MAX_LINE_LENGTH];
+
+		while (tags_next(&list, tag, sizeof(tag)))
+		{
+			tag_slug(tag, slug, sizeof(slug));
+			if (*slug != '\0')
+				group_add(tags, slug, tag, i);
+		}
+
+		if (rec->created != 0)
+		{
+			unsigned year  = DATE_YEAR(rec->created);
+			unsigned month = DATE_MONTH(rec->created);
+			snprintf(slug, sizeof(slug), "%04u-%02u", year, month);
+			snprintf(tag,  sizeof(tag),  "%s %u", month_names[month - 1], year);
+			group_add(months, slug, tag, i);
+		}
+	}
+}
+
+static int
+write_group(const struct pages *pages, const struct groups *groups, const struct group *group)
+{
+	struct outfile outfile;
+	FILE *out;
+	char path[MAX_LINE_LENGTH + 16];
 
-	for (int i=1; *filenames[i]!='\0' && i<=MAX_FILES ; i++)
+	snprintf(path, sizeof(path), "%s/%s.html", groups->dir, group->slug);
+	if ((out = outfile_open(&outfile, path)) == NULL)
+		return 1;
+
+	fprintf(out, INITIAL_TEXT, PAGE_BASE, pages->head);
+	fputs("            <h2 class=\"blog-index-heading\">", out);
+	fputs_escaped(group->label, out);
+	fputs("</h2>\n", out);
+	fprintf(out, TABLE_START, "");
+	for (size_t i = group->count; i-- > 0;)	// Newest first
+		print_row(out, pages->db, &pages->db->records[pages->posts[group->posts[i]].value]);
+	fputs(TABLE_END, out);
+	fprintf(out, FINAL_TEXT,
+			"                <a href=\"index.html\">All posts</a>\n"
+			"                <a href=\"archive/index.html\">Archives</a>\n",
+			FOOTER);
+
+	return close_page(&outfile);
+}
+
+static int
+compare_slugs(const void *a, const void *b)
+{
+	return strcmp((*(const struct group **)a)->slug, (*(const struct group **)b)->slug);
+}
+
+static void
+print_group_links(FILE *out, const struct groups *groups, bool reverse)
+{
+	/* Sort a list of pointers, since the hash table points into groups */
+	const struct group **sorted = xrealloc(NULL, (groups->count + 1) * sizeof(*sorted));
+	for (size_t i = 0; i < groups->count; i++)
+		sorted[i] = &groups->group[i];
+	qsort(sorted, groups->count, sizeof(*sorted), compare_slugs);
+
+	fputs("            <ul class=\"blog-archive\">\n", out);
+	for (size_t j = 0; j < groups->count; j++)
 	{
-		/* Skip if filename is invalid */
-		if ((file = fopen(filenames[i], "r")) == NULL)
-			continue;
+		const struct group *group = sorted[reverse ? groups->count - 1 - j : j];
+
+		fprintf(out, "                <li><a href=\"%s/", groups->dir);
+		fputs_urlencoded(group->slug, out);
+		fputs(".html\">", out);
+		fputs_escaped(group->label, out);
+		fprintf(out, "</a> (%zu)</li>\n", group->count);
+	}
+	fputs("            </ul>\n", out);
+	free(sorted);
+}
+
+static int
+write_archive_index(const struct pages *pages, const struct groups *tags, const struct groups *months)
+{
+	struct outfile outfile;
+	FILE *out;
 
-		/* Remove first line */
-        char first_line[6];
-		fgets(first_line, 6, file);	// "<!--\n" +1 for '\0'
+	if ((out = outfile_open(&outfile, "archive/index.html")) == NULL)
+		return 1;
 
-		/* Title */
-		fgets(TITLE, MAX_TITLE_LENGTH, file);
-		memmove(TITLE, TITLE + 6, MAX_TITLE_LENGTH - 6);	// Remove "TITLE:"
-		while (*TITLE == ' ')
-			memmove(TITLE, TITLE + 1, MAX_TITLE_LENGTH - 1);
-		*(strrchr(TITLE, '\n')) = '\0';
+	fprintf(out, INITIAL_TEXT, PAGE_BASE, pages->head);
+	fputs("            <h2 class=\"blog-index-heading\">Tags</h2>\n", out);
+	print_group_links(out, tags, false);
+	fputs("            <h2 class=\"blog-index-heading\">Months</h2>\n", out);
+	print_group_links(out, months, true);
+	fprintf(out, FINAL_TEXT,
+			"                <a href=\"index.html\">All posts</a>\n",
+			FOOTER);
 
-		/* Date created */
-		fgets(DATE_CREATED, 20, file);
-		memmove(DATE_CREATED, DATE_CREATED + 9, 20 - 9);	// Remove "DATE_CREATED:"
-		while (*DATE_CREATED == ' ')
-			memmove(DATE_CREATED, TITLE + 1, 20 - 1);
+	return close_page(&outfile);
+}
 
-		/* Done reading from file */
-		fclose(file);
+static void
+remove_stale(const struct groups *groups, const char *keep)
+/*
+ * Deletes the pages of groups that no longer exist (eg. a tag that was
+ * removed from its last post)
+ */
+{
+	DIR *dir;
+	struct dirent *dirent;
+	char path[FILENAME_MAX * 2];
 
+	if ((dir = opendir(groups->dir)) == NULL)
+		return;
+	while ((dirent = readdir(dir)) != NULL)
+	{
+		char slug[FILENAME_MAX];
+		char *ext = strrchr(dirent->d_name, '.');
+		if (ext == NULL || strcmp(ext, ".html") || !strcmp(dirent->d_name, keep))
+			continue;
 
-		char DATE_CREATED_str[15];
-		char url[FILENAME_MAX*3 + 1];
+		memcpy(slug, dirent->d_name, ext - dirent->d_name);
+		slug[ext - dirent->d_name] = '\0';
+		if (group_find((struct groups *)groups, slug) != NULL)
+			continue;
 
-		urlencode_s(filenames.names[i], url, FILENAME_MAX*3+1);
-		date_to_text(DATE_CREATED, DATE_CREATED_str);
+		snprintf(path, sizeof(path), "%s/%s", groups->dir, dirent->d_name);
+		unlink(path);
+#ifdef PRINT_FILENAMES
+		printf("%s (removed)\n", path);
+#endif /* PRINT_FILENAMES */
+	}
+	closedir(dir);
+}
 
-		/*
-		fprintf(outfile,
-				"<tr>\n"
-				"    <td class=\"blog-index-name\">\n"
-				"        <a href=\"%s\">%s</a>\n"
-				"    </td>\n"
-				"    <td class=\"blog-index-date\">\n"
-				"        %s\n"
-				"    </td>\n"
-				"</tr>\n",
-				url,
-				TITLE,
-				DATE_CREATED_str
-			 );
-		*/
-
-		fprintf(outfile,
-				"<tr>\n"
-				"    <td class=\"blog-index-name\">\n"
-				"        <a href=\"%s\">",
-				url);
-		fputs_escaped(TITLE, outfile);
-		fprintf(outfile,                  "</a>\n"
-				"    </td>\n"
-				"    <td class=\"blog-index-date\">\n"
-				"        %s\n"
-				"    </td>\n"
-				"</tr>\n",
-				DATE_CREATED_str
-			 );
+static void
+remove_stale_pages(const struct pages *pages)
+/*
+ * Deletes the pages past the last one (eg. after posts were removed), which
+ * would otherwise still be published, linking to pages that don't exist
+ */
+{
+	DIR *dir;
+	struct dirent *dirent;
+	char path[FILENAME_MAX * 2];
 
+	if ((dir = opendir("page")) == NULL)
+		return;
+	while ((dirent = readdir(dir)) != NULL)
+	{
+		char *ext;
+		unsigned long page = strtoul(dirent->d_name, &ext, 10);
+		if (ext == dirent->d_name
+				|| (strcmp(ext, ".html") && strcmp(ext, ".json"))
+				|| page < pages->npages
+				|| (page == pages->npages && !strcmp(ext, ".json")))
+			continue;	// The last page is index.html, but it has a shard
+
+		snprintf(path, sizeof(path), "page/%s", dirent->d_name);
+		unlink(path);
 #ifdef PRINT_FILENAMES
-		printf("%i:\t%s\n", i, filenames[i]);
+		printf("%s (removed)\n", path);
 #endif /* PRINT_FILENAMES */
+	}
+	closedir(dir);
+}
+
+static int
+write_archives(const struct pages *pages)
+{
+	struct groups tags   = { .dir = "tag"     };
+	struct groups months = { .dir = "archive" };
+	int retval = 0;
+
+	if ((mkdir("tag", 0755) && errno != EEXIST) || (mkdir("archive", 0755) && errno != EEXIST))
+	{
+		fprintf(stderr, "index: cannot create archive directories in %s\n", DEST_DIR);
+		return 1;
+	}
+
+	collect_groups(pages, &tags, &months);
+	for (size_t i = 0; i < tags.count; i++)
+		retval |= write_group(pages, &tags, &tags.group[i]);
+	for (size_t i = 0; i < months.count; i++)
+		retval |= write_group(pages, &months, &months.group[i]);
+	retval |= write_archive_index(pages, &tags, &months);
+
+	remove_stale(&tags, "");
+	remove_stale(&months, "index.html");
+
+	groups_free(&tags);
+	groups_free(&months);
+	return retval;
+}
+/**** [END] Archives ****/
+
+int
+main(int argc, const char **argv)
+{
+	struct postdb db;
+	struct radix_item *items, *scratch, *posts;
+	size_t count = 0;
+	bool by_date = false;	// Order by creation date instead of post number
+	double start = 0;	// Of the span being traced
+
+	for (int opt; (opt = getopt(argc, (char * const *)argv, "dnt:")) != -1;)
+		switch (opt)
+		{
+			case 'd': by_date = true;  break;
+			case 'n': by_date = false; break;
+			case 't':
+				if (trace_open(optarg, "index"))
+				{
+					fprintf(stderr, "%s: cannot write trace: %s\n", *argv, optarg);
+					return 1;
+				}
+				start = trace_start();
+				break;
+			default:
+				fprintf(stderr, "usage: %s [-d | -n] [-t trace.json]\n", *argv);
+				return 1;
+		}
+
+	/*
+	 * Everything we need to know about the posts is in the database that
+	 * blogify keeps, so we never have to open the posts themselves.
+	 */
+	if (postdb_open(&db, POSTDB_FILE, false))
+	{
+		fprintf(stderr, "%s: cannot open %s (run blogify first)\n", *argv, POSTDB_FILE);
+		return 1;
+	}
 
+	items   = malloc((db.header->count + 1) * sizeof(*items));
+	scratch = malloc((db.header->count + 1) * sizeof(*scratch));
+	if (items == NULL || scratch == NULL)
+	{
+		fprintf(stderr, "%s: out of memory\n", *argv);
+		return 1;
 	}
 
-	fprintf(outfile, FINAL_TEXT, FOOTER);
-	fclose(outfile);
+	for (uint32_t i = 0; i < db.header->count; i++)
+	{
+		const struct postdb_record *rec = &db.records[i];
+		const char *name = postdb_str(&db, rec->name);
+		if (
+				name[0] == '.'		// ie. hidden files
+				|| name[0] == '0'	// ie. 0-draft, 0-format, etc.
+		   )
+			continue;
+
+		/*
+		 * Sort on the date (if asked) first, and then on the post
+		 * number, so that posts made on the same day stay in order.
+		 */
+		items[count].key   = (uint64_t)(by_date ? rec->created : rec->number) << 32 | rec->number;
+		items[count].value = i;
+		count++;
+	}
+	posts = radix_sort(items, scratch, count);
+	trace_span("sort", POSTDB_FILE, start, -1);
+
+	char *head;
+	if ((head = head_load()) == NULL)
+	{
+		fprintf(stderr, "%s: cannot read %s (run assets first), the pages won't have any assets\n",
+				*argv, ASSETS_HEAD);
+		if ((head = strdup("")) == NULL)
+			return 1;
+	}
+
+	start = trace_start();
+	int retval = search_build(&db, SEARCH_DIR, DEST_DIR "/search");
+	trace_span("search", SEARCH_DIR, start, -1);
+	start = trace_start();
+	retval |= links_check(&db, LINKS_DIR, DEST_DIR, LINKGRAPH_FILE);
+	trace_span("links", LINKS_DIR, start, -1);
+
+	if (cd(DEST_DIR))
+		return 1;
+	if (mkdir("page", 0755) && errno != EEXIST)
+	{
+		fprintf(stderr, "%s: cannot create directory: %s/page\n", *argv, DEST_DIR);
+		return 1;
+	}
 
-	return 0;
+	struct pages pages = {
+		.db	= &db,
+		.posts	= posts,
+		.count	= count,
+		.npages	= count == 0 ? 1 : (count + INDEX_PAGE_SIZE - 1) / INDEX_PAGE_SIZE,
+		.head	= head,
+	};
+	start = trace_start();
+	for (size_t page = 1; page <= pages.npages; page++)
+		retval |= write_page(&pages, page) | write_shard(&pages, page);
+	remove_stale_pages(&pages);
+	trace_span("pages", NULL, start, -1);
+	start = trace_start();
+	retval |= write_archives(&pages);
+	trace_span("archives", NULL, start, -1);
+
+	postdb_close(&db);
+	free(items);
+	free(scratch);
+	free(head);
+	return retval;
 }
 
 // vim:noet:ts=4:sts=0:sw=0:fdm=syntax:nowrap
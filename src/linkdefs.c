@@ -0,0 +1,253 @@
+#define _XOPEN_SOURCE 700
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * fcntl.h	- open()
+ * stdint.h	- uint32_t
+ * stdio.h	- fopen(), getline(), fwrite()
+ * stdlib.h	- realloc(), calloc(), free()
+ * string.h	- str*(), mem*()
+ * sys/mman.h	- mmap(), munmap()
+ * sys/stat.h	- stat(), fstat()
+ * unistd.h	- close()
+ */
+
+#include "include/hash.h"
+#include "include/linkdefs.h"
+#include "include/outfile.h"
+
+#define MTIME_NS(st) \
+	((int64_t)(st).st_mtim.tv_sec * 1000000000 + (st).st_mtim.tv_nsec)
+
+
+/**** [START] Compiling ****/
+struct pool {
+	char		*buf;
+	size_t		 len;
+	size_t		 cap;
+	uint32_t	*defs;		/* Offsets of the definitions */
+	uint32_t	 count;
+	uint32_t	 cap_defs;
+};
+
+static int
+pool_add(struct pool *pool, const char *id, size_t id_len, const char *url, size_t url_len)
+{
+	size_t need = pool->len + id_len + url_len + 2;
+	char *buf;
+	uint32_t *defs;
+
+	if (need > pool->cap)
+	{
+		size_t cap = pool->cap ? 2 * pool->cap : 4096;
+		while (cap < need)
+			cap *= 2;
+		if ((buf = realloc(pool->buf, cap)) == NULL)
+			return 1;
+		pool->buf = buf;
+		pool->cap = cap;
+	}
+	if (pool->count == pool->cap_defs)
+	{
+		uint32_t cap = pool->cap_defs ? 2 * pool->cap_defs : 64;
+		if ((defs = realloc(pool->defs, cap * sizeof(*defs))) == NULL)
+			return 1;
+		pool->defs     = defs;
+		pool->cap_defs = cap;
+	}
+
+	pool->defs[pool->count++] = pool->len;
+	memcpy(pool->buf + pool->len, id, id_len);
+	pool->len += id_len;
+	pool->buf[pool->len++] = '\0';
+	memcpy(pool->buf + pool->len, url, url_len);
+	pool->len += url_len;
+	pool->buf[pool->len++] = '\0';
+	return 0;
+}
+
+static int
+parse(FILE *fp, struct pool *pool)
+/*
+ * Lines are "[id]: url", indented or not, the way they are in posts.
+ * Anything else (blank lines, "# comments") is skipped.
+ */
+{
+	char *line = NULL;
+	size_t size = 0;
+	int retval = 0;
+
+	while (getline(&line, &size, fp) != -1 && !retval)
+	{
+		char *id, *end, *url;
+
+		for (id = line; *id == ' ' || *id == '\t'; id++)
+			;
+		if (*id++ != '[' || (end = strchr(id, ']')) == NULL || end[1] != ':' || end == id)
+			continue;
+		for (url = end + 2; *url == ' ' || *url == '\t'; url++)
+			;
+		size_t url_len = strcspn(url, " \t\r\n");
+		if (url_len > 0)
+			retval = pool_add(pool, id, end - id, url, url_len);
+	}
+	free(line);
+	return retval;
+}
+
+static int
+compile(const char *src, const char *cache)
+/*
+ * A missing source is compiled into an empty table. The table is only
+ * rewritten if it changed, so the pages that are newer than it are still
+ * up to date.
+ */
+{
+	struct pool pool = { 0 };
+	struct linkdefs_header header;
+	struct outfile outfile;
+	uint32_t *slots = NULL, nslots = 16;
+	FILE *fp, *out;
+	int retval = 0;
+
+	if ((fp = fopen(src, "r")) != NULL)
+	{
+		retval = parse(fp, &pool);
+		fclose(fp);
+	}
+
+	while (nslots < 2 * pool.count)
+		nslots *= 2;
+	if (retval || (slots = calloc(nslots, sizeof(*slots))) == NULL)
+	{
+		free(pool.buf);
+		free(pool.defs);
+		return 1;
+	}
+
+	/* A later definition of an id replaces the earlier one */
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < pool.count; i++)
+	{
+		const char *id = pool.buf + pool.defs[i];
+		uint32_t h = hash_str(id) & (nslots - 1);
+		for (; slots[h] != 0; h = (h + 1) & (nslots - 1))
+			if (!strcmp(pool.buf + slots[h] - 1, id))
+				break;
+		count += slots[h] == 0;
+		slots[h] = pool.defs[i] + 1;
+	}
+
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, LINKDEFS_MAGIC, sizeof(header.magic));
+	header.version   = LINKDEFS_VERSION;
+	header.count     = count;
+	header.nslots    = nslots;
+	header.pool_size = pool.len;
+
+	if ((out = outfile_open(&outfile, cache)) == NULL)
+		retval = 1;
+	else
+	{
+		fwrite(&header, sizeof(header), 1, out);
+		fwrite(slots, sizeof(*slots), nslots, out);
+		fwrite(pool.buf, 1, pool.len, out);
+		retval = outfile_close(&outfile) == -1;
+	}
+	free(slots);
+	free(pool.buf);
+	free(pool.defs);
+	return retval;
+}
+/**** [END] Compiling ****/
+
+
+/**** [START] Lookup ****/
+static int
+map(struct linkdefs *defs, const char *cache)
+{
+	const struct linkdefs_header *h;
+	struct stat st;
+	int fd;
+
+	if ((fd = open(cache, O_RDONLY)) == -1)
+		return 1;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(*h))
+	{
+		close(fd);
+		return 1;
+	}
+	defs->map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+	close(fd);
+	if (defs->map == MAP_FAILED)
+	{
+		defs->map = NULL;
+		return 1;
+	}
+	defs->map_size = st.st_size;
+
+	h = (const struct linkdefs_header *)defs->map;
+	if (memcmp(h->magic, LINKDEFS_MAGIC, sizeof(h->magic)) || h->version != LINKDEFS_VERSION
+			|| h->nslots == 0 || (h->nslots & (h->nslots - 1))
+			|| sizeof(*h) + (size_t)h->nslots * sizeof(uint32_t) + h->pool_size != defs->map_size)
+	{
+		linkdefs_close(defs);
+		return 1;
+	}
+	defs->slots  = (const uint32_t *)(defs->map + sizeof(*h));
+	defs->nslots = h->nslots;
+	defs->pool   = (const char *)(defs->slots + h->nslots);
+	return 0;
+}
+
+int
+linkdefs_open(struct linkdefs *defs, const char *src, const char *cache)
+/*
+ * Compiles the definitions in *src into *cache, unless it is already up to
+ * date, and maps it. Returns 1 if it couldn't, which leaves *defs empty.
+ */
+{
+	struct stat src_st, cache_st;
+
+	memset(defs, 0, sizeof(*defs));
+	if (stat(cache, &cache_st) || stat(src, &src_st) || MTIME_NS(src_st) > MTIME_NS(cache_st))
+		if (compile(src, cache))
+			return 1;
+	return map(defs, cache);
+}
+
+const char *
+linkdefs_find(const struct linkdefs *defs, const char *id, size_t len)
+/*
+ * The URL that id (of len bytes, not '\0'-terminated) is defined as, or NULL
+ */
+{
+	if (defs == NULL || defs->map == NULL)
+		return NULL;
+	for (uint32_t h = hash_bytes(id, len) & (defs->nslots - 1); defs->slots[h] != 0;
+			h = (h + 1) & (defs->nslots - 1))
+	{
+		const char *key = defs->pool + defs->slots[h] - 1;
+		if (!strncmp(key, id, len) && key[len] == '\0')
+			return key + len + 1;
+	}
+	return NULL;
+}
+
+void
+linkdefs_close(struct linkdefs *defs)
+{
+	if (defs->map != NULL)
+		munmap(defs->map, defs->map_size);
+	defs->map = NULL;
+}
+/**** [END] Lookup ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,235 @@
+#define _XOPEN_SOURCE 700
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * stdint.h	- uint32_t
+ * stdio.h	- fopen(), fgets(), fprintf()
+ * stdlib.h	- realloc(), free()
+ * string.h	- str*(), mem*()
+ * sys/stat.h	- stat()
+ */
+
+#include "constants.h"
+#include "include/hash.h"
+#include "include/links.h"
+#include "include/outfile.h"
+
+/*
+ * Checks the links that blogify saved (see links.c) against the anchors of
+ * every post. All the anchors go into one hash set of "page#id" keys, along
+ * with the pages themselves, so that checking a link is a single lookup.
+ */
+
+/**** [START] Checking links ****/
+struct key {
+	char		*key;
+	long		 post;		/* Index of the post record, or -1 */
+};
+
+struct keyset {
+	struct key	*keys;
+	size_t		 count;
+	size_t		 cap;
+	size_t		*slots;		/* Indices into keys, + 1 */
+	size_t		 nslots;
+};
+
+struct link {
+	uint32_t	 from;		/* Index of the post record */
+	char		*href;
+};
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	if ((p = realloc(p, size)) == NULL)
+	{
+		fputs("links: out of memory\n", stderr);
+		exit(1);
+	}
+	return p;
+}
+
+static size_t
+slot(const struct keyset *set, const char *key)
+{
+	size_t h = hash_str(key) & (set->nslots - 1);
+	for (; set->slots[h] != 0; h = (h + 1) & (set->nslots - 1))
+		if (!strcmp(set->keys[set->slots[h] - 1].key, key))
+			break;
+	return h;
+}
+
+static struct key *
+lookup(const struct keyset *set, const char *key)
+{
+	size_t h = slot(set, key);
+	return set->slots[h] ? &set->keys[set->slots[h] - 1] : NULL;
+}
+
+static void
+insert(struct keyset *set, const char *key, long post)
+{
+	if (2 * (set->count + 1) > set->nslots)
+	{
+		free(set->slots);
+		set->nslots = set->nslots ? 2 * set->nslots : 256;
+		set->slots  = xrealloc(NULL, set->nslots * sizeof(*set->slots));
+		memset(set->slots, 0, set->nslots * sizeof(*set->slots));
+		for (size_t i = 0; i < set->count; i++)
+			set->slots[slot(set, set->keys[i].key)] = i + 1;
+	}
+
+	size_t h = slot(set, key);
+	if (set->slots[h] != 0)
+		return;
+	if (set->count == set->cap)
+	{
+		set->cap  = set->cap ? 2 * set->cap : 256;
+		set->keys = xrealloc(set->keys, set->cap * sizeof(*set->keys));
+	}
+	set->keys[set->count].key  = strcpy(xrealloc(NULL, strlen(key) + 1), key);
+	set->keys[set->count].post = post;
+	set->slots[h] = ++set->count;
+}
+
+static int
+save_graph(const struct postdb *db, const unsigned *inlinks, const char *path)
+{
+	struct outfile outfile;
+	FILE *out;
+
+	if ((out = outfile_open(&outfile, path)) == NULL)
+		return 1;
+	for (uint32_t i = 0; i < db->header->count; i++)
+		if (inlinks[i] > 0)
+			fprintf(out, "%u %s\n", inlinks[i], postdb_str(db, db->records[i].name));
+	return outfile_close(&outfile) == -1;
+}
+
+int
+links_check(const struct postdb *db, const char *links_dir, const char *dest_dir, const char *graph_file)
+/*
+ * Reports broken links on stderr; they don't fail the build. Links to files
+ * that aren't posts (the index, tag pages, images) only have to exist.
+ */
+{
+	struct keyset set = { 0 };
+	struct link *links = NULL;
+	size_t nlinks = 0, cap = 0, broken = 0;
+	uint32_t count = db->header->count;
+	char key[2 * FILENAME_MAX + 2];
+
+	for (uint32_t i = 0; i < count; i++)
+		insert(&set, postdb_str(db, db->records[i].name), i);
+
+	for (uint32_t i = 0; i < count; i++)
+	{
+		const char *name = postdb_str(db, db->records[i].name);
+		char line[FILENAME_MAX + 2];
+		FILE *fp;
+
+		snprintf(key, sizeof(key), "%s/%s.links", links_dir, name);
+		if ((fp = fopen(key, "r")) == NULL)
+			continue;
+		while (fgets(line, sizeof(line), fp) != NULL)
+		{
+			line[strcspn(line, "\n")] = '\0';
+			if (line[0] == '#')
+			{
+				snprintf(key, sizeof(key), "%s%s", name, line);
+				insert(&set, key, -1);
+			}
+			else if (line[0] == '>' && line[1] != '\0')
+			{
+				if (nlinks == cap)
+				{
+					cap   = cap ? 2 * cap : 256;
+					links = xrealloc(links, cap * sizeof(*links));
+				}
+				links[nlinks].from = i;
+				links[nlinks].href = strcpy(xrealloc(NULL, strlen(line)), line + 1);
+				nlinks++;
+			}
+		}
+		fclose(fp);
+	}
+
+	/*
+	 * Links come grouped by the post they're from, so remembering the last
+	 * post that linked to each post is enough to count every link once.
+	 */
+	unsigned *inlinks = xrealloc(NULL, (count + 1) * sizeof(*inlinks));
+	long *last_from   = xrealloc(NULL, (count + 1) * sizeof(*last_from));
+	for (uint32_t i = 0; i < count; i++)
+	{
+		inlinks[i]   = 0;
+		last_from[i] = -1;
+	}
+
+	for (size_t i = 0; i < nlinks; i++)
+	{
+		const char *from = postdb_str(db, db->records[links[i].from].name);
+		const char *href = links[i].href;
+		size_t page_len  = strcspn(href, "#");
+		const char *problem = NULL;
+		struct key *page;
+		struct stat st;
+
+		/* "#id" is an anchor in the post itself */
+		snprintf(key, sizeof(key), "%s%.*s", page_len ? "" : from, (int)page_len, href);
+		if ((page = lookup(&set, key)) == NULL)
+		{
+			char path[3 * FILENAME_MAX];
+			snprintf(path, sizeof(path), "%s/%s", dest_dir, key);
+			if (stat(path, &st))
+				problem = "no such page";
+			else
+				insert(&set, key, -1);	// Only stat() it once
+		}
+		else if (page->post >= 0 && href[page_len] == '#')
+		{
+			snprintf(key + strlen(key), sizeof(key) - strlen(key), "%s", href + page_len);
+			if (lookup(&set, key) == NULL)
+				problem = "no such anchor";
+		}
+
+		if (problem != NULL)
+		{
+			fprintf(stderr, "links: %s: broken link to %s (%s)\n", from, href, problem);
+			broken++;
+		}
+		else if (page != NULL && page->post >= 0 && page->post != links[i].from
+				&& last_from[page->post] != links[i].from)
+		{
+			last_from[page->post] = links[i].from;
+			inlinks[page->post]++;
+		}
+	}
+
+	int retval = save_graph(db, inlinks, graph_file);
+	if (retval)
+		fprintf(stderr, "links: cannot write %s\n", graph_file);
+
+#ifdef PRINT_FILENAMES
+	printf("%s: %zu links, %zu broken\n", graph_file, nlinks, broken);
+#endif /* PRINT_FILENAMES */
+
+	for (size_t i = 0; i < set.count; i++)
+		free(set.keys[i].key);
+	for (size_t i = 0; i < nlinks; i++)
+		free(links[i].href);
+	free(set.keys);
+	free(set.slots);
+	free(links);
+	free(inlinks);
+	free(last_from);
+	return retval;
+}
+/**** [END] Checking links ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
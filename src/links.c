@@ -0,0 +1,277 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * stdio.h	- fopen(), fgets(), fprintf()
+ * stdlib.h	- realloc(), free(), qsort()
+ * string.h	- str*(), mem*()
+ */
+
+#include "constants.h"
+#include "include/hash.h"
+#include "include/links.h"
+#include "include/outfile.h"
+
+/*
+ * The link graph of the site.
+ *
+ * While htmlize() renders a post, it tells us about every id it gives out
+ * (headings, footnotes, raw tags) and every local URL it links to. blogify
+ * saves both to a small per-post file in LINKS_DIR, so posts that aren't
+ * re-rendered keep theirs -
+ *
+ *	#id		for an anchor
+ *	>page#fragment	for a link, page being empty for the post itself
+ *
+ * links_check() (run by index) loads all of them, reports links to pages or
+ * anchors that don't exist, and saves how many posts link to each post in
+ * LINKGRAPH_FILE. blogify ranks a page's links with that, to tell the
+ * browser which pages are likely to be opened next.
+ */
+
+
+/**** [START] Collecting ****/
+struct links_doc *
+links_doc_new(struct arena *arena)
+{
+	struct links_doc *doc;
+	doc = arena_alloc(arena, sizeof(*doc));
+	memset(doc, 0, sizeof(*doc));
+	doc->arena = arena;
+	return doc;
+}
+
+static void
+push(struct arena *arena, char ***list, size_t *count, size_t *cap, char *s)
+{
+	if (*count == *cap)
+	{
+		/* The old list is simply left in the arena */
+		char **new;
+		*cap = *cap ? 2 * *cap : 16;
+		new  = arena_alloc(arena, *cap * sizeof(*new));
+		if (*count > 0)
+			memcpy(new, *list, *count * sizeof(*new));
+		*list = new;
+	}
+	(*list)[(*count)++] = s;
+}
+
+void
+links_anchor(struct links_doc *doc, const char *id, size_t len)
+{
+	if (len > 0)
+		push(doc->arena, &doc->anchors, &doc->nanchors, &doc->anchors_cap,
+				arena_strndup(doc->arena, id, len));
+}
+
+void
+links_href(struct links_doc *doc, const char *url, size_t len)
+/*
+ * Only relative URLs are kept, without any "./" or "?query"
+ */
+{
+	if (len == 0 || url[0] == '/')	// Also "//host/..."
+		return;
+	for (size_t i = 0; i < len && !strchr("/?#", url[i]); i++)
+		if (url[i] == ':')	// Has a scheme
+			return;
+	while (len >= 2 && !memcmp(url, "./", 2))
+	{
+		url += 2;
+		len -= 2;
+	}
+
+	size_t page = 0;
+	while (page < len && url[page] != '?' && url[page] != '#')
+		page++;
+	const char *fragment = memchr(url + page, '#', len - page);
+	size_t fragment_len  = fragment != NULL ? len - (fragment - url) : 0;
+	if (page == 0 && fragment_len <= 1)	// "", "#", "?x"
+		return;
+
+	char *href = arena_alloc(doc->arena, page + fragment_len + 1);
+	memcpy(href, url, page);
+	memcpy(href + page, fragment, fragment_len);
+	href[page + fragment_len] = '\0';
+	push(doc->arena, &doc->hrefs, &doc->nhrefs, &doc->hrefs_cap, href);
+}
+
+int
+links_doc_save(struct links_doc *doc, const char *path)
+{
+	struct outfile outfile;
+	FILE *out;
+
+	if ((out = outfile_open(&outfile, path)) == NULL)
+		return 1;
+	for (size_t i = 0; i < doc->nanchors; i++)
+		fprintf(out, "#%s\n", doc->anchors[i]);
+	for (size_t i = 0; i < doc->nhrefs; i++)
+		fprintf(out, ">%s\n", doc->hrefs[i]);
+	return outfile_close(&outfile) == -1;
+}
+/**** [END] Collecting ****/
+
+
+/**** [START] Prefetch hints ****/
+static void *
+xrealloc(void *p, size_t size)
+{
+	if ((p = realloc(p, size)) == NULL)
+	{
+		fputs("links: out of memory\n", stderr);
+		exit(1);
+	}
+	return p;
+}
+
+static size_t
+find(const struct linkgraph *graph, const char *name, size_t len)
+{
+	size_t h = hash_bytes(name, len) & (graph->nslots - 1);
+	for (; graph->slots[h] != 0; h = (h + 1) & (graph->nslots - 1))
+	{
+		const char *s = graph->names[graph->slots[h] - 1];
+		if (!strncmp(s, name, len) && s[len] == '\0')
+			break;
+	}
+	return h;
+}
+
+void
+linkgraph_load(struct linkgraph *graph, const char *file)
+/*
+ * One post per line - "inlinks name". A missing file is an empty graph.
+ */
+{
+	FILE *fp;
+	char name[FILENAME_MAX];
+	unsigned inlinks;
+	size_t cap = 0;
+
+	memset(graph, 0, sizeof(*graph));
+	if ((fp = fopen(file, "r")) != NULL)
+		while (fscanf(fp, "%u ", &inlinks) == 1 && fgets(name, sizeof(name), fp) != NULL)
+		{
+			if (graph->count == cap)
+			{
+				cap = cap ? 2 * cap : 64;
+				graph->names   = xrealloc(graph->names,   cap * sizeof(*graph->names));
+				graph->inlinks = xrealloc(graph->inlinks, cap * sizeof(*graph->inlinks));
+			}
+			name[strcspn(name, "\n")] = '\0';
+			graph->names[graph->count]   = strcpy(xrealloc(NULL, strlen(name) + 1), name);
+			graph->inlinks[graph->count] = inlinks;
+			graph->count++;
+		}
+	if (fp != NULL)
+		fclose(fp);
+
+	for (graph->nslots = 64; graph->nslots < 2 * graph->count;)
+		graph->nslots *= 2;
+	graph->slots = xrealloc(NULL, graph->nslots * sizeof(*graph->slots));
+	memset(graph->slots, 0, graph->nslots * sizeof(*graph->slots));
+	for (size_t i = 0; i < graph->count; i++)
+		graph->slots[find(graph, graph->names[i], strlen(graph->names[i]))] = i + 1;
+}
+
+void
+linkgraph_free(struct linkgraph *graph)
+{
+	for (size_t i = 0; i < graph->count; i++)
+		free(graph->names[i]);
+	free(graph->names);
+	free(graph->inlinks);
+	free(graph->slots);
+}
+
+struct target {
+	const char	*page;
+	size_t		 len;
+	size_t		 first;		/* Index of its first link */
+	unsigned	 score;
+};
+
+static int
+compare_targets(const void *a, const void *b)
+{
+	const struct target *x = a, *y = b;
+	size_t len = x->len < y->len ? x->len : y->len;
+	int cmp = memcmp(x->page, y->page, len);
+	if (cmp != 0)
+		return cmp;
+	if (x->len != y->len)
+		return x->len < y->len ? -1 : 1;
+	return x->first < y->first ? -1 : x->first > y->first;
+}
+
+void
+links_print_hints(struct links_doc *doc, const char *self, const struct linkgraph *graph, FILE *out)
+/*
+ * Picks up to PREFETCH_PAGES of the pages that this one links to, the ones
+ * it links to the most, and that the rest of the site links to the most,
+ * first. They are prefetched once this page has loaded, and prerendered
+ * when the pointer rests on a link to them.
+ */
+{
+	struct target *targets;
+	size_t count = 0, distinct = 0;
+
+	targets = arena_alloc(doc->arena, (doc->nhrefs + 1) * sizeof(*targets));
+	for (size_t i = 0; i < doc->nhrefs; i++)
+	{
+		const char *href = doc->hrefs[i];
+		size_t len = strcspn(href, "#");
+		if (len < 5 || memcmp(href + len - 5, ".html", 5)		// Not a page
+				|| (!strncmp(href, self, len) && self[len] == '\0')
+				|| href[strcspn(href, "\"<\\")] != '\0')	// Not worth escaping
+			continue;
+		targets[count++] = (struct target){ href, len, i, 0 };
+	}
+
+	/* Sorting puts the links to each page next to each other */
+	qsort(targets, count, sizeof(*targets), compare_targets);
+	for (size_t start = 0, end; start < count; start = end)
+	{
+		for (end = start + 1; end < count; end++)
+			if (targets[end].len != targets[start].len
+					|| memcmp(targets[end].page, targets[start].page, targets[start].len))
+				break;
+		targets[distinct] = targets[start];
+		targets[distinct].score = end - start;
+		if (graph->count > 0)
+		{
+			size_t slot = find(graph, targets[start].page, targets[start].len);
+			if (graph->slots[slot] != 0)
+				targets[distinct].score += graph->inlinks[graph->slots[slot] - 1];
+		}
+		distinct++;
+	}
+
+	/* Move the best ones to the front, in order */
+	size_t n = distinct < PREFETCH_PAGES ? distinct : PREFETCH_PAGES;
+	for (size_t i = 0; i < n; i++)
+		for (size_t j = i + 1; j < distinct; j++)
+			if (targets[j].score > targets[i].score
+					|| (targets[j].score == targets[i].score && targets[j].first < targets[i].first))
+			{
+				struct target t = targets[i];
+				targets[i] = targets[j];
+				targets[j] = t;
+			}
+	if (n == 0)
+		return;
+
+	for (size_t i = 0; i < n; i++)
+		fprintf(out, "        <link rel=\"prefetch\" href=\"%.*s\">\n", (int)targets[i].len, targets[i].page);
+	fputs("        <script type=\"speculationrules\">"
+			"{\"prerender\":[{\"source\":\"list\",\"eagerness\":\"moderate\",\"urls\":[", out);
+	for (size_t i = 0; i < n; i++)
+		fprintf(out, "%s\"%.*s\"", i ? "," : "", (int)targets[i].len, targets[i].page);
+	fputs("]}]}</script>\n", out);
+}
+/**** [END] Prefetch hints ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,86 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/*
+ * stdio.h	- open_memstream(), fopen(), fread(), fwrite()
+ * stdlib.h	- malloc(), free()
+ * string.h	- memcmp()
+ * sys/stat.h	- stat()
+ */
+
+#include "include/outfile.h"
+#include "include/probes.h"
+
+FILE *
+outfile_open(struct outfile *out, const char *path)
+/*
+ * *path must stay valid until outfile_close()
+ */
+{
+	out->path = path;
+	out->buf  = NULL;
+	out->len  = 0;
+	out->fp   = open_memstream(&out->buf, &out->len);
+	return out->fp;
+}
+
+static int
+unchanged(const struct outfile *out)
+{
+	struct stat st;
+	FILE *fp;
+	char *old;
+	int same;
+
+	if (stat(out->path, &st) || (size_t)st.st_size != out->len)
+		return 0;
+	if ((fp = fopen(out->path, "r")) == NULL)
+		return 0;
+	if ((old = malloc(out->len + 1)) == NULL)
+	{
+		fclose(fp);
+		return 0;
+	}
+	same = fread(old, 1, out->len, fp) == out->len && !memcmp(old, out->buf, out->len);
+	free(old);
+	fclose(fp);
+	return same;
+}
+
+int
+outfile_close(struct outfile *out)
+/*
+ * Returns 1 if the file was (re)written, 0 if it was already up to date,
+ * and -1 on error.
+ */
+{
+	FILE *fp;
+	int retval = 0;
+
+	if (fclose(out->fp))
+		retval = -1;
+	else if (!unchanged(out))
+	{
+		retval = 1;
+		if ((fp = fopen(out->path, "w")) == NULL)
+			retval = -1;
+		else
+		{
+			if (fwrite(out->buf, 1, out->len, fp) != out->len)
+				retval = -1;
+			if (fclose(fp))
+				retval = -1;
+		}
+	}
+	if (retval == -1)
+		perror(out->path);
+	PROBE3(flush, out->path, out->len, retval);
+	free(out->buf);
+	out->buf = NULL;
+	return retval;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
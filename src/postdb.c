@@ -0,0 +1,411 @@
+#define _XOPEN_SOURCE 700
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * ctype.h	- isdigit()
+ * fcntl.h	- open()
+ * stdio.h	- fprintf()
+ * stdlib.h	- calloc(), realloc(), free()
+ * string.h	- str*(), mem*()
+ * sys/mman.h	- mmap(), munmap()
+ * sys/stat.h	- fstat()
+ * unistd.h	- ftruncate(), close()
+ */
+
+#include "include/hash.h"
+#include "include/postdb.h"
+
+#define INITIAL_CAPACITY	64
+#define INITIAL_POOL		4096
+#define POOL_OFFSET(cap) \
+	(sizeof(struct postdb_header) + (size_t)(cap) * sizeof(struct postdb_record))
+
+
+/**** [START] Mapping ****/
+static int
+remap(struct postdb *db, size_t size)
+{
+	if (db->map != NULL)
+		munmap(db->map, db->map_size);
+	db->map = NULL;
+
+	if (db->writable && ftruncate(db->fd, size))
+		return 1;
+
+	db->map = mmap(NULL, size,
+			db->writable ? PROT_READ | PROT_WRITE : PROT_READ,
+			MAP_SHARED, db->fd, 0);
+	if (db->map == MAP_FAILED)
+	{
+		db->map = NULL;
+		return 1;
+	}
+	db->map_size = size;
+	db->header   = (struct postdb_header *)db->map;
+	db->records  = (struct postdb_record *)(db->map + sizeof(struct postdb_header));
+	db->pool     = db->map + POOL_OFFSET(db->header->capacity);
+	return 0;
+}
+
+static bool
+valid(const struct postdb *db)
+{
+	const struct postdb_header *h = db->header;
+	if (db->map_size < sizeof(struct postdb_header))
+		return false;
+	if (memcmp(h->magic, POSTDB_MAGIC, sizeof(h->magic)) || h->version != POSTDB_VERSION)
+		return false;
+	if (h->count > h->capacity)
+		return false;
+	return POOL_OFFSET(h->capacity) + h->pool_size <= db->map_size;
+}
+
+static int
+initialize(struct postdb *db)
+{
+	/*
+	 * remap() looks at header->capacity to find the pool, so the header
+	 * has to be written before the file is mapped at its full size.
+	 */
+	struct postdb_header header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, POSTDB_MAGIC, sizeof(header.magic));
+	header.version  = POSTDB_VERSION;
+	header.capacity = INITIAL_CAPACITY;
+
+	if (ftruncate(db->fd, 0) || pwrite(db->fd, &header, sizeof(header), 0) != sizeof(header))
+		return 1;
+	return remap(db, POOL_OFFSET(INITIAL_CAPACITY) + INITIAL_POOL);
+}
+/**** [END] Mapping ****/
+
+
+/**** [START] Name lookup ****/
+static void
+rehash(struct postdb *db)
+{
+	uint32_t nslots = 64;
+	while (nslots < 2 * db->header->capacity)
+		nslots *= 2;
+
+	free(db->slots);
+	db->slots  = calloc(nslots, sizeof(*db->slots));
+	db->nslots = nslots;
+
+	for (uint32_t i = 0; i < db->header->count; i++)
+	{
+		uint32_t h = hash_str(postdb_str(db, db->records[i].name)) & (nslots - 1);
+		while (db->slots[h] != 0)
+			h = (h + 1) & (nslots - 1);
+		db->slots[h] = i + 1;	// 0 marks an empty slot
+	}
+}
+
+struct postdb_record *
+postdb_find(struct postdb *db, const char *name)
+{
+	if (db->slots == NULL)
+		return NULL;
+
+	uint32_t h = hash_str(name) & (db->nslots - 1);
+	for (; db->slots[h] != 0; h = (h + 1) & (db->nslots - 1))
+	{
+		struct postdb_record *rec = &db->records[db->slots[h] - 1];
+		if (!strcmp(postdb_str(db, rec->name), name))
+			return rec;
+	}
+	return NULL;
+}
+/**** [END] Name lookup ****/
+
+
+int
+postdb_open(struct postdb *db, const char *path, bool writable)
+/*
+ * Maps the database at *path. If writable is true, the file is created (or
+ * started afresh, if it is unreadable or from another version) as needed.
+ *
+ * Returns 0 on success, 1 on error.
+ */
+{
+	struct stat st;
+
+	memset(db, 0, sizeof(*db));
+	db->writable = writable;
+	if ((db->fd = open(path, writable ? O_RDWR | O_CREAT : O_RDONLY, 0644)) == -1)
+		return 1;
+	if (fstat(db->fd, &st))
+		goto fail;
+
+	if (st.st_size >= (off_t)sizeof(struct postdb_header))
+	{
+		/* Map it as-is first, so we can validate it */
+		db->writable = false;
+		if (remap(db, st.st_size) == 0 && !valid(db))
+		{
+			munmap(db->map, db->map_size);
+			db->map = NULL;
+		}
+		db->writable = writable;
+		if (db->map != NULL && writable && remap(db, st.st_size))
+			goto fail;
+	}
+
+	if (db->map == NULL)
+		if (!writable || initialize(db))
+			goto fail;
+
+	if (writable)
+	{
+		rehash(db);
+		db->seen = calloc(db->header->capacity, 1);
+		for (uint32_t i = 0; i < db->header->count; i++)
+			if (db->records[i].search_id >= db->next_search_id)
+				db->next_search_id = db->records[i].search_id + 1;
+	}
+	return 0;
+
+fail:
+	if (db->map != NULL)
+		munmap(db->map, db->map_size);
+	close(db->fd);
+	db->map = NULL;
+	return 1;
+}
+
+const char *
+postdb_str(const struct postdb *db, uint32_t offset)
+{
+	return db->pool + offset;
+}
+
+
+/**** [START] Writing ****/
+static uint32_t
+pool_add(struct postdb *db, const char *s)
+{
+	size_t len  = strlen(s) + 1;
+	size_t need = POOL_OFFSET(db->header->capacity) + db->header->pool_size + len;
+
+	if (need > db->map_size)
+	{
+		size_t size = db->map_size * 2;
+		while (size < need)
+			size *= 2;
+		if (remap(db, size))
+		{
+			perror("postdb");
+			exit(1);
+		}
+	}
+
+	uint32_t offset = db->header->pool_size;
+	memcpy(db->pool + offset, s, len);
+	db->header->pool_size += len;
+	return offset;
+}
+
+static uint32_t
+pool_put(struct postdb *db, const struct postdb_record *old, size_t field, const char *s)
+/*
+ * Returns the offset of string *s, reusing the old record's string if it
+ * is unchanged. 'field' is the offsetof() the string in the record.
+ */
+{
+	if (old != NULL)
+	{
+		uint32_t offset = *(const uint32_t *)((const char *)old + field);
+		if (!strcmp(postdb_str(db, offset), s))
+			return offset;
+	}
+	return pool_add(db, s);
+}
+
+static void
+grow_records(struct postdb *db)
+{
+	/*
+	 * Double the number of record slots. This is the one operation that
+	 * has to move the pool, but it happens only O(log n) times.
+	 */
+	uint32_t capacity  = db->header->capacity;
+	uint32_t pool_size = db->header->pool_size;
+	size_t   pool_room = db->map_size - POOL_OFFSET(capacity);
+
+	if (remap(db, POOL_OFFSET(capacity * 2) + pool_room))
+	{
+		perror("postdb");
+		exit(1);
+	}
+	memmove(db->map + POOL_OFFSET(capacity * 2), db->map + POOL_OFFSET(capacity), pool_size);
+	db->header->capacity = capacity * 2;
+	db->pool = db->map + POOL_OFFSET(capacity * 2);
+
+	db->seen = realloc(db->seen, capacity * 2);
+	memset(db->seen + capacity, 0, capacity);
+	rehash(db);
+}
+
+static uint32_t
+number_of(const char *name)
+{
+	uint32_t number = 0;
+	for (; isdigit((unsigned char)*name); name++)
+		number = number * 10 + (*name - '0');
+	return number;
+}
+
+int
+postdb_put(struct postdb *db, const struct postdb_post *post)
+/*
+ * Adds or updates the record for post->name, in place.
+ */
+{
+	struct postdb_record *old;
+	struct postdb_record  rec;
+	uint32_t index;
+
+	if ((old = postdb_find(db, post->name)) != NULL)
+	{
+		index = old - db->records;
+		rec   = *old;
+	}
+	else
+	{
+		if (db->header->count == db->header->capacity)
+			grow_records(db);
+		index = db->header->count;
+		memset(&rec, 0, sizeof(rec));
+		rec.search_id = db->next_search_id++;
+	}
+
+	/*
+	 * pool_put() may remap, which would leave *old dangling. So, compare
+	 * against the copy in 'rec' instead.
+	 */
+	old = (old != NULL) ? &rec : NULL;
+	uint32_t name         = pool_put(db, old, offsetof(struct postdb_record, name),         post->name);
+	uint32_t title        = pool_put(db, old, offsetof(struct postdb_record, title),        post->title);
+	uint32_t tags         = pool_put(db, old, offsetof(struct postdb_record, tags),         post->tags);
+	uint32_t deps         = pool_put(db, old, offsetof(struct postdb_record, deps),         post->deps);
+
+	rec.name         = name;
+	rec.title        = title;
+	rec.tags         = tags;
+	rec.deps         = deps;
+	rec.mtime        = post->mtime;
+	rec.size         = post->size;
+	rec.number       = number_of(post->name);
+	rec.created      = post->created;
+	rec.modified     = post->modified;
+
+	db->records[index] = rec;
+	db->seen[index]    = 1;
+	if (index == db->header->count)
+	{
+		db->header->count++;
+		if (2 * db->header->count > db->nslots)
+			rehash(db);
+		else
+		{
+			uint32_t h = hash_str(post->name) & (db->nslots - 1);
+			while (db->slots[h] != 0)
+				h = (h + 1) & (db->nslots - 1);
+			db->slots[h] = index + 1;
+		}
+	}
+	return 0;
+}
+
+void
+postdb_keep(struct postdb *db, const struct postdb_record *rec)
+/*
+ * Marks a record as still alive without changing it.
+ */
+{
+	db->seen[rec - db->records] = 1;
+}
+
+static void
+prune(struct postdb *db)
+/*
+ * Drops the records of posts that weren't seen during this run (their
+ * sources were deleted), then compacts the pool if it's mostly garbage.
+ */
+{
+	struct postdb_header *h = db->header;
+	size_t live = 0;
+
+	for (uint32_t i = 0; i < h->count;)
+	{
+		if (db->seen[i])
+		{
+			const struct postdb_record *rec = &db->records[i++];
+			live += strlen(postdb_str(db, rec->name))        + 1;
+			live += strlen(postdb_str(db, rec->title))       + 1;
+			live += strlen(postdb_str(db, rec->tags))        + 1;
+			live += strlen(postdb_str(db, rec->deps))        + 1;
+			continue;
+		}
+		h->count--;
+		db->records[i] = db->records[h->count];
+		db->seen[i]    = db->seen[h->count];
+	}
+
+	if (h->pool_size <= 2 * live + INITIAL_POOL)
+		return;
+
+	char *pool = malloc(live);
+	size_t size = 0;
+	for (uint32_t i = 0; i < h->count; i++)
+	{
+		uint32_t *field[] = {
+			&db->records[i].name, &db->records[i].title, &db->records[i].tags,
+			&db->records[i].deps,
+		};
+		for (size_t j = 0; j < sizeof(field) / sizeof(field[0]); j++)
+		{
+			size_t len = strlen(postdb_str(db, *field[j])) + 1;
+			memcpy(pool + size, postdb_str(db, *field[j]), len);
+			*field[j] = size;
+			size += len;
+		}
+	}
+	memcpy(db->pool, pool, size);
+	h->pool_size = size;
+	free(pool);
+}
+
+void
+postdb_close(struct postdb *db)
+{
+	size_t size = 0;
+
+	if (db->map == NULL)
+		return;
+	if (db->writable)
+	{
+		prune(db);
+		size = POOL_OFFSET(db->header->capacity) + db->header->pool_size;
+	}
+	munmap(db->map, db->map_size);
+
+	/* Drop the slack that pool_add() keeps for appending */
+	if (db->writable && ftruncate(db->fd, size))
+		perror("postdb");
+	close(db->fd);
+
+	free(db->slots);
+	free(db->seen);
+	db->map = NULL;
+}
+/**** [END] Writing ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,61 @@
+#include <string.h>
+
+/*
+ * string.h	- memset()
+ */
+
+#include "include/radix.h"
+
+#define DIGIT_BITS	16
+#define BUCKETS		(1 << DIGIT_BITS)
+#define PASSES		(64 / DIGIT_BITS)
+
+struct radix_item *
+radix_sort(struct radix_item *items, struct radix_item *scratch, size_t n)
+/*
+ * Stable LSD radix sort on the 64-bit keys, 16 bits at a time.
+ *
+ * *scratch must have room for n items. The items bounce between the two
+ * arrays, so the sorted result may end up in either one; the returned
+ * pointer says which.
+ *
+ * Passes whose digit is the same for every key (eg. the top half of a
+ * packed YYYYMMDD key) are skipped, so sorting dates or post numbers only
+ * costs two passes over the data.
+ */
+{
+	static size_t count[BUCKETS];
+	struct radix_item *from = items;
+	struct radix_item *to   = scratch;
+
+	for (int pass = 0; pass < PASSES; pass++)
+	{
+		int shift = pass * DIGIT_BITS;
+
+		memset(count, 0, sizeof(count));
+		for (size_t i = 0; i < n; i++)
+			count[(from[i].key >> shift) & (BUCKETS - 1)]++;
+
+		if (n == 0 || count[(from[0].key >> shift) & (BUCKETS - 1)] == n)
+			continue;	// Every key has the same digit here
+
+		/* Turn the counts into starting positions */
+		size_t sum = 0;
+		for (size_t i = 0; i < BUCKETS; i++)
+		{
+			size_t c = count[i];
+			count[i] = sum;
+			sum += c;
+		}
+
+		for (size_t i = 0; i < n; i++)
+			to[count[(from[i].key >> shift) & (BUCKETS - 1)]++] = from[i];
+
+		struct radix_item *tmp = from;
+		from = to;
+		to   = tmp;
+	}
+	return from;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
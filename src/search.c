@@ -0,0 +1,166 @@
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/*
+ * ctype.h	- isalnum(), tolower()
+ * stdio.h	- fputs(), fputc()
+ * stdlib.h	- qsort()
+ * string.h	- str*(), mem*()
+ */
+
+#include "constants.h"
+#include "include/hash.h"
+#include "include/outfile.h"
+#include "include/search.h"
+
+/*
+ * A static full-text search index.
+ *
+ * While htmlize() renders a post, every character of prose it writes is fed
+ * to search_char(), which splits it into lowercase terms and keeps the set
+ * of distinct terms in the document's arena. blogify saves that set to a
+ * small per-post file in SEARCH_DIR, so posts that aren't re-rendered keep
+ * their terms.
+ *
+ * search_build() (run by index) then merges the per-post sets into
+ * inverted lists, and writes them into shards, one per SEARCH_PREFIX-byte
+ * term prefix -
+ *
+ *	varint	number of terms
+ *	for each term, in sorted order:
+ *		varint	bytes shared with the previous term
+ *		varint	length of the rest
+ *		bytes	the rest of the term
+ *		varint	number of posts
+ *		varint	post ids, each as the difference from the previous one
+ *
+ * along with docs.json, which maps post ids (see search_build()) to URLs
+ * and titles. A page script only has to fetch the shards for the terms
+ * being looked up.
+ */
+
+
+/**** [START] Tokenizing ****/
+struct search_doc *
+search_doc_new(struct arena *arena)
+{
+	struct search_doc *doc;
+	doc = arena_alloc(arena, sizeof(*doc));
+	doc->arena    = arena;
+	doc->len      = 0;
+	doc->overflow = false;
+	doc->count    = 0;
+	doc->nslots   = 256;
+	doc->slots    = arena_alloc(arena, doc->nslots * sizeof(*doc->slots));
+	memset(doc->slots, 0, doc->nslots * sizeof(*doc->slots));
+	return doc;
+}
+
+static void
+add_term(struct search_doc *doc, const char *term, size_t len)
+{
+	if (2 * (doc->count + 1) > doc->nslots)
+	{
+		/* Double the table; the old one is simply left in the arena */
+		size_t nslots = 2 * doc->nslots;
+		char **slots  = arena_alloc(doc->arena, nslots * sizeof(*slots));
+		memset(slots, 0, nslots * sizeof(*slots));
+		for (size_t i = 0; i < doc->nslots; i++)
+			if (doc->slots[i] != NULL)
+			{
+				size_t h = hash_str(doc->slots[i]) & (nslots - 1);
+				while (slots[h] != NULL)
+					h = (h + 1) & (nslots - 1);
+				slots[h] = doc->slots[i];
+			}
+		doc->slots  = slots;
+		doc->nslots = nslots;
+	}
+
+	size_t h = hash_bytes(term, len) & (doc->nslots - 1);
+	for (; doc->slots[h] != NULL; h = (h + 1) & (doc->nslots - 1))
+		if (!memcmp(doc->slots[h], term, len) && doc->slots[h][len] == '\0')
+			return;	// Already have it
+	doc->slots[h] = arena_strndup(doc->arena, term, len);
+	doc->count++;
+}
+
+void
+search_break(struct search_doc *doc)
+/*
+ * Ends the current word, if any
+ */
+{
+	if (doc->len >= SEARCH_MIN_TERM && !doc->overflow)
+		add_term(doc, doc->word, doc->len);
+	doc->len = 0;
+	doc->overflow = false;
+}
+
+void
+search_char(struct search_doc *doc, int c)
+/*
+ * Letters and digits make up words. Bytes of multi-byte UTF-8 sequences are
+ * kept as-is, so non-English words are indexed too (without case folding).
+ */
+{
+	unsigned char u = c;
+	if (!isalnum(u) && u < 0x80)
+	{
+		search_break(doc);
+		return;
+	}
+	if (doc->len == SEARCH_MAX_TERM)
+	{
+		doc->overflow = true;
+		return;
+	}
+	doc->word[doc->len++] = tolower(u);
+}
+
+void
+search_text(struct search_doc *doc, const char *s)
+{
+	for (; *s != '\0'; s++)
+		search_char(doc, *s);
+	search_break(doc);
+}
+
+static int
+compare_strings(const void *a, const void *b)
+{
+	return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+int
+search_doc_save(struct search_doc *doc, const char *path)
+/*
+ * Writes the document's terms, sorted, one per line
+ */
+{
+	struct outfile outfile;
+	FILE *out;
+	char **terms;
+	size_t n = 0;
+
+	search_break(doc);
+	terms = arena_alloc(doc->arena, (doc->count + 1) * sizeof(*terms));
+	for (size_t i = 0; i < doc->nslots; i++)
+		if (doc->slots[i] != NULL)
+			terms[n++] = doc->slots[i];
+	qsort(terms, n, sizeof(*terms), compare_strings);
+
+	if ((out = outfile_open(&outfile, path)) == NULL)
+		return 1;
+	for (size_t i = 0; i < n; i++)
+	{
+		fputs(terms[i], out);
+		fputc('\n', out);
+	}
+	return outfile_close(&outfile) == -1;
+}
+/**** [END] Tokenizing ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
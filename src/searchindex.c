@@ -0,0 +1,327 @@
+#define _XOPEN_SOURCE 700
+#include <dirent.h>
+#include <errno.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * dirent.h	- opendir(), readdir()
+ * errno.h	- EEXIST
+ * stdint.h	- uint32_t
+ * stdio.h	- fopen(), fgets(), fprintf()
+ * stdlib.h	- realloc(), qsort()
+ * string.h	- str*(), mem*()
+ * sys/stat.h	- mkdir()
+ * unistd.h	- unlink()
+ */
+
+#include "constants.h"
+#include "include/escape.h"
+#include "include/hash.h"
+#include "include/outfile.h"
+#include "include/radix.h"
+#include "include/search.h"
+#include "include/urlencode.h"
+
+/*
+ * Merges the per-post term sets that blogify saved (see search.c) into the
+ * sharded index described there.
+ */
+
+/**** [START] Building the index ****/
+struct term {
+	char		*term;
+	uint32_t	*posts;
+	uint32_t	 count;
+	uint32_t	 cap;
+};
+
+struct dictionary {
+	struct term	*terms;
+	size_t		 count;
+	size_t		 cap;
+	uint32_t	*slots;		/* Indices into terms, + 1 */
+	size_t		 nslots;
+};
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	if ((p = realloc(p, size)) == NULL)
+	{
+		fputs("search: out of memory\n", stderr);
+		exit(1);
+	}
+	return p;
+}
+
+static void
+dictionary_add(struct dictionary *dict, const char *word, uint32_t post)
+{
+	size_t h;
+
+	if (2 * (dict->count + 1) > dict->nslots)
+	{
+		dict->nslots = dict->nslots ? 2 * dict->nslots : 4096;
+		free(dict->slots);
+		dict->slots = calloc(dict->nslots, sizeof(*dict->slots));
+		for (size_t i = 0; i < dict->count; i++)
+		{
+			h = hash_str(dict->terms[i].term) & (dict->nslots - 1);
+			while (dict->slots[h] != 0)
+				h = (h + 1) & (dict->nslots - 1);
+			dict->slots[h] = i + 1;
+		}
+	}
+
+	struct term *term = NULL;
+	h = hash_str(word) & (dict->nslots - 1);
+	for (; dict->slots[h] != 0; h = (h + 1) & (dict->nslots - 1))
+		if (!strcmp(dict->terms[dict->slots[h] - 1].term, word))
+		{
+			term = &dict->terms[dict->slots[h] - 1];
+			break;
+		}
+
+	if (term == NULL)
+	{
+		if (dict->count == dict->cap)
+		{
+			dict->cap = dict->cap ? 2 * dict->cap : 4096;
+			dict->terms = xrealloc(dict->terms, dict->cap * sizeof(*dict->terms));
+		}
+		dict->slots[h] = dict->count + 1;
+		term = &dict->terms[dict->count++];
+		term->term  = strcpy(xrealloc(NULL, strlen(word) + 1), word);
+		term->posts = NULL;
+		term->count = term->cap = 0;
+	}
+
+	if (term->count == term->cap)
+	{
+		term->cap   = term->cap ? 2 * term->cap : 4;
+		term->posts = xrealloc(term->posts, term->cap * sizeof(*term->posts));
+	}
+	term->posts[term->count++] = post;
+}
+
+static int
+compare_terms(const void *a, const void *b)
+{
+	return strcmp(((const struct term *)a)->term, ((const struct term *)b)->term);
+}
+
+static void
+put_varint(FILE *out, uint32_t n)
+{
+	while (n >= 0x80)
+	{
+		fputc((n & 0x7F) | 0x80, out);
+		n >>= 7;
+	}
+	fputc(n, out);
+}
+
+static void
+shard_name(char *name, size_t size, const char *term)
+{
+	/* Hex, so that UTF-8 prefixes make safe file names */
+	size_t i = 0;
+	for (; i < SEARCH_PREFIX && term[i] != '\0'; i++)
+		snprintf(name + 2 * i, size - 2 * i, "%02x", (unsigned char)term[i]);
+	snprintf(name + 2 * i, size - 2 * i, ".bin");
+}
+
+static int
+write_shard(const char *dir, struct term *terms, size_t count, int *written)
+{
+	struct outfile outfile;
+	FILE *out;
+	char name[2 * SEARCH_PREFIX + 8];
+	char path[FILENAME_MAX];
+
+	shard_name(name, sizeof(name), terms[0].term);
+	snprintf(path, sizeof(path), "%s/%s", dir, name);
+	if ((out = outfile_open(&outfile, path)) == NULL)
+		return 1;
+
+	put_varint(out, count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const char *prev = i > 0 ? terms[i - 1].term : "";
+		const char *term = terms[i].term;
+		size_t shared = 0;
+		while (prev[shared] != '\0' && prev[shared] == term[shared])
+			shared++;
+
+		put_varint(out, shared);
+		put_varint(out, strlen(term) - shared);
+		fputs(term + shared, out);
+
+		put_varint(out, terms[i].count);
+		for (uint32_t j = 0; j < terms[i].count; j++)
+			put_varint(out, terms[i].posts[j] - (j > 0 ? terms[i].posts[j - 1] : 0));
+	}
+
+	int retval = outfile_close(&outfile);
+	if (retval == 1)
+		(*written)++;
+	return retval == -1;
+}
+
+static int
+write_docs(const struct postdb *db, const struct radix_item *posts, size_t count, const char *dir)
+{
+	struct outfile outfile;
+	FILE *out;
+	char path[FILENAME_MAX];
+
+	snprintf(path, sizeof(path), "%s/docs.json", dir);
+	if ((out = outfile_open(&outfile, path)) == NULL)
+		return 1;
+
+	/* Indexed by id, with nulls for the ids of posts that are gone */
+	uint32_t id = 0;
+	fputc('[', out);
+	for (size_t i = 0; i < count; i++, id++)
+	{
+		const struct postdb_record *rec = &db->records[posts[i].value];
+		for (; id < rec->search_id; id++)
+			fputs(id > 0 ? ",null" : "null", out);
+		fputs(id > 0 ? ",[\"" : "[\"", out);
+		fputs_urlencoded(postdb_str(db, rec->name), out);
+		fputs("\",\"", out);
+		fputs_json_escaped(postdb_str(db, rec->title), out);
+		fputs("\"]", out);
+	}
+	fputs("]\n", out);
+	return outfile_close(&outfile) == -1;
+}
+
+static void
+remove_stale(const char *dir, const struct term *terms, size_t count)
+/*
+ * Deletes shards whose prefix no longer has any terms
+ */
+{
+	DIR *d;
+	struct dirent *dirent;
+	char name[2 * SEARCH_PREFIX + 8];
+	char path[FILENAME_MAX * 2];
+
+	if ((d = opendir(dir)) == NULL)
+		return;
+	while ((dirent = readdir(d)) != NULL)
+	{
+		const char *ext = strrchr(dirent->d_name, '.');
+		if (ext == NULL || strcmp(ext, ".bin"))
+			continue;
+
+		/* Binary search for the first term that would be in this shard */
+		size_t lo = 0, hi = count;
+		while (lo < hi)
+		{
+			size_t mid = (lo + hi) / 2;
+			shard_name(name, sizeof(name), terms[mid].term);
+			if (strcmp(name, dirent->d_name) < 0)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo < count)
+		{
+			shard_name(name, sizeof(name), terms[lo].term);
+			if (!strcmp(name, dirent->d_name))
+				continue;
+		}
+		snprintf(path, sizeof(path), "%s/%s", dir, dirent->d_name);
+		unlink(path);
+	}
+	closedir(d);
+}
+
+int
+search_build(const struct postdb *db, const char *terms_dir, const char *out_dir)
+/*
+ * Posts are numbered by their search_id, which posts.db gives each post
+ * once, when it first appears. So adding or deleting a post doesn't
+ * renumber the others, and only the shards of its terms change.
+ */
+{
+	struct dictionary dict = { 0 };
+	struct radix_item *items, *scratch, *posts;
+	size_t count = 0;
+	int retval = 0, written = 0;
+
+	if (mkdir(out_dir, 0755) && errno != EEXIST)
+	{
+		fprintf(stderr, "search: cannot create directory: %s\n", out_dir);
+		return 1;
+	}
+
+	items   = xrealloc(NULL, (db->header->count + 1) * sizeof(*items));
+	scratch = xrealloc(NULL, (db->header->count + 1) * sizeof(*scratch));
+	for (uint32_t i = 0; i < db->header->count; i++)
+	{
+		const char *name = postdb_str(db, db->records[i].name);
+		if (name[0] == '.' || name[0] == '0')
+			continue;
+		items[count].key   = db->records[i].search_id;
+		items[count].value = i;
+		count++;
+	}
+	posts = radix_sort(items, scratch, count);
+
+	for (size_t i = 0; i < count; i++)
+	{
+		char path[FILENAME_MAX * 2];
+		char word[SEARCH_MAX_TERM + 2];
+		FILE *fp;
+
+		snprintf(path, sizeof(path), "%s/%s.terms", terms_dir,
+				postdb_str(db, db->records[posts[i].value].name));
+		if ((fp = fopen(path, "r")) == NULL)
+			continue;
+		while (fgets(word, sizeof(word), fp) != NULL)
+		{
+			word[strcspn(word, "\n")] = '\0';
+			if (*word != '\0')
+				dictionary_add(&dict, word, db->records[posts[i].value].search_id);
+		}
+		fclose(fp);
+	}
+
+	/* Sorting puts every shard's terms next to each other */
+	qsort(dict.terms, dict.count, sizeof(*dict.terms), compare_terms);
+	for (size_t start = 0, end; start < dict.count; start = end)
+	{
+		for (end = start + 1; end < dict.count; end++)
+			if (strncmp(dict.terms[start].term, dict.terms[end].term, SEARCH_PREFIX))
+				break;
+		retval |= write_shard(out_dir, &dict.terms[start], end - start, &written);
+	}
+	retval |= write_docs(db, posts, count, out_dir);
+	remove_stale(out_dir, dict.terms, dict.count);
+
+#ifdef PRINT_FILENAMES
+	printf("%s: %zu terms, %d shards rewritten\n", out_dir, dict.count, written);
+#endif /* PRINT_FILENAMES */
+
+	for (size_t i = 0; i < dict.count; i++)
+	{
+		free(dict.terms[i].term);
+		free(dict.terms[i].posts);
+	}
+	free(dict.terms);
+	free(dict.slots);
+	free(items);
+	free(scratch);
+	return retval;
+}
+/**** [END] Building the index ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
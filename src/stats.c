@@ -0,0 +1,116 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/*
+ * stdio.h		- fprintf()
+ * sys/resource.h	- getrusage()
+ * time.h		- clock_gettime()
+ */
+
+#include "include/stats.h"
+
+struct stats STATS;
+
+static const char *const HANDLERS[STAT_HANDLERS] = {
+	"CODEBLOCK", "FOOTNOTES", "LISTS", "INCLUDE", "CSV_TABLE",
+	"TABLE", "LINKDEF", "HEADINGS", "CHARREFS", "HTML_TAGS",
+	"CODE", "BOLD", "ITALIC", "LINKS", "FOOTNOTE",
+	"TABLEROW", "DUALSPACEBREAK",
+};
+
+static const char *const PHASES[STAT_PHASES] = {
+	"setup", "scan", "render", "write", "save",
+};
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+void
+stats_phase(enum stat_phase phase)
+/*
+ * Stops the clock for the current phase, and starts it for this one. The
+ * first call starts the clock for STAT_SETUP.
+ */
+{
+	double t = now();
+	if (STATS.since != 0)
+		STATS.seconds[STATS.phase] += t - STATS.since;
+	STATS.phase = phase;
+	STATS.since = t;
+}
+
+static void
+print_table(const struct arena *arena, const struct rusage *usage, FILE *out)
+{
+	fprintf(out, "bytes in:       %llu\n", STATS.bytes_in);
+	fprintf(out, "bytes out:      %llu\n", STATS.bytes_out);
+	fprintf(out, "lines:          %llu\n", STATS.lines);
+	fprintf(out, "get_next_line:  %llu\n", STATS.next_line);
+	fprintf(out, "files written:  %llu\n", STATS.written);
+	fprintf(out, "files kept:     %llu\n", STATS.unchanged);
+	if (arena != NULL)
+	{
+		fprintf(out, "documents:      %lu\n", arena->resets);
+		fprintf(out, "arena allocs:   %lu\n", arena->allocs);
+		fprintf(out, "arena mallocs:  %lu\n", arena->mallocs);
+		fprintf(out, "arena peak:     %zu bytes\n", arena->peak);
+		fprintf(out, "arena held:     %zu bytes\n", arena->held);
+	}
+	fprintf(out, "peak RSS:       %ld KiB\n", usage->ru_maxrss);
+
+	fprintf(out, "\n%-16s %14s %14s %7s\n", "handler", "calls", "hits", "hit %");
+	for (int i = 0; i < STAT_HANDLERS; i++)
+		fprintf(out, "%-16s %14llu %14llu %6.2f%%\n", HANDLERS[i], STATS.calls[i], STATS.hits[i],
+				STATS.calls[i] ? 100.0 * STATS.hits[i] / STATS.calls[i] : 0);
+
+	fprintf(out, "\n%-16s %14s\n", "phase", "seconds");
+	for (int i = 0; i < STAT_PHASES; i++)
+		fprintf(out, "%-16s %14.6f\n", PHASES[i], STATS.seconds[i]);
+}
+
+static void
+print_json(const struct arena *arena, const struct rusage *usage, FILE *out)
+{
+	fprintf(out, "{\n\t\"bytes_in\": %llu,\n\t\"bytes_out\": %llu,\n", STATS.bytes_in, STATS.bytes_out);
+	fprintf(out, "\t\"lines\": %llu,\n\t\"get_next_line\": %llu,\n", STATS.lines, STATS.next_line);
+	fprintf(out, "\t\"files_written\": %llu,\n\t\"files_kept\": %llu,\n", STATS.written, STATS.unchanged);
+	if (arena != NULL)
+		fprintf(out, "\t\"arena\": { \"documents\": %lu, \"allocs\": %lu, \"mallocs\": %lu, "
+				"\"peak\": %zu, \"held\": %zu },\n",
+				arena->resets, arena->allocs, arena->mallocs, arena->peak, arena->held);
+	fprintf(out, "\t\"peak_rss_kib\": %ld,\n", usage->ru_maxrss);
+
+	fputs("\t\"handlers\": {\n", out);
+	for (int i = 0; i < STAT_HANDLERS; i++)
+		fprintf(out, "\t\t\"%s\": { \"calls\": %llu, \"hits\": %llu }%s\n", HANDLERS[i],
+				STATS.calls[i], STATS.hits[i], i + 1 < STAT_HANDLERS ? "," : "");
+	fputs("\t},\n\t\"seconds\": {\n", out);
+	for (int i = 0; i < STAT_PHASES; i++)
+		fprintf(out, "\t\t\"%s\": %.6f%s\n", PHASES[i], STATS.seconds[i], i + 1 < STAT_PHASES ? "," : "");
+	fputs("\t}\n}\n", out);
+}
+
+void
+stats_print(const struct arena *arena, FILE *out, int format)
+/*
+ * The arena is the one the documents were rendered in, if any
+ */
+{
+	struct rusage usage;
+
+	stats_phase(STATS.phase);	// Count the time up to now
+	getrusage(RUSAGE_SELF, &usage);
+	if (format == STATS_JSON)
+		print_json(arena, &usage, out);
+	else
+		print_table(arena, &usage, out);
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
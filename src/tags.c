@@ -0,0 +1,100 @@
+#include <ctype.h>
+#include <string.h>
+
+/*
+ * ctype.h	- isalnum(), isspace(), tolower()
+ * string.h	- memcpy(), strcspn()
+ */
+
+#include "include/tags.h"
+
+/*
+ * Tags are kept as a single comma-separated string, eg. "c,unix,shell", both
+ * in the post database and in the generated HTML header comment.
+ */
+
+size_t
+tags_normalize(const char *line, char *tags, size_t size)
+/*
+ * Turns the value of a "tags:" header line (eg. " C, unix ,, shell\n") into
+ * the canonical form ("C,unix,shell"). Returns the length of the result.
+ */
+{
+	size_t len = 0;
+	tags[0] = '\0';
+
+	while (*line != '\0')
+	{
+		size_t n = strcspn(line, ",\n");
+		const char *end = line + n;
+		const char *start = line;
+
+		while (start < end && isspace((unsigned char)*start))
+			start++;
+		while (end > start && isspace((unsigned char)end[-1]))
+			end--;
+
+		if (end > start && len + (end - start) + 2 <= size)
+		{
+			if (len > 0)
+				tags[len++] = ',';
+			memcpy(tags + len, start, end - start);
+			len += end - start;
+			tags[len] = '\0';
+		}
+
+		line += n;
+		if (*line != '\0')
+			line++;
+	}
+	return len;
+}
+
+int
+tags_next(const char **list, char *tag, size_t size)
+/*
+ * Copies the next tag of a canonical tag list into *tag and advances *list
+ * past it. Returns 0 once there are no more tags.
+ */
+{
+	const char *p = *list;
+	size_t n;
+
+	if (*p == '\0')
+		return 0;
+
+	n = strcspn(p, ",");
+	if (n >= size)
+		n = size - 1;
+	memcpy(tag, p, n);
+	tag[n] = '\0';
+
+	p += strcspn(p, ",");
+	*list = (*p == ',') ? p + 1 : p;
+	return 1;
+}
+
+void
+tag_slug(const char *tag, char *slug, size_t size)
+/*
+ * The file name (without extension) of a tag's archive page.
+ *	- Letters and digits are lowercased
+ *	- Non-ASCII bytes (ie. UTF-8) are kept as-is
+ *	- Runs of anything else become a single '-'
+ */
+{
+	size_t i = 0;
+	for (; *tag != '\0' && i + 1 < size; tag++)
+	{
+		unsigned char c = *tag;
+		if (isalnum(c) || c >= 0x80)
+			slug[i++] = tolower(c);
+		else if (i > 0 && slug[i - 1] != '-')
+			slug[i++] = '-';
+	}
+	while (i > 0 && slug[i - 1] == '-')
+		i--;
+	slug[i] = '\0';
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
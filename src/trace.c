@@ -0,0 +1,143 @@
+#define _XOPEN_SOURCE 700
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * stdio.h		- fopen(), fprintf()
+ * stdlib.h		- realloc(), free(), atexit()
+ * string.h		- strdup()
+ * sys/resource.h	- getrusage(), for the peak RSS
+ * time.h		- clock_gettime()
+ * unistd.h		- getpid()
+ */
+
+#include "include/escape.h"
+#include "include/trace.h"
+
+struct event {
+	const char	*name;
+	char		*file;		/* NULL if none */
+	double		 ts;		/* Microseconds */
+	double		 dur;
+	long long	 bytes;		/* -1 if none */
+	long		 maxrss;	/* KiB, at the end of the span */
+};
+
+static struct {
+	FILE		*out;		/* NULL if not recording */
+	const char	*path;
+	const char	*program;
+	struct event	*events;
+	size_t		 count;
+	size_t		 cap;
+} TRACE;
+
+
+static double
+now(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e6 + ts.tv_nsec / 1e3;
+}
+
+static void
+trace_write(void)
+/*
+ * Runs at exit. The programs are single-threaded, so every event has the
+ * process id as its thread id.
+ */
+{
+	FILE *out = TRACE.out;
+	long pid = (long)getpid();
+
+	fprintf(out, "{\"traceEvents\":[\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%ld,\"tid\":%ld,"
+			"\"args\":{\"name\":\"", pid, pid);
+	fputs_json_escaped(TRACE.program, out);
+	fputs("\"}}", out);
+
+	for (size_t i = 0; i < TRACE.count; i++)
+	{
+		const struct event *e = &TRACE.events[i];
+		fprintf(out, ",\n{\"name\":\"%s\",\"cat\":\"build\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,"
+				"\"pid\":%ld,\"tid\":%ld,\"args\":{\"maxrss_kib\":%ld",
+				e->name, e->ts, e->dur, pid, pid, e->maxrss);
+		if (e->bytes >= 0)
+			fprintf(out, ",\"bytes\":%lld", e->bytes);
+		if (e->file != NULL)
+		{
+			fputs(",\"file\":\"", out);
+			fputs_json_escaped(e->file, out);
+			fputc('"', out);
+		}
+		fputs("}}", out);
+		free(e->file);
+	}
+	fputs("\n],\"displayTimeUnit\":\"ms\"}\n", out);
+
+	if (ferror(out) | fclose(out))
+		fprintf(stderr, "%s: cannot write trace: %s\n", TRACE.program, TRACE.path);
+	free(TRACE.events);
+	TRACE.out = NULL;
+}
+
+int
+trace_open(const char *path, const char *program)
+/*
+ * Starts recording, for the trace to be written to *path at exit. *path and
+ * *program (the name it shows up under) must stay valid until then.
+ */
+{
+	if ((TRACE.out = fopen(path, "w")) == NULL)
+		return 1;
+	TRACE.path    = path;
+	TRACE.program = program;
+	return atexit(trace_write);
+}
+
+double
+trace_start(void)
+/*
+ * When a span starts, or 0 if we aren't recording
+ */
+{
+	return TRACE.out == NULL ? 0 : now();
+}
+
+void
+trace_span(const char *name, const char *file, double start, long long bytes)
+/*
+ * Records a span from start until now. *name must be a string literal (it is
+ * kept as is, and not escaped); file may be NULL, and bytes -1, if they
+ * don't apply. A span that can't be kept is dropped, rather than failing
+ * the build.
+ */
+{
+	struct rusage usage;
+	struct event *e;
+
+	if (TRACE.out == NULL)
+		return;
+	if (TRACE.count == TRACE.cap)
+	{
+		size_t cap = TRACE.cap ? 2 * TRACE.cap : 1024;
+		if ((e = realloc(TRACE.events, cap * sizeof(*e))) == NULL)
+			return;
+		TRACE.events = e;
+		TRACE.cap    = cap;
+	}
+
+	e = &TRACE.events[TRACE.count++];
+	e->name   = name;
+	e->file   = file == NULL ? NULL : strdup(file);
+	e->ts     = start;
+	e->dur    = now() - start;
+	e->bytes  = bytes;
+	e->maxrss = getrusage(RUSAGE_SELF, &usage) ? 0 : usage.ru_maxrss;
+}
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,289 @@
+#define _XOPEN_SOURCE 700
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/*
+ * fcntl.h	- open()
+ * stdbool.h	- bool, true, false
+ * stdint.h	- int64_t
+ * stdio.h	- fmemopen(), open_memstream(), getline(), snprintf()
+ * stdlib.h	- calloc(), malloc(), free(), strtoll()
+ * string.h	- str*(), mem*()
+ * sys/mman.h	- mmap(), munmap()
+ * sys/stat.h	- stat(), fstat()
+ * unistd.h	- close()
+ */
+
+#include "constants.h"
+#include "include/arena.h"
+#include "include/hash.h"
+#include "include/highlight.h"
+#include "include/htmlize.h"
+#include "include/transclude.h"
+
+#define MTIME_NS(st) \
+	((int64_t)(st).st_mtim.tv_sec * 1000000000 + (st).st_mtim.tv_nsec)
+
+/* Every fragment rendered so far, by path and lines */
+#define FRAGMENT_BUCKETS 256
+static struct fragment *FRAGMENTS[FRAGMENT_BUCKETS];
+
+
+/**** [START] Rendering ****/
+static void
+print_code(const char *path, FILE *in, FILE *out)
+/*
+ * The way CODEBLOCK does ```lang, with the language taken from the extension
+ */
+{
+	struct highlight highlight;
+	const char *ext = strrchr(path, '.'), *lang = NULL;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+
+	if (ext != NULL && strchr(ext, '/') == NULL)
+		lang = highlight_start(&highlight, ext + 1, strlen(ext + 1));
+	else
+		highlight_start(&highlight, "", 0);
+	if (lang != NULL)
+		fprintf(out, "<pre class=\"lang-%s\">\n", lang);
+	else
+		fputs("<pre>\n", out);
+
+	bool newline = true;
+	while (in != NULL && (len = getline(&line, &size, in)) != -1)
+	{
+		highlight_line(&highlight, line, out);
+		newline = line[len - 1] == '\n';
+	}
+	free(line);
+	fputs(newline ? "</pre>\n" : "\n</pre>\n", out);
+}
+
+static int
+render(struct fragment *f, struct doc *doc)
+{
+	struct stat st;
+	char *map = NULL, *html = NULL;
+	size_t size = 0, len = 0;
+	int fd;
+
+	if ((fd = open(f->path, O_RDONLY)) == -1)
+		return 1;
+	if (fstat(fd, &st))
+	{
+		close(fd);
+		return 1;
+	}
+	size = st.st_size;
+	if (size > 0 && (map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0)) == MAP_FAILED)
+	{
+		close(fd);
+		return 1;
+	}
+	close(fd);
+
+	/* Only the lines that were asked for */
+	const char *start = map, *end = map + size, *nl;
+	for (unsigned line = 1; line < f->first && start < end; line++)
+		start = (nl = memchr(start, '\n', end - start)) != NULL ? nl + 1 : end;
+	if (f->last != 0)
+	{
+		const char *stop = start;
+		for (unsigned line = f->first ? f->first : 1; line <= f->last && stop < end; line++)
+			stop = (nl = memchr(stop, '\n', end - stop)) != NULL ? nl + 1 : end;
+		end = stop;
+	}
+
+	FILE *in  = start < end ? fmemopen((void *)start, end - start, "r") : NULL;
+	FILE *out = open_memstream(&html, &len);
+	if (out == NULL || (start < end && in == NULL))
+	{
+		if (in != NULL)
+			fclose(in);
+		if (out != NULL)
+			fclose(out);
+		free(html);
+		if (map != NULL)
+			munmap(map, size);
+		return 1;
+	}
+
+	/*
+	 * What it reads in turn is its own, and then the post's too. What is
+	 * only the post's (see print_fragment()) is left out.
+	 */
+	struct dep *outer = doc->deps;
+	bool outer_fragment = doc->fragment;
+	doc->deps     = NULL;
+	doc->fragment = true;
+	if (!f->markup)
+		print_code(f->path, in, out);
+	else if (in != NULL)
+		htmlize(in, out, doc);
+	for (const struct dep *dep = doc->deps; dep != NULL; dep = dep->next)
+		f->ndeps++;
+	if (f->ndeps > 0 && (f->deps = malloc(f->ndeps * sizeof(*f->deps))) != NULL)
+	{
+		size_t i = 0;
+		for (const struct dep *dep = doc->deps; dep != NULL; dep = dep->next)
+			f->deps[i++] = strdup(dep->path);
+	}
+	else
+		f->ndeps = 0;
+	doc->deps     = outer;
+	doc->fragment = outer_fragment;
+
+	if (in != NULL)
+		fclose(in);
+	fclose(out);
+	if (map != NULL)
+		munmap(map, size);
+	f->html = html;
+	f->len  = len;
+	return 0;
+}
+/**** [END] Rendering ****/
+
+
+const struct fragment *
+fragment_get(struct doc *doc, const char *path, unsigned first, unsigned last, bool *cached)
+/*
+ * Lines first to last of *path, rendered. Returns NULL if it can't be read,
+ * or if it includes itself. *cached is true if it had already been rendered
+ * (for another post, or earlier in this one), in which case what rendering
+ * it would have told *doc (its search terms, its links) is the caller's to
+ * tell it.
+ */
+{
+	uint64_t h = (hash_str(path) ^ (uint64_t)first << 32 ^ last) & (FRAGMENT_BUCKETS - 1);
+	struct fragment *f;
+
+	deps_add(doc, path);
+	for (f = FRAGMENTS[h]; f != NULL; f = f->next)
+		if (f->first == first && f->last == last && !strcmp(f->path, path))
+			break;
+
+	if ((*cached = f != NULL) == false)
+	{
+		const char *ext = strrchr(path, '.');
+		if ((f = calloc(1, sizeof(*f))) == NULL || (f->path = strdup(path)) == NULL)
+		{
+			free(f);
+			return NULL;
+		}
+		f->first  = first;
+		f->last   = last;
+		f->markup = ext != NULL && !strcmp(ext, SOURCE_EXT);
+		f->next   = FRAGMENTS[h];
+		FRAGMENTS[h] = f;
+		render(f, doc);	// f->html stays NULL if it fails
+	}
+	for (size_t i = 0; i < f->ndeps; i++)
+		if (f->deps[i] != NULL)
+			deps_add(doc, f->deps[i]);
+	return f->html != NULL ? f : NULL;
+}
+
+void
+fragments_free(void)
+{
+	for (size_t h = 0; h < FRAGMENT_BUCKETS; h++)
+		while (FRAGMENTS[h] != NULL)
+		{
+			struct fragment *f = FRAGMENTS[h];
+			FRAGMENTS[h] = f->next;
+			for (size_t i = 0; i < f->ndeps; i++)
+				free(f->deps[i]);
+			free(f->deps);
+			free(f->html);
+			free(f->path);
+			free(f);
+		}
+}
+
+
+/**** [START] Dependencies ****/
+void
+deps_add(struct doc *doc, const char *path)
+/*
+ * Notes that the document was rendered from *path (too)
+ */
+{
+	struct dep *dep;
+	struct stat st;
+
+	for (dep = doc->deps; dep != NULL; dep = dep->next)
+		if (!strcmp(dep->path, path))
+			return;
+
+	dep = arena_alloc(doc->arena, sizeof(*dep));
+	dep->path  = arena_strndup(doc->arena, path, strlen(path));
+	if (stat(path, &st))
+	{
+		dep->mtime = 0;
+		dep->size  = -1;
+	}
+	else
+	{
+		dep->mtime = MTIME_NS(st);
+		dep->size  = st.st_size;
+	}
+	dep->next  = doc->deps;
+	doc->deps  = dep;
+}
+
+char *
+deps_list(const struct doc *doc)
+/*
+ * The "mtime size path\n" lines for the post database, in the arena
+ */
+{
+	size_t len = 1;
+	for (const struct dep *dep = doc->deps; dep != NULL; dep = dep->next)
+		len += snprintf(NULL, 0, "%lld %lld %s\n", (long long)dep->mtime, (long long)dep->size, dep->path);
+
+	char *list = arena_alloc(doc->arena, len), *p = list;
+	*p = '\0';
+	for (const struct dep *dep = doc->deps; dep != NULL; dep = dep->next)
+		p += sprintf(p, "%lld %lld %s\n", (long long)dep->mtime, (long long)dep->size, dep->path);
+	return list;
+}
+
+bool
+deps_fresh(const char *list)
+/*
+ * Whether every file in a deps_list() is still as it was
+ */
+{
+	char path[FILENAME_MAX];
+	struct stat st;
+
+	while (*list != '\0')
+	{
+		char *end;
+		long long mtime = strtoll(list, &end, 10);
+		long long size  = strtoll(end, &end, 10);
+		size_t len;
+
+		if (*end++ != ' ' || (len = strcspn(end, "\n")) >= sizeof(path))
+			return false;
+		memcpy(path, end, len);
+		path[len] = '\0';
+		if (stat(path, &st) ? size != -1 : (MTIME_NS(st) != mtime || st.st_size != size))
+			return false;
+		list = end + len + (end[len] == '\n');
+	}
+	return true;
+}
+/**** [END] Dependencies ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -1,41 +1,49 @@
-#include <ctype.h>
 #include <stdio.h>
-#include <string.h>
 #include "include/urlencode.h"
 
 /*
- * ctype.h  - isalnum
- * stdio.h  - sprintf
- * string.h - memmove
+ * stdio.h  - FILE, fwrite(), fputc()
  */
 
+/*
+ * Characters that go into a URL as they are (RFC 3986's unreserved ones).
+ * Everything else, including every byte of a UTF-8 sequence, becomes %XX.
+ */
+static const char UNRESERVED[256] = {
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x00 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,	/* 0x10 */
+	0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 0,	/* 0x20  - . */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,	/* 0x30  0-9 */
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x40  A-O */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 1,	/* 0x50  P-Z _ */
+	0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,	/* 0x60  a-o */
+	1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 1, 0,	/* 0x70  p-z ~ */
+	/* 0x80 - 0xFF are all 0 */
+};
+
+static const char HEX[] = "0123456789ABCDEF";
+
 char *
 urlencode_c(const char c, char *str_size_4)
 {
-	/* unreserved */
-	if (isalnum(c))
+	unsigned char u = (unsigned char)c;
+
+	if (UNRESERVED[u])
 	{
-		sprintf(str_size_4, "%c", c);
-		return str_size_4;
+		str_size_4[0] = c;
+		str_size_4[1] = '\0';
 	}
-	switch (c)
+	else
 	{
-		case '-':
-		case '.':
-		case '_':
-		case '~':
-			sprintf(str_size_4, "%c", c);
-			return str_size_4;
-		default:
-			break;
+		str_size_4[0] = '%';
+		str_size_4[1] = HEX[u >> 4];
+		str_size_4[2] = HEX[u & 0xF];
+		str_size_4[3] = '\0';
 	}
-
-	/* reserved */
-	sprintf(str_size_4, "%%%0X", c);
 	return str_size_4;
 }
 
-char *
+size_t
 urlencode_s(const char *str, char *storage, size_t len)
 {
 	/*
@@ -43,31 +51,65 @@ urlencode_s(const char *str, char *storage, size_t len)
 	 * const char *storage	Pointer to string for storing the result
 	 * size_t len		Size of the array pointed by *storage
 	 *
-	 * Takes char array *str and stores the result to char array *storage.
-	 * Returns the same pointer as *storage for convenience.
+	 * Takes char array *str and stores the result to char array *storage,
+	 * in one pass. Returns the length of the result (without the '\0').
 	 *
 	 * Array size of *storage should ideally be 1 + (3 * (size of *str)),
 	 * because, say _every_ character of *str needs to be converted into
 	 * the "%XX" format.That means, every character will become 3
 	 * characters. So, the string length shall triple. And since we need to
 	 * add the trailing '\0', we need an extra character.
+	 *
+	 * If it is smaller, the result is cut short, but never in the middle of
+	 * a "%XX".
 	 */
+	size_t n = 0;
 
-	/* explicit_bzero(storage) */
-	for (int i=0; i<len; i++)
-		storage[i] = '\0';
-
-	char buffer[4];
-	char *pointer;
-	pointer = storage;
-	for (int i=0; str[i]!='\0' && strlen(storage)<=len; i++)
+	if (len == 0)
+		return 0;
+	for (const unsigned char *s = (const unsigned char *)str; *s != '\0'; s++)
 	{
-		urlencode_c(str[i], buffer);
-		if (strlen(storage) + strlen(buffer) > len) break;
-		memmove(pointer, buffer, strlen(buffer));
-		pointer += strlen(buffer);
+		if (UNRESERVED[*s])
+		{
+			if (n + 1 >= len)
+				break;
+			storage[n++] = *s;
+		}
+		else
+		{
+			if (n + 3 >= len)
+				break;
+			storage[n++] = '%';
+			storage[n++] = HEX[*s >> 4];
+			storage[n++] = HEX[*s & 0xF];
+		}
 	}
-	return storage;
+	storage[n] = '\0';
+	return n;
 }
 
+void
+fputs_urlencoded(const char *str, FILE *stream)
+/*
+ * Writes *str to stream the way urlencode_s() would encode it, without a
+ * buffer to size. The runs of unreserved characters go out in one fwrite().
+ */
+{
+	const unsigned char *s = (const unsigned char *)str, *run;
+
+	while (*s != '\0')
+	{
+		for (run = s; UNRESERVED[*s]; s++)
+			;
+		if (s > run)
+			fwrite(run, 1, s - run, stream);
+		for (; *s != '\0' && !UNRESERVED[*s]; s++)
+		{
+			fputc('%', stream);
+			fputc(HEX[*s >> 4], stream);
+			fputc(HEX[*s & 0xF], stream);
+		}
+	}
+}
 
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax
@@ -0,0 +1,354 @@
+#define _XOPEN_SOURCE 700
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+/*
+ * stdbool.h	- bool, true, false
+ * stdint.h	- uint64_t
+ * stdio.h	- fopen(), fscanf(), fprintf()
+ * stdlib.h	- realloc(), free(), qsort(), bsearch()
+ * string.h	- str*(), mem*()
+ * sys/stat.h	- stat()
+ * zlib.h	- deflate()
+ */
+
+#include "constants.h"
+#include "include/weight.h"
+
+static const struct {
+	const char	*name;
+	uint64_t	 max;
+} BUDGETS[] = {
+	{ "html_gz",  BUDGET_HTML_GZ  },
+	{ "total",    BUDGET_TOTAL    },
+	{ "requests", BUDGET_REQUESTS },
+};
+#define NBUDGETS (sizeof(BUDGETS) / sizeof(*BUDGETS))
+
+static uint64_t
+total(const struct weight *w)
+/*
+ * Bytes transferred, all told
+ */
+{
+	return w->html_gz + w->css + w->fonts + w->images + w->favicon;
+}
+
+static uint64_t
+measure(const struct weight *w, size_t i)
+/*
+ * What BUDGETS[i] is a budget for
+ */
+{
+	switch (i)
+	{
+		case 0:  return w->html_gz;
+		case 1:  return total(w);
+		default: return w->requests;
+	}
+}
+
+static void *
+xrealloc(void *p, size_t size)
+{
+	if ((p = realloc(p, size)) == NULL)
+	{
+		fputs("weight: out of memory\n", stderr);
+		exit(1);
+	}
+	return p;
+}
+
+
+/**** [START] Measuring ****/
+static uint64_t
+asset_size(const char *url, size_t len)
+/*
+ * Local URLs are relative to the pages, in DEST_DIR
+ */
+{
+	char path[2 * FILENAME_MAX];
+	struct stat st;
+
+	if (memchr(url, ':', len) != NULL || *url == '/')
+		return 0;	// Not ours, so no telling
+	snprintf(path, sizeof(path), "%s/%.*s", DEST_DIR, (int)len, url);
+	return stat(path, &st) ? 0 : (uint64_t)st.st_size;
+}
+
+static bool
+attribute(const char *tag, const char *end, const char *name, const char **value, size_t *len)
+/*
+ * Finds name="value" in the tag that ends at end
+ */
+{
+	size_t name_len = strlen(name);
+	for (const char *p = tag + 1; p + name_len + 2 < end; p++)
+		if (p[-1] == ' ' && !strncmp(p, name, name_len) && p[name_len] == '=' && p[name_len + 1] == '"')
+		{
+			*value = p + name_len + 2;
+			*len   = strcspn(*value, "\"");
+			return true;
+		}
+	return false;
+}
+
+void
+weight_head(struct weight *w, const char *head)
+/*
+ * Adds what every page fetches for the <link>s in head (see ASSETS_HEAD)
+ */
+{
+	for (const char *tag = head; (tag = strstr(tag, "<link ")) != NULL; tag++)
+	{
+		const char *end = strchr(tag, '>'), *rel, *href, *as;
+		size_t rel_len, href_len, as_len;
+		uint64_t *into;
+
+		if (end == NULL)
+			break;
+		if (!attribute(tag, end, "rel", &rel, &rel_len) || !attribute(tag, end, "href", &href, &href_len))
+			continue;
+		if (rel_len == 10 && !strncmp(rel, "stylesheet", 10))
+			into = &w->css;
+		else if (rel_len == 4 && !strncmp(rel, "icon", 4))
+			into = &w->favicon;
+		else if (rel_len == 7 && !strncmp(rel, "preload", 7)
+				&& attribute(tag, end, "as", &as, &as_len) && as_len == 4 && !strncmp(as, "font", 4))
+			into = &w->fonts;
+		else
+			continue;	// Not fetched with the page
+		*into += asset_size(href, href_len);
+		w->requests++;
+	}
+}
+
+void
+weight_html(struct weight *w, const char *html, size_t len)
+/*
+ * Counts the page, and the request for it
+ */
+{
+	unsigned char chunk[16 * 1024];
+	z_stream z = { 0 };
+	int ret;
+
+	w->html += len;
+	w->requests++;
+	if (deflateInit2(&z, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+		return;	// 15 + 16 is a gzip wrapper, as served
+	z.next_in  = (unsigned char *)html;
+	z.avail_in = len;
+	do
+	{
+		z.next_out  = chunk;
+		z.avail_out = sizeof(chunk);
+		ret = deflate(&z, Z_FINISH);
+		w->html_gz += sizeof(chunk) - z.avail_out;
+	}
+	while (ret == Z_OK);
+	deflateEnd(&z);
+}
+/**** [END] Measuring ****/
+
+
+/**** [START] The manifest ****/
+static int
+compare_pages(const void *a, const void *b)
+{
+	return strcmp(((const struct page_weight *)a)->name, ((const struct page_weight *)b)->name);
+}
+
+void
+weights_add(struct weights *ws, const char *name, const struct weight *w)
+{
+	if (ws->count == ws->cap)
+	{
+		ws->cap   = ws->cap ? 2 * ws->cap : 64;
+		ws->pages = xrealloc(ws->pages, ws->cap * sizeof(*ws->pages));
+	}
+	ws->pages[ws->count].name   = strcpy(xrealloc(NULL, strlen(name) + 1), name);
+	ws->pages[ws->count].weight = *w;
+	ws->count++;
+}
+
+void
+weights_load(struct weights *ws, const char *file)
+/*
+ * One page per line - "html html_gz css fonts images favicon requests name"
+ */
+{
+	FILE *fp;
+	char name[FILENAME_MAX];
+	unsigned long long v[6];
+	unsigned requests;
+
+	memset(ws, 0, sizeof(*ws));
+	if ((fp = fopen(file, "r")) == NULL)
+		return;
+	while (fscanf(fp, "%llu %llu %llu %llu %llu %llu %u ", &v[0], &v[1], &v[2], &v[3], &v[4], &v[5], &requests) == 7
+			&& fgets(name, sizeof(name), fp) != NULL)
+	{
+		name[strcspn(name, "\n")] = '\0';
+		weights_add(ws, name, &(struct weight){ v[0], v[1], v[2], v[3], v[4], v[5], requests });
+	}
+	fclose(fp);
+	qsort(ws->pages, ws->count, sizeof(*ws->pages), compare_pages);
+}
+
+int
+weights_save(struct weights *ws, const char *file)
+{
+	FILE *fp;
+
+	if ((fp = fopen(file, "w")) == NULL)
+		return 1;
+	for (size_t i = 0; i < ws->count; i++)
+	{
+		const struct weight *w = &ws->pages[i].weight;
+		fprintf(fp, "%llu %llu %llu %llu %llu %llu %u %s\n",
+				(unsigned long long)w->html, (unsigned long long)w->html_gz,
+				(unsigned long long)w->css, (unsigned long long)w->fonts,
+				(unsigned long long)w->images, (unsigned long long)w->favicon,
+				w->requests, ws->pages[i].name);
+	}
+	return fclose(fp) != 0;
+}
+
+const struct weight *
+weights_find(const struct weights *ws, const char *name)
+/*
+ * Only for a loaded set, which is sorted
+ */
+{
+	struct page_weight key = { .name = (char *)name }, *page;
+
+	if (ws->count == 0)
+		return NULL;
+	page = bsearch(&key, ws->pages, ws->count, sizeof(*ws->pages), compare_pages);
+	return page != NULL ? &page->weight : NULL;
+}
+
+void
+weights_free(struct weights *ws)
+{
+	for (size_t i = 0; i < ws->count; i++)
+		free(ws->pages[i].name);
+	free(ws->pages);
+	memset(ws, 0, sizeof(*ws));
+}
+/**** [END] The manifest ****/
+
+
+/**** [START] The report ****/
+static void
+print_name(const char *name, FILE *out)
+{
+	fputc('"', out);
+	for (; *name != '\0'; name++)
+		if (*name == '"' || *name == '\\')
+			fprintf(out, "\\%c", *name);
+		else if ((unsigned char)*name < 0x20)
+			fprintf(out, "\\u%04x", *name);
+		else
+			fputc(*name, out);
+	fputc('"', out);
+}
+
+static void
+print_weight(const struct weight *w, FILE *out)
+{
+	fprintf(out, "\"html\": %llu, \"html_gz\": %llu, \"css\": %llu, \"fonts\": %llu, "
+			"\"images\": %llu, \"favicon\": %llu, \"requests\": %u, \"total\": %llu",
+			(unsigned long long)w->html, (unsigned long long)w->html_gz,
+			(unsigned long long)w->css, (unsigned long long)w->fonts,
+			(unsigned long long)w->images, (unsigned long long)w->favicon,
+			w->requests, (unsigned long long)total(w));
+}
+
+static void
+print_delta(const struct weight *w, const struct weight *was, FILE *out)
+{
+#define DELTA(field) ((long long)w->field - (long long)was->field)
+	fprintf(out, "\"html\": %lld, \"html_gz\": %lld, \"css\": %lld, \"fonts\": %lld, "
+			"\"images\": %lld, \"favicon\": %lld, \"requests\": %d, \"total\": %lld",
+			DELTA(html), DELTA(html_gz), DELTA(css), DELTA(fonts), DELTA(images), DELTA(favicon),
+			(int)w->requests - (int)was->requests, (long long)total(w) - (long long)total(was));
+#undef DELTA
+}
+
+unsigned
+weights_report(struct weights *now, const struct weights *before, FILE *json)
+/*
+ * Writes every page's weight, and how it changed since before, as JSON.
+ * The pages over any of the budgets are listed on stderr, and with
+ * PRINT_FILENAMES, the ones that changed on stdout. Returns how many are
+ * over.
+ */
+{
+	unsigned over = 0;
+
+	qsort(now->pages, now->count, sizeof(*now->pages), compare_pages);
+
+	fputs("{\n\t\"budgets\": {", json);
+	for (size_t i = 0; i < NBUDGETS; i++)
+		fprintf(json, " \"%s\": %llu%s", BUDGETS[i].name, (unsigned long long)BUDGETS[i].max,
+				i + 1 < NBUDGETS ? "," : " },\n");
+	fputs("\t\"pages\": {\n", json);
+	for (size_t i = 0; i < now->count; i++)
+	{
+		const struct weight *w   = &now->pages[i].weight;
+		const struct weight *was = weights_find(before, now->pages[i].name);
+		const char *name = now->pages[i].name;
+
+		fputs("\t\t", json);
+		print_name(name, json);
+		fputs(": { ", json);
+		print_weight(w, json);
+		fputs(", \"delta\": ", json);
+		if (was != NULL)
+		{
+			fputs("{ ", json);
+			print_delta(w, was, json);
+			fputs(" }", json);
+		}
+		else
+			fputs("null", json);
+
+		fputs(", \"over\": [", json);
+		bool any = false;
+		for (size_t b = 0; b < NBUDGETS; b++)
+			if (BUDGETS[b].max != 0 && measure(w, b) > BUDGETS[b].max)
+			{
+				fprintf(json, "%s\"%s\"", any ? ", " : "", BUDGETS[b].name);
+				fprintf(stderr, "weight: %s: %s is %llu, over its budget of %llu\n", name,
+						BUDGETS[b].name, (unsigned long long)measure(w, b),
+						(unsigned long long)BUDGETS[b].max);
+				any = true;
+			}
+		over += any;
+		fprintf(json, "] }%s\n", i + 1 < now->count ? "," : "");
+
+#ifdef PRINT_FILENAMES
+		if (was == NULL)
+			printf("weight: %s: %llu bytes in %u requests (new)\n", name,
+					(unsigned long long)total(w), w->requests);
+		else if (w->requests != was->requests || w->html != was->html || w->html_gz != was->html_gz
+				|| w->css != was->css || w->fonts != was->fonts || w->images != was->images
+				|| w->favicon != was->favicon)
+			printf("weight: %s: %llu bytes in %u requests (%+lld bytes, %+d requests)\n", name,
+					(unsigned long long)total(w), w->requests,
+					(long long)total(w) - (long long)total(was), (int)w->requests - (int)was->requests);
+#endif /* PRINT_FILENAMES */
+	}
+	fprintf(json, "\t},\n\t\"over\": %u\n}\n", over);
+	return over;
+}
+/**** [END] The report ****/
+
+// vim:noet:ts=4:sts=0:sw=0:fdm=syntax